@@ -0,0 +1,967 @@
+/**
+ * Benchmarks of the capture and conversion paths, no camera needed.
+ *
+ * Kernels run on synthetic frames, the capture path runs UeyeCamera on the
+ * simulated backend. Every result is printed as one JSON object per line.
+ *
+ * usage: ueye_importer_benchmark [--filter NAME] [--min-time MS] [--threads 1,2,4]
+ *                                [--frames N] [--sizes 640x480,1280x1024]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <lms/imaging/image.h>
+#include <lms/logger.h>
+
+#include "buffer_table.h"
+#include "cpu_features.h"
+#include "demosaic.h"
+#include "exposure_control.h"
+#include "image_arena.h"
+#include "lossless_codec.h"
+#include "output_transform.h"
+#include "pixel_conversion.h"
+#include "pyramid.h"
+#include "simulated_backend.h"
+#include "ueye_camera.h"
+
+using namespace lms_ueye_importer;
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    Options() :
+        filter(""),
+        minTime(200.0),
+        threads({ 1, 2, 4 }),
+        frames(200),
+        sizes({ { 640, 480 }, { 1280, 1024 }, { 1920, 1200 } })
+    {}
+
+    std::string filter;
+    double minTime;     // ms per measurement
+    std::vector<size_t> threads;
+    size_t frames;      // per capture measurement
+    std::vector< std::pair<size_t, size_t> > sizes;
+};
+
+/**
+ * One line of output: fixed fields first, then whatever the benchmark adds
+ */
+class Result
+{
+public:
+    Result(const std::string& name, size_t width, size_t height, const std::string& format, size_t threads)
+    {
+        out << "{\"benchmark\":\"" << name << "\",\"width\":" << width << ",\"height\":" << height
+            << ",\"format\":\"" << format << "\",\"threads\":" << threads;
+    }
+
+    Result& field(const std::string& key, double value)
+    {
+        out << ",\"" << key << "\":" << value;
+        return *this;
+    }
+
+    Result& field(const std::string& key, uint64_t value)
+    {
+        out << ",\"" << key << "\":" << value;
+        return *this;
+    }
+
+    void print()
+    {
+        out << "}";
+        std::printf("%s\n", out.str().c_str());
+        std::fflush(stdout);
+    }
+
+private:
+    std::ostringstream out;
+};
+
+/**
+ * @brief Run fn repeatedly for at least minTime ms after one warm-up call
+ * @return mean ns per call
+ */
+double measure(double minTime, uint64_t& iterations, const std::function<void()>& fn)
+{
+    fn();
+
+    iterations = 0;
+    Clock::time_point start = Clock::now();
+    Clock::duration elapsed;
+    do
+    {
+        fn();
+        iterations++;
+        elapsed = Clock::now() - start;
+    }
+    while( std::chrono::duration<double, std::milli>(elapsed).count() < minTime );
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+void report(const std::string& name, size_t width, size_t height, const std::string& format, size_t threads,
+            double ns, uint64_t iterations, size_t bytes)
+{
+    Result(name, width, height, format, threads)
+        .field("iterations", iterations)
+        .field("ns_per_op", ns)
+        .field("mb_per_s", bytes > 0 ? bytes / ns * 1e3 : 0.0)
+        .print();
+}
+
+// Smooth gradients with some noise, compresses and converts like a real scene
+void fillFrame(std::vector<uint8_t>& buffer, size_t stride, size_t rows, unsigned int seed)
+{
+    std::minstd_rand random(seed);
+    for( size_t y = 0; y < rows; ++y )
+    {
+        for( size_t x = 0; x < stride; ++x )
+        {
+            buffer[y * stride + x] = static_cast<uint8_t>( ( x / 4 + y / 2 ) + ( random() & 7 ) );
+        }
+    }
+}
+
+bool selected(const Options& options, const std::string& name)
+{
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+void benchBufferTable(const Options& options)
+{
+    if( !selected(options, "buffer_table") )
+    {
+        return;
+    }
+
+    BufferTable table;
+    std::vector<char> memory(BufferTable::MAX_BUFFERS);
+    for( size_t i = 0; i < 16; ++i )
+    {
+        table.add(&memory[i], int(i) + 1);
+    }
+
+    // with the sequence number from the driver and with the search fallback
+    for( int direct = 1; direct >= 0; --direct )
+    {
+        const size_t LOOKUPS = 4096;
+        volatile uintptr_t sink = 0;
+        uint64_t iterations;
+        double ns = measure(options.minTime, iterations, [&]
+        {
+            for( size_t i = 0; i < LOOKUPS; ++i )
+            {
+                const size_t index = i & 15;
+                sink = sink + reinterpret_cast<uintptr_t>( table.find(direct ? int(index) + 1 : 0, &memory[index]) );
+            }
+        });
+        report(direct ? "buffer_table_find" : "buffer_table_search", 16, 1, "", 1, ns / LOOKUPS, iterations * LOOKUPS, 0);
+    }
+}
+
+/**
+ * Data TLB load misses of the calling thread, where the kernel exposes the
+ * counter (often not inside virtual machines)
+ */
+class TlbCounter
+{
+public:
+    TlbCounter() :
+        fd(-1)
+    {
+#ifdef __linux__
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type           = PERF_TYPE_HW_CACHE;
+        attr.size           = sizeof(attr);
+        attr.config         = PERF_COUNT_HW_CACHE_DTLB | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 );
+        attr.disabled       = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+
+    ~TlbCounter()
+    {
+#ifdef __linux__
+        if( fd >= 0 )
+        {
+            close(fd);
+        }
+#endif
+    }
+
+    bool available() const { return fd >= 0; }
+
+    void start()
+    {
+#ifdef __linux__
+        if( fd >= 0 )
+        {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    uint64_t stop()
+    {
+        uint64_t misses = 0;
+#ifdef __linux__
+        if( fd >= 0 )
+        {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if( sizeof(misses) != read(fd, &misses, sizeof(misses)) )
+            {
+                misses = 0;
+            }
+        }
+#endif
+        return misses;
+    }
+
+private:
+    int fd;
+};
+
+// Bytes of the mapping containing ptr that the kernel backs with transparent huge pages
+uint64_t hugePageBytes(const void* ptr)
+{
+    std::ifstream smaps("/proc/self/smaps");
+    const uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+    std::string line;
+    bool inside = false;
+    while( std::getline(smaps, line) )
+    {
+        unsigned long start, end;
+        if( 2 == std::sscanf(line.c_str(), "%lx-%lx ", &start, &end) )
+        {
+            inside = ( address >= start && address < end );
+        }
+        else if( inside && 0 == line.compare(0, 14, "AnonHugePages:") )
+        {
+            return std::strtoull(line.c_str() + 14, NULL, 10) * 1024;
+        }
+    }
+    return 0;
+}
+
+void benchBufferArena(const Options& options)
+{
+    if( !selected(options, "buffer_arena") )
+    {
+        return;
+    }
+
+    // copying the ring of sequence buffers out one after the other, like
+    // captureImage does, from separately allocated buffers (as the driver
+    // allocates them) and from an arena with base and with huge pages
+    static const char* const variants[] = { "separate", "arena_base_pages", "arena_huge_pages" };
+    const size_t BUFFERS = 8;
+    const PixelFormat format = PixelFormat::MONO8;
+    TlbCounter tlb;
+
+    for( const auto& size : options.sizes )
+    {
+        const size_t width = size.first;
+        const size_t height = size.second;
+        const size_t length = rowBytes(format, width);
+        std::vector<uint8_t> pattern(length * height);
+        fillFrame(pattern, length, height, 9);
+        std::vector<uint8_t> dst(length * height);
+
+        for( size_t variant = 0; variant < 3; ++variant )
+        {
+            std::vector< std::unique_ptr<uint8_t[]> > separate;
+            ImageArena arena;
+            std::vector<uint8_t*> buffers;
+            size_t pitch = length;
+            if( 0 == variant )
+            {
+                for( size_t i = 0; i < BUFFERS; ++i )
+                {
+                    separate.emplace_back( new uint8_t[length * height] );
+                    buffers.push_back( separate.back().get() );
+                }
+            }
+            else
+            {
+                pitch = rowBytes(format, ImageArena::paddedWidth(format, width));
+                if( !arena.allocate(BUFFERS * ImageArena::bufferSize(format, width, height), 2 == variant, false) )
+                {
+                    std::fprintf(stderr, "could not map the arena\n");
+                    continue;
+                }
+                for( size_t i = 0; i < BUFFERS; ++i )
+                {
+                    buffers.push_back( reinterpret_cast<uint8_t*>( arena.carve(ImageArena::bufferSize(format, width, height)) ) );
+                }
+            }
+            for( uint8_t* buffer : buffers )
+            {
+                for( size_t y = 0; y < height; ++y )
+                {
+                    std::memcpy(buffer + y * pitch, pattern.data() + y * length, length);
+                }
+            }
+
+            size_t next = 0;
+            uint64_t iterations;
+            tlb.start();
+            double ns = measure(options.minTime, iterations, [&]
+            {
+                const uint8_t* src = buffers[next++ % BUFFERS];
+                for( size_t y = 0; y < height; ++y )
+                {
+                    std::memcpy(dst.data() + y * length, src + y * pitch, length);
+                }
+            });
+            const uint64_t misses = tlb.stop();
+
+            Result result("buffer_arena", width, height, variants[variant], 1);
+            result.field("iterations", iterations)
+                .field("ns_per_op", ns)
+                .field("mb_per_s", length * height / ns * 1e3)
+                .field("pitch", uint64_t(pitch))
+                .field("aligned_rows", uint64_t( 0 == reinterpret_cast<uintptr_t>(buffers[0]) % ImageArena::ALIGNMENT && 0 == pitch % ImageArena::ALIGNMENT ))
+                .field("huge_page_bytes", hugePageBytes(buffers[0]));
+            if( tlb.available() )
+            {
+                // the warm-up call is counted as well
+                result.field("dtlb_load_misses_per_frame", double(misses) / ( iterations + 1 ));
+            }
+            result.print();
+        }
+    }
+}
+
+void benchMonoConversion(const Options& options)
+{
+    static const std::pair<PixelFormat, const char*> formats[] = {
+        { PixelFormat::MONO8,           "mono8" },
+        { PixelFormat::MONO12,          "mono12" },
+        { PixelFormat::MONO10_PACKED,   "mono10_packed" },
+        { PixelFormat::MONO12_PACKED,   "mono12_packed" },
+    };
+
+    for( const auto& size : options.sizes )
+    {
+        const size_t width = size.first;
+        const size_t height = size.second;
+
+        for( const auto& format : formats )
+        {
+            const size_t stride = rowBytes(format.first, width);
+            std::vector<uint8_t> src(stride * height);
+            fillFrame(src, stride, height, 1);
+            std::vector<uint8_t> dst8(width * height);
+            std::vector<uint16_t> dst16(width * height);
+
+            MonoConverter converter;
+            uint64_t iterations;
+            double ns;
+
+            if( selected(options, "mono_to8") )
+            {
+                converter.configure(format.first, 1.0);
+                ns = measure(options.minTime, iterations, [&]
+                {
+                    converter.to8(src.data(), stride, dst8.data(), width, width, height);
+                });
+                report("mono_to8", width, height, format.second, 1, ns, iterations, src.size());
+            }
+
+            if( PixelFormat::MONO8 == format.first )
+            {
+                continue;
+            }
+
+            if( selected(options, "mono_to8_gamma") )
+            {
+                converter.configure(format.first, 2.2);
+                ns = measure(options.minTime, iterations, [&]
+                {
+                    converter.to8(src.data(), stride, dst8.data(), width, width, height);
+                });
+                report("mono_to8_gamma", width, height, format.second, 1, ns, iterations, src.size());
+            }
+
+            if( selected(options, "mono_to16") )
+            {
+                converter.configure(format.first, 1.0);
+                ns = measure(options.minTime, iterations, [&]
+                {
+                    converter.to16(src.data(), stride, dst16.data(), width * 2, width, height);
+                });
+                report("mono_to16", width, height, format.second, 1, ns, iterations, src.size());
+            }
+        }
+    }
+}
+
+void benchCopyStatistics(const Options& options)
+{
+    if( !selected(options, "copy_statistics") )
+    {
+        return;
+    }
+
+    // histogram of every n-th row as configured by image_statistics_histogram_step
+    static const size_t steps[] = { 0, 8, 1 };
+
+    for( const auto& size : options.sizes )
+    {
+        const size_t width = size.first;
+        const size_t height = size.second;
+        std::vector<uint8_t> src(width * height);
+        std::vector<uint8_t> dst(width * height);
+        fillFrame(src, width, height, 6);
+
+        ImageStatistics stats;
+        uint64_t iterations;
+        double ns = measure(options.minTime, iterations, [&]
+        {
+            std::memcpy(dst.data(), src.data(), src.size());
+        });
+        report("copy_statistics", width, height, "memcpy", 1, ns, iterations, src.size());
+
+        for( size_t step : steps )
+        {
+            ns = measure(options.minTime, iterations, [&]
+            {
+                stats.reset();
+                for( size_t y = 0; y < height; ++y )
+                {
+                    kernels::copyStatistics(src.data() + y * width, dst.data() + y * width, width, stats, step > 0 && 0 == y % step);
+                }
+            });
+            report("copy_statistics", width, height, "fused_histogram_step" + std::to_string(step), 1, ns, iterations, src.size());
+        }
+
+        // what a consumer scanning CAMERA_IMAGE itself pays on top of the copy
+        ns = measure(options.minTime, iterations, [&]
+        {
+            stats.reset();
+            std::memcpy(dst.data(), src.data(), src.size());
+            kernels::copyStatistics(dst.data(), NULL, dst.size(), stats, true);
+        });
+        report("copy_statistics", width, height, "copy_then_scan", 1, ns, iterations, src.size());
+    }
+}
+
+void benchDemosaic(const Options& options)
+{
+    if( !selected(options, "demosaic") )
+    {
+        return;
+    }
+
+    static const std::pair<PixelFormat, const char*> outputs[] = {
+        { PixelFormat::RGB8,    "rgb" },
+        { PixelFormat::BGRA8,   "bgra" },
+        { PixelFormat::YUYV,    "yuyv" },
+    };
+
+    for( const auto& size : options.sizes )
+    {
+        const size_t width = size.first;
+        const size_t height = size.second;
+        std::vector<uint8_t> src(width * height);
+        fillFrame(src, width, height, 2);
+
+        for( const auto& output : outputs )
+        {
+            const size_t dstStride = rowBytes(output.first, width);
+            std::vector<uint8_t> dst(dstStride * height);
+
+            for( size_t threads : options.threads )
+            {
+                Demosaic demosaic;
+                demosaic.configure(BayerPattern::RGGB, output.first, threads);
+                uint64_t iterations;
+                double ns = measure(options.minTime, iterations, [&]
+                {
+                    demosaic.process(src.data(), width, dst.data(), dstStride, width, height);
+                });
+                report("demosaic", width, height, output.second, threads, ns, iterations, src.size());
+            }
+        }
+    }
+}
+
+void benchPyramid(const Options& options)
+{
+    if( !selected(options, "pyramid") )
+    {
+        return;
+    }
+
+    static const std::pair<PyramidFilter, const char*> filters[] = {
+        { PyramidFilter::BOX,       "box" },
+        { PyramidFilter::GAUSSIAN,  "gaussian" },
+    };
+    const size_t LEVELS = 3;
+
+    for( const auto& size : options.sizes )
+    {
+        const size_t width = size.first;
+        const size_t height = size.second;
+        std::vector<uint8_t> src(width * height);
+        std::vector<uint8_t> full(width * height);
+        fillFrame(src, width, height, 3);
+
+        std::vector< std::vector<uint8_t> > levels(LEVELS);
+        std::vector<uint8_t*> outputs(LEVELS);
+        for( size_t level = 1; level <= LEVELS; ++level )
+        {
+            size_t levelWidth, levelHeight;
+            Pyramid::levelSize(width, height, level, levelWidth, levelHeight);
+            levels[level - 1].resize(levelWidth * levelHeight);
+            outputs[level - 1] = levels[level - 1].data();
+        }
+
+        for( const auto& filter : filters )
+        {
+            Pyramid pyramid;
+            pyramid.configure(LEVELS, filter.first);
+
+            // building the levels alone and fused with the full resolution copy
+            for( int copy = 0; copy <= 1; ++copy )
+            {
+                uint64_t iterations;
+                double ns = measure(options.minTime, iterations, [&]
+                {
+                    pyramid.process(src.data(), width, copy ? full.data() : NULL, width, height, outputs.data());
+                });
+                report(copy ? "pyramid_copy" : "pyramid", width, height, filter.second, 1, ns, iterations, src.size());
+            }
+        }
+    }
+}
+
+void benchOutputTransform(const Options& options)
+{
+    if( !selected(options, "output_transform") )
+    {
+        return;
+    }
+
+    static const std::pair<PixelFormat, const char*> formats[] = {
+        { PixelFormat::MONO8,   "mono8" },
+        { PixelFormat::RGB8,    "rgb" },
+        { PixelFormat::BGRA8,   "bgra" },
+        { PixelFormat::YUYV,    "yuyv" },
+    };
+    // crop keeps the middle 3/4 of each dimension
+    static const char* const variants[] = { "memcpy", "crop", "flip_horizontal", "rotate180", "lut", "rotate180_lut" };
+
+    const std::vector<uint8_t> gamma = OutputTransform::makeLut(2.2, 1.0, 0.0);
+    for( const auto& size : options.sizes )
+    {
+        const size_t width = size.first;
+        const size_t height = size.second;
+
+        for( const auto& format : formats )
+        {
+            const size_t stride = rowBytes(format.first, width);
+            std::vector<uint8_t> src(stride * height);
+            std::vector<uint8_t> dst(stride * height);
+            fillFrame(src, stride, height, 7);
+
+            for( const char* variant : variants )
+            {
+                const std::string name = variant;
+                OutputTransform transform;
+                const bool crop = ( name == "crop" );
+                const Orientation orientation = ( name == "flip_horizontal" ) ? Orientation::FLIP_HORIZONTAL
+                    : ( name.compare(0, 9, "rotate180") == 0 ) ? Orientation::ROTATE_180 : Orientation::NORMAL;
+                transform.configure(orientation, crop ? width / 16 * 2 : 0, crop ? height / 8 : 0,
+                                    crop ? width / 8 * 6 : 0, crop ? height / 4 * 3 : 0,
+                                    name.find("lut") != std::string::npos ? gamma : std::vector<uint8_t>());
+                transform.prepare(format.first, width, height);
+                const size_t dstStride = rowBytes(format.first, transform.getWidth());
+
+                uint64_t iterations;
+                double ns = measure(options.minTime, iterations, [&]
+                {
+                    if( transform.isActive() )
+                    {
+                        transform.process(src.data(), stride, dst.data(), dstStride);
+                    }
+                    else
+                    {
+                        std::memcpy(dst.data(), src.data(), src.size());
+                    }
+                });
+                report("output_transform", width, height, std::string(format.second) + "_" + name, 1, ns, iterations, src.size());
+            }
+        }
+    }
+}
+
+void benchExposureHistogram(const Options& options)
+{
+    if( !selected(options, "exposure_histogram") )
+    {
+        return;
+    }
+
+    static const size_t steps[] = { 1, 4 };
+
+    for( const auto& size : options.sizes )
+    {
+        const size_t width = size.first;
+        const size_t height = size.second;
+        std::vector<uint8_t> mono8(width * height);
+        std::vector<uint8_t> mono12(width * height * 2);
+        fillFrame(mono8, width, height, 4);
+        fillFrame(mono12, width * 2, height, 5);
+        for( size_t i = 1; i < mono12.size(); i += 2 )
+        {
+            mono12[i] &= 0x0F;
+        }
+
+        for( size_t step : steps )
+        {
+            uint32_t bins[256];
+            uint64_t iterations;
+            double ns = measure(options.minTime, iterations, [&]
+            {
+                std::fill_n(bins, 256, 0u);
+                ExposureController::histogram8(mono8.data(), width, width, height, step, step, bins);
+            });
+            report("exposure_histogram", width, height, "mono8_step" + std::to_string(step), 1, ns, iterations, mono8.size());
+
+            ns = measure(options.minTime, iterations, [&]
+            {
+                std::fill_n(bins, 256, 0u);
+                ExposureController::histogram16(reinterpret_cast<const uint16_t*>(mono12.data()), width * 2, width, height, step, step, 4, bins);
+            });
+            report("exposure_histogram", width, height, "mono12_step" + std::to_string(step), 1, ns, iterations, mono12.size());
+        }
+    }
+}
+
+void benchLossless(const Options& options)
+{
+    if( !selected(options, "lossless") )
+    {
+        return;
+    }
+
+    static const std::pair<PixelFormat, const char*> formats[] = {
+        { PixelFormat::MONO8,   "mono8" },
+        { PixelFormat::BAYER8,  "bayer8" },
+        { PixelFormat::MONO12,  "mono12" },
+    };
+
+    for( const auto& size : options.sizes )
+    {
+        const size_t width = size.first;
+        const size_t height = size.second;
+
+        for( const auto& format : formats )
+        {
+            const size_t stride = rowBytes(format.first, width);
+            std::vector<uint8_t> src(stride * height);
+            fillFrame(src, stride, height, 4);
+            if( significantBits(format.first) > 8 )
+            {
+                // keep 16 bit samples in range
+                uint16_t* samples = reinterpret_cast<uint16_t*>( src.data() );
+                for( size_t i = 0; i < src.size() / 2; ++i )
+                {
+                    samples[i] &= 0x0fff;
+                }
+            }
+            std::vector<uint8_t> encoded(src.size());
+            std::vector<uint8_t> decoded(src.size());
+
+            for( size_t threads : options.threads )
+            {
+                LosslessCodec codec(threads);
+                size_t encodedSize = 0;
+                uint64_t iterations;
+
+                double ns = measure(options.minTime, iterations, [&]
+                {
+                    encodedSize = codec.encode(src.data(), stride, format.first, width, height, encoded.data(), encoded.size());
+                });
+                Result("lossless_encode", width, height, format.second, threads)
+                    .field("iterations", iterations)
+                    .field("ns_per_op", ns)
+                    .field("mb_per_s", src.size() / ns * 1e3)
+                    .field("ratio", encodedSize > 0 ? double(src.size()) / encodedSize : 1.0)
+                    .print();
+
+                if( 0 == encodedSize )
+                {
+                    continue;
+                }
+                ns = measure(options.minTime, iterations, [&]
+                {
+                    codec.decode(encoded.data(), encodedSize, format.first, width, height, decoded.data(), stride);
+                });
+                report("lossless_decode", width, height, format.second, threads, ns, iterations, src.size());
+            }
+        }
+    }
+}
+
+/**
+ * Capture path on the simulated backend: frame event, buffer lookup,
+ * locking and copy / conversion, reported with the camera's own latency
+ * histograms.
+ */
+void benchCapture(const Options& options, lms::logging::Logger& logger)
+{
+    struct Case
+    {
+        const char* name;
+        PixelFormat format;
+        const char* formatName;
+        bool zeroCopy;
+        bool color;
+        bool fifo;
+    };
+    static const Case cases[] = {
+        { "capture_image",      PixelFormat::MONO8,     "mono8",    false, false, false },
+        { "capture_image",      PixelFormat::MONO12,    "mono12",   false, false, false },
+        { "capture_image",      PixelFormat::BAYER8,    "bayer8",   false, true,  false },
+        { "capture_frame",      PixelFormat::MONO8,     "mono8",    true,  false, false },
+        { "capture_frame_fifo", PixelFormat::MONO8,     "mono8",    true,  false, true },
+    };
+
+    for( const auto& size : options.sizes )
+    {
+        const size_t width = size.first;
+        const size_t height = size.second;
+
+        for( const Case& test : cases )
+        {
+            if( !selected(options, test.name) )
+            {
+                continue;
+            }
+
+            // demosaicing is the only multithreaded stage of the capture path
+            std::vector<size_t> threadCounts = test.color ? options.threads : std::vector<size_t>(1, 1);
+            for( size_t threads : threadCounts )
+            {
+                UeyeCamera camera(logger, new SimulatedBackend(width, height));
+                camera.open(0, "");
+                camera.setAOI(width, height);
+                camera.setPixelFormat(test.format);
+                if( test.color )
+                {
+                    camera.setColorOutput(PixelFormat::RGB8, threads);
+                }
+                // as fast as the simulated sensor can read out
+                camera.setPixelClock(1000);
+                camera.setFrameRate(1000);
+                camera.setNumBuffers(8);
+                camera.setDeliveryMode(test.fifo ? DeliveryMode::FIFO : DeliveryMode::LATEST);
+                if( !camera.init() || !camera.start() )
+                {
+                    std::fprintf(stderr, "could not start the simulated camera\n");
+                    continue;
+                }
+
+                lms::imaging::Image image;
+                image.resize(width, height, test.color ? lms::imaging::Format::RGB : lms::imaging::Format::GREY);
+                Frame frame;
+
+                // FIFO delivery has to keep the frame order while leases are
+                // released behind the capture, frames are only missing where
+                // the driver found no free buffer
+                std::deque<Frame> held;
+                uint64_t lastFrame = 0;
+                uint64_t outOfOrder = 0;
+                uint64_t missing = 0;
+
+                size_t captured = 0;
+                Clock::time_point start = Clock::now();
+                while( captured < options.frames && camera.waitForFrame(1000) )
+                {
+                    bool ok = test.zeroCopy ? camera.captureFrame(frame) : camera.captureImage(image);
+                    captured += ok ? 1 : 0;
+                    if( ok && test.fifo )
+                    {
+                        const uint64_t frameNumber = camera.getFrameInfo().frameNumber;
+                        if( lastFrame > 0 && frameNumber <= lastFrame )
+                        {
+                            outOfOrder++;
+                        }
+                        else if( lastFrame > 0 )
+                        {
+                            missing += frameNumber - lastFrame - 1;
+                        }
+                        lastFrame = std::max(lastFrame, frameNumber);
+
+                        held.push_back(frame);
+                        if( held.size() > 2 )
+                        {
+                            held.pop_front();
+                        }
+                    }
+                }
+                const double seconds = std::chrono::duration<double>( Clock::now() - start ).count();
+                held.clear();
+                frame = Frame();
+
+                LatencyStatistics latency = camera.getLatencyStatistics();
+                const LatencySummary& lock = latency.stages[LatencyStatistics::LOCK];
+                const LatencySummary& copy = latency.stages[LatencyStatistics::COPY];
+                const LatencySummary& queue = latency.stages[LatencyStatistics::QUEUE];
+                Result result(test.name, width, height, test.formatName, threads);
+                result.field("frames", uint64_t(captured))
+                    .field("fps", captured / seconds)
+                    .field("lock_p50_us", lock.p50)
+                    .field("lock_p99_us", lock.p99)
+                    .field("copy_p50_us", copy.p50)
+                    .field("copy_p99_us", copy.p99)
+                    .field("copy_mean_us", copy.mean)
+                    .field("queue_p50_us", queue.p50)
+                    .field("queue_p99_us", queue.p99);
+                if( test.fifo )
+                {
+                    CaptureStatistics statistics = camera.getCaptureStatistics();
+                    result.field("out_of_order", outOfOrder)
+                        .field("missing", missing)
+                        .field("queue_overflows", statistics.queueOverflows);
+                }
+                result.print();
+
+                camera.stop();
+                camera.deinit();
+                camera.close();
+            }
+        }
+    }
+}
+
+std::vector<std::string> split(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::istringstream in(list);
+    std::string item;
+    while( std::getline(in, item, ',') )
+    {
+        if( !item.empty() )
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for( int i = 1; i < argc; ++i )
+    {
+        const std::string arg = argv[i];
+        if( i + 1 >= argc )
+        {
+            return false;
+        }
+        const std::string value = argv[++i];
+
+        if( arg == "--filter" )
+        {
+            options.filter = value;
+        }
+        else if( arg == "--min-time" )
+        {
+            options.minTime = std::atof(value.c_str());
+        }
+        else if( arg == "--frames" )
+        {
+            options.frames = std::strtoul(value.c_str(), NULL, 10);
+        }
+        else if( arg == "--threads" )
+        {
+            options.threads.clear();
+            for( const auto& item : split(value) )
+            {
+                options.threads.push_back( std::max<size_t>(1, std::strtoul(item.c_str(), NULL, 10)) );
+            }
+        }
+        else if( arg == "--sizes" )
+        {
+            options.sizes.clear();
+            for( const auto& item : split(value) )
+            {
+                unsigned long width, height;
+                if( 2 != std::sscanf(item.c_str(), "%lux%lu", &width, &height) || width < 2 || height < 2 )
+                {
+                    return false;
+                }
+                options.sizes.push_back( std::make_pair(size_t(width), size_t(height)) );
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return !options.threads.empty() && !options.sizes.empty();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if( !parseOptions(argc, argv, options) )
+    {
+        std::fprintf(stderr, "usage: %s [--filter NAME] [--min-time MS] [--threads 1,2,4] [--frames N] [--sizes 640x480,1280x1024]\n", argv[0]);
+        return 1;
+    }
+
+    // machine description, so results of different hosts can be told apart
+    const CpuFeatures& cpu = CpuFeatures::get();
+    std::printf("{\"host\":{\"hardware_threads\":%u,\"ssse3\":%s,\"avx2\":%s}}\n",
+                std::thread::hardware_concurrency(), cpu.ssse3 ? "true" : "false", cpu.avx2 ? "true" : "false");
+
+    lms::logging::Logger logger("ueye_benchmark");
+
+    benchBufferTable(options);
+    benchBufferArena(options);
+    benchMonoConversion(options);
+    benchCopyStatistics(options);
+    benchDemosaic(options);
+    benchPyramid(options);
+    benchOutputTransform(options);
+    benchExposureHistogram(options);
+    benchLossless(options);
+    benchCapture(options, logger);
+    return 0;
+}
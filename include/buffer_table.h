@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "image_arena.h"
+
+namespace lms_ueye_importer
+{
+
+/**
+ * State of one sequence buffer, padded to a cache line so that buffers
+ * released from consumer threads do not share lines.
+ */
+struct alignas(64) BufferDescriptor
+{
+    char* ptr;
+    int id;
+
+    // locked by a Frame lease
+    std::atomic<bool> lent;
+
+    // locked by the acquisition thread until delivered (FIFO delivery)
+    std::atomic<bool> queued;
+
+    // statistics, only written by the module thread
+    uint64_t delivered;
+    uint64_t copies;
+    uint64_t lends;
+};
+
+/**
+ * Fixed table of sequence buffers indexed by their sequence number.
+ *
+ * Buffers are added in sequence order, so the 1-based sequence number
+ * reported by the driver is the table index + 1. Lookups on the capture
+ * path therefore neither hash nor allocate. Buffers carved from an
+ * ImageArena keep it alive in their table.
+ */
+class BufferTable
+{
+public:
+    static const size_t MAX_BUFFERS = 64;
+
+    BufferTable() :
+        count(0)
+    {
+        void* mem = NULL;
+        if( 0 != posix_memalign(&mem, alignof(BufferDescriptor), sizeof(BufferDescriptor) * MAX_BUFFERS) )
+        {
+            throw std::bad_alloc();
+        }
+        entries = static_cast<BufferDescriptor*>(mem);
+        for( size_t i = 0; i < MAX_BUFFERS; ++i )
+        {
+            new (&entries[i]) BufferDescriptor();
+        }
+        clear();
+    }
+
+    ~BufferTable()
+    {
+        for( size_t i = 0; i < MAX_BUFFERS; ++i )
+        {
+            entries[i].~BufferDescriptor();
+        }
+        free(entries);
+    }
+
+    BufferTable(const BufferTable&) = delete;
+    BufferTable& operator=(const BufferTable&) = delete;
+
+    /**
+     * @brief Append a buffer in sequence order
+     * @return the new descriptor or NULL if the table is full
+     */
+    BufferDescriptor* add(char* ptr, int id)
+    {
+        if( count == MAX_BUFFERS )
+        {
+            return NULL;
+        }
+        BufferDescriptor& desc = entries[count++];
+        desc.ptr = ptr;
+        desc.id = id;
+        desc.lent = false;
+        desc.queued = false;
+        desc.delivered = 0;
+        desc.copies = 0;
+        desc.lends = 0;
+        return &desc;
+    }
+
+    /**
+     * @brief Look up a buffer by the 1-based sequence number and pointer
+     * reported by the driver
+     * @return descriptor or NULL if ptr is not one of our buffers
+     */
+    BufferDescriptor* find(int seqNum, char* ptr)
+    {
+        if( seqNum >= 1 && size_t(seqNum) <= count && entries[seqNum - 1].ptr == ptr )
+        {
+            return &entries[seqNum - 1];
+        }
+
+        // sequence number not reported or out of sync, search
+        for( size_t i = 0; i < count; ++i )
+        {
+            if( entries[i].ptr == ptr )
+            {
+                return &entries[i];
+            }
+        }
+        return NULL;
+    }
+
+    /**
+     * @brief Keep the memory buffers were carved from until clear(), which
+     * has to come after the buffers were freed in the driver
+     */
+    void addArena(std::unique_ptr<ImageArena> arena)
+    {
+        arenas.push_back(std::move(arena));
+    }
+
+    const std::vector< std::unique_ptr<ImageArena> >& getArenas() const { return arenas; }
+
+    void clear()
+    {
+        for( size_t i = 0; i < MAX_BUFFERS; ++i )
+        {
+            entries[i].ptr = NULL;
+            entries[i].id = 0;
+            entries[i].lent = false;
+            entries[i].queued = false;
+        }
+        count = 0;
+        arenas.clear();
+    }
+
+    /**
+     * @brief Exchange the buffers of two tables. Descriptors keep their
+     * addresses, so leases on them stay valid.
+     */
+    void swap(BufferTable& other)
+    {
+        std::swap(entries, other.entries);
+        std::swap(count, other.count);
+        std::swap(arenas, other.arenas);
+    }
+
+    size_t size() const { return count; }
+
+    BufferDescriptor* begin() { return entries; }
+    BufferDescriptor* end() { return entries + count; }
+
+protected:
+    BufferDescriptor* entries;
+    size_t count;
+    std::vector< std::unique_ptr<ImageArena> > arenas;
+};
+
+}
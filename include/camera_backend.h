@@ -0,0 +1,255 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace lms_ueye_importer
+{
+
+/**
+ * Status codes returned by all backend calls.
+ *
+ * The numbering follows the uEye SDK, so UeyeCamera can keep translating
+ * them with its error code table regardless of the backend in use.
+ */
+enum BackendStatus
+{
+    BACKEND_NO_SUCCESS                  = -1,
+    BACKEND_SUCCESS                     = 0,
+    BACKEND_INVALID_CAMERA_HANDLE       = 1,
+    BACKEND_INVALID_MEMORY_POINTER      = 49,
+    BACKEND_SEQUENCE_BUF_ALREADY_LOCKED = 117,
+    BACKEND_TIMED_OUT                   = 122,
+    BACKEND_INVALID_PARAMETER           = 125,
+    BACKEND_OUT_OF_MEMORY               = 127,
+    BACKEND_CAPTURE_RUNNING             = 140,
+    BACKEND_NOT_SUPPORTED               = 155
+};
+
+/**
+ * Pixel formats a backend can deliver into its sequence buffers
+ *
+ * MONO10/12/16 use one 16 bit word per pixel with the significant bits LSB
+ * aligned. The packed formats store pixels without gaps, LSB first
+ * (Mono10p: 4 pixels in 5 bytes, Mono12p: 2 pixels in 3 bytes).
+ *
+ * BAYER8 is the raw 8 bit color filter array, see BayerPattern. RGB8, BGRA8
+ * and YUYV describe frames demosaiced on the host.
+ */
+enum class PixelFormat
+{
+    MONO8,
+    MONO10,
+    MONO12,
+    MONO16,
+    MONO10_PACKED,
+    MONO12_PACKED,
+    BAYER8,
+    RGB8,
+    BGRA8,
+    YUYV
+};
+
+/**
+ * Color filter layout of the top left 2x2 pixels of a Bayer sensor
+ */
+enum class BayerPattern
+{
+    RGGB,
+    GRBG,
+    GBRG,
+    BGGR
+};
+
+/**
+ * Trigger modes of the sensor
+ */
+enum class TriggerMode
+{
+    OFF,            // free running at the configured frame rate
+    SOFTWARE,       // one frame per CameraBackend::trigger call
+    RISING_EDGE,    // one frame per low to high edge on the trigger input
+    FALLING_EDGE    // one frame per high to low edge on the trigger input
+};
+
+/**
+ * Static sensor properties
+ */
+struct SensorInfo
+{
+    std::string name;
+    bool color;
+    size_t maxWidth;
+    size_t maxHeight;
+    bool masterGain;
+    bool globalShutter;
+    float pixelSize; // um
+    BayerPattern bayerPattern; // only meaningful for color sensors
+};
+
+/**
+ * Capture error counters
+ */
+struct CaptureStatus
+{
+    enum Counter
+    {
+        API_NO_DEST_MEM,
+        API_CONVERSION_FAILED,
+        API_IMAGE_LOCKED,
+        DRV_OUT_OF_BUFFERS,
+        DRV_DEVICE_NOT_READY,
+        USB_TRANSFER_FAILED,
+        DEV_TIMEOUT,
+        ETH_BUFFER_OVERRUN,
+        ETH_MISSED_IMAGES,
+        NUM_COUNTERS
+    };
+
+    uint32_t total;
+    std::array<uint32_t, NUM_COUNTERS> counters;
+
+    static const char* name(Counter counter)
+    {
+        static const char* names[NUM_COUNTERS] = {
+            "API_NO_DEST_MEM",
+            "API_CONVERSION_FAILED",
+            "API_IMAGE_LOCKED",
+            "DRV_OUT_OF_BUFFERS",
+            "DRV_DEVICE_NOT_READY",
+            "USB_TRANSFER_FAILED",
+            "DEV_TIMEOUT",
+            "ETH_BUFFER_OVERRUN",
+            "ETH_MISSED_IMAGES"
+        };
+        return names[counter];
+    }
+};
+
+/**
+ * Per-buffer image information of the last frame captured into a buffer
+ */
+struct ImageInfo
+{
+    uint64_t frameNumber;
+    uint64_t deviceTimestamp;   // us, camera clock
+    uint32_t hostProcessTime;   // us spent by the driver on transfer/processing
+    uint32_t imageBuffers;
+    uint32_t imageBuffersInUse;
+};
+
+/**
+ * Device access used by UeyeCamera.
+ *
+ * Each method maps to one uEye SDK call (or a small group of calls) and
+ * returns a BackendStatus. Implementations must be safe to call from the
+ * module thread while frames are being produced.
+ */
+class CameraBackend
+{
+public:
+    virtual ~CameraBackend() {}
+
+    virtual std::string name() const = 0;
+
+    // Device
+    /**
+     * @param deviceId device id of the camera, 0 selects the first free one
+     * @param serial if not empty, open the camera with this serial number
+     */
+    virtual int open(uint32_t deviceId, const std::string& serial) = 0;
+    virtual int close() = 0;
+    virtual int getSensorInfo(SensorInfo& info) = 0;
+    virtual std::string getLastError() = 0;
+
+    // Format and geometry
+    virtual int setColorMode(PixelFormat format) = 0;
+    virtual int setTriggerMode(TriggerMode mode) = 0;
+    virtual int setAOI(size_t width, size_t height, size_t offsetX, size_t offsetY) = 0;
+    virtual int getImageSize(size_t& width, size_t& height) = 0;
+
+    /**
+     * @brief Combine pixels on the sensor (binning) or skip them (subsampling)
+     *
+     * Factors are 1 (off), 2, 3, 4, 5, 6, 8 or 16, the available ones depend
+     * on the sensor. Changing them resets the AOI to the full reduced sensor
+     * size, so the AOI has to be set afterwards.
+     */
+    virtual int setBinning(size_t horizontal, size_t vertical) = 0;
+    virtual int setSubsampling(size_t horizontal, size_t vertical) = 0;
+
+    // Frame time range (s) for the current pixel clock, AOI and binning
+    virtual int getFrameTimeRange(double& minTime, double& maxTime) = 0;
+
+    // Image memory and sequence
+    virtual int allocImageMem(size_t width, size_t height, size_t bitsPerPixel, char** ptr, int* id) = 0;
+
+    /**
+     * @brief Register memory owned by the caller as image memory
+     *
+     * width may exceed the AOI, rows are then written with the pitch of
+     * width. freeImageMem only unregisters the memory, it stays with the
+     * caller.
+     */
+    virtual int setAllocatedImageMem(size_t width, size_t height, size_t bitsPerPixel, char* ptr, int* id) = 0;
+    virtual int freeImageMem(char* ptr, int id) = 0;
+    virtual int addToSequence(char* ptr, int id) = 0;
+    virtual int clearSequence() = 0;
+    virtual int getActSeqBuf(int* seqNum, char** ptr) = 0;
+    virtual int lockSeqBuf(char* ptr) = 0;
+    virtual int unlockSeqBuf(char* ptr) = 0;
+    virtual int copyImageMem(char* ptr, int id, char* dest) = 0;
+    virtual int getImageMemPitch(char* ptr, int id, size_t& pitch) = 0;
+    virtual int getImageInfo(int id, ImageInfo& info) = 0;
+
+    /**
+     * @brief Store / restore the complete device configuration (AOI, format,
+     * timing, gain, ...) in a file in one operation
+     */
+    virtual int saveParameters(const std::string& file) = 0;
+    virtual int loadParameters(const std::string& file) = 0;
+
+    // Acquisition
+    virtual int startCapture() = 0;
+    virtual int stopCapture() = 0;
+
+    /**
+     * @brief Expose one frame now
+     *
+     * Starts the exposure in TriggerMode::SOFTWARE and forces one without an
+     * edge in the hardware trigger modes. Triggers arriving while a frame is
+     * exposed are ignored, like on the sensor.
+     */
+    virtual int trigger() = 0;
+
+    virtual int enableFrameEvent() = 0;
+    virtual int disableFrameEvent() = 0;
+    virtual int waitFrameEvent(int timeoutMs) = 0;
+    virtual int getCaptureStatus(CaptureStatus& status) = 0;
+    virtual int resetCaptureStatus() = 0;
+
+    // Parameters
+    virtual int setPixelClock(unsigned int clock) = 0;
+    virtual int getPixelClock(unsigned int& clock) = 0;
+    virtual int setFrameRate(double fps, double& actual) = 0;
+    virtual int getFrameRate(double& fps) = 0;
+    virtual int setExposure(double& exposure) = 0;
+    virtual int getExposure(double& exposure) = 0;
+    virtual int setHardwareGamma(bool enable) = 0;
+    virtual int setGamma(int gamma) = 0;
+    virtual int setGainBoost(bool enable) = 0;
+    virtual int setAutoGain() = 0;
+    virtual int setGain(int value) = 0;
+    virtual int setGlobalShutter(bool enable) = 0;
+    virtual int setBlacklevelMode(bool autolevel) = 0;
+    virtual int setBlacklevelOffset(int offset) = 0;
+    virtual int setEdgeEnhancement(int level) = 0;
+    virtual int setHDR(bool enable) = 0;
+    virtual int setHDRKneepoints(const std::vector< std::pair<double, double> >& kneepoints) = 0;
+};
+
+}
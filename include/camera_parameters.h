@@ -0,0 +1,49 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+namespace lms_ueye_importer
+{
+
+/**
+ * Runtime camera parameters as configured (see UeyeCamera::applyParameters)
+ */
+struct CameraParameters
+{
+    CameraParameters() :
+        pixelClock(30),
+        frameRate(30.0),
+        exposure(0.0),
+        hardwareGamma(false),
+        gamma(1.0),
+        gainBoost(false),
+        gainAuto(false),
+        gain(0),
+        blacklevelAuto(true),
+        blacklevelOffset(0),
+        edgeEnhancement(0)
+    {
+    }
+
+    unsigned int pixelClock;    // MHz
+    double frameRate;           // fps
+    double exposure;            // ms, 0 = maximum for the frame rate
+
+    bool hardwareGamma;
+    double gamma;
+
+    bool gainBoost;
+    bool gainAuto;
+    int gain;                   // only used without gainAuto
+
+    bool blacklevelAuto;
+    int blacklevelOffset;
+
+    int edgeEnhancement;
+
+    // HDR is enabled if knee points are given
+    std::vector< std::pair<double, double> > hdrKneepoints;
+};
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "camera_backend.h"
+
+namespace lms_ueye_importer
+{
+
+/**
+ * Capture error counters sampled while capturing, published on
+ * CAMERA_CAPTURE_STATUS
+ */
+struct CaptureStatistics
+{
+    CaptureStatistics() :
+        timestamp(0),
+        totalRate(0.0),
+        numBuffers(0),
+        maxQueued(0),
+        queueOverflows(0)
+    {
+        status.total = 0;
+        status.counters.fill(0);
+        rates.fill(0.0);
+    }
+
+    int64_t timestamp;  // us, host time of the last sample
+
+    // counters since init
+    CaptureStatus status;
+
+    // events per second over the last sampling interval
+    double totalRate;
+    std::array<double, CaptureStatus::NUM_COUNTERS> rates;
+
+    // sequence buffers currently allocated
+    size_t numBuffers;
+
+    // deepest queue of captured frames waiting for delivery and frames lost
+    // because the queue was full, since start
+    size_t maxQueued;
+    uint64_t queueOverflows;
+};
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+namespace lms_ueye_importer
+{
+
+/**
+ * Instruction set extensions of the host CPU, detected once.
+ *
+ * Kernels for these extensions are compiled with per-function target
+ * attributes and selected at runtime, so the module itself needs no -march
+ * flags.
+ */
+struct CpuFeatures
+{
+    bool ssse3;
+    bool avx2;
+
+    static const CpuFeatures& get()
+    {
+        static const CpuFeatures features;
+        return features;
+    }
+
+private:
+    CpuFeatures() :
+        ssse3(false),
+        avx2(false)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        ssse3 = __builtin_cpu_supports("ssse3");
+        avx2 = __builtin_cpu_supports("avx2");
+#endif
+    }
+};
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "camera_backend.h"
+#include "thread_pool.h"
+
+namespace lms_ueye_importer
+{
+
+/**
+ * Bilinear demosaic of 8 bit Bayer frames into RGB8, BGRA8 or YUYV (BT.601).
+ *
+ * The interpolation and the interleaving into the output format happen in
+ * one pass, so the raw frame is read straight from the sequence buffer and
+ * every output byte is written once. Rows are split across a thread pool,
+ * the inner loop uses SSSE3 where available.
+ */
+class Demosaic
+{
+public:
+    Demosaic();
+
+    /**
+     * @param output RGB8, BGRA8 or YUYV
+     * @param threads threads working on one frame, 0 = all hardware threads
+     */
+    bool configure(BayerPattern pattern, PixelFormat output, size_t threads);
+
+    PixelFormat getOutput() const { return output; }
+
+    /**
+     * @brief Demosaic a frame. Width and height are expected to be even,
+     * an odd last column is left untouched.
+     */
+    void process(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, size_t width, size_t height);
+
+protected:
+    BayerPattern pattern;
+    PixelFormat output;
+    std::unique_ptr<ThreadPool> pool;
+
+    void processRows(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+                     size_t width, size_t height, size_t begin, size_t end);
+};
+
+}
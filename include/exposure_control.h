@@ -0,0 +1,156 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "frame.h"
+
+namespace lms_ueye_importer
+{
+
+/**
+ * Brightness of one analyzed frame and the settings chosen after it,
+ * published on CAMERA_EXPOSURE
+ */
+struct ExposureStatistics
+{
+    ExposureStatistics() :
+        frameNumber(0),
+        exposure(0.0),
+        gain(0),
+        samples(0),
+        mean(0.0),
+        median(0.0),
+        saturated(0.0),
+        updated(false),
+        nextExposure(0.0),
+        nextGain(0)
+    {}
+
+    uint64_t frameNumber;   // analyzed frame
+    double exposure;        // ms, settings the frame was taken with
+    int gain;               // -1 for hardware auto gain
+
+    size_t samples;         // pixels in the sparse histogram
+    double mean;            // 0..255
+    double median;          // 0..255
+    double saturated;       // fraction of samples at SATURATION_LEVEL or above
+
+    bool updated;           // new settings were requested after this frame
+    double nextExposure;    // ms, settings requested from the camera
+    int nextGain;
+};
+
+/**
+ * Tuning of ExposureController
+ */
+struct ExposureControlParameters
+{
+    ExposureControlParameters() :
+        target(110.0),
+        deadband(0.05),
+        responsiveness(0.7),
+        maxStep(0.5),
+        saturation(0.02),
+        minExposure(0.05),
+        maxExposure(1000.0),
+        maxGain(100),
+        maxGainFactor(4.0),
+        interval(2),
+        stepX(4),
+        stepY(4)
+    {}
+
+    double target;          // mean brightness 0..255
+    double deadband;        // relative brightness error left uncorrected
+    double responsiveness;  // fraction of the error (in stops) corrected per update, 0..1
+    double maxStep;         // largest relative change of exposure * gain per update
+    double saturation;      // fraction of saturated samples tolerated
+    double minExposure;     // ms
+    double maxExposure;     // ms, the frame period limits it further
+    int maxGain;            // 0..100, 0 keeps the gain at 0
+    double maxGainFactor;   // amplification at gain 100, sensor dependent
+    size_t interval;        // frames between updates at least
+    size_t stepX;           // histogram of every stepX-th pixel ...
+    size_t stepY;           // ... of every stepY-th row
+};
+
+/**
+ * Software auto exposure / auto gain.
+ *
+ * Each frame is reduced to a sparse 256 bin histogram of its brightness. The
+ * correction is computed in stops (log2 of exposure * gain factor): the
+ * error between target and mean brightness is damped by responsiveness,
+ * ignored within the deadband and limited to maxStep per update. Too many
+ * saturated samples always step down. Exposure is raised first up to its
+ * limit, then the gain, and the gain is lowered first.
+ *
+ * Settings take a few frames to show up, so the controller only acts on
+ * frames taken with the settings currently applied (see FrameInfo::exposure)
+ * and at most every interval frames. This keeps it from reacting twice to the
+ * same error.
+ */
+class ExposureController
+{
+public:
+    // samples counted as saturated, on the 8 bit scale
+    static const unsigned SATURATION_LEVEL = 250;
+
+    ExposureController();
+
+    void setParameters(const ExposureControlParameters& parameters);
+    const ExposureControlParameters& getParameters() const { return parameters; }
+
+    // MONO8/10/12/16, BAYER8, RGB8 and YUYV frames, not packed or BGRA8
+    static bool supports(PixelFormat format);
+
+    /**
+     * @brief Analyze a frame and compute the next settings
+     * @param info metadata of the frame including the settings it was taken with
+     * @param exposure ms, exposure currently applied to the camera
+     * @param gain gain currently applied, -1 for hardware auto gain (the
+     * controller then only adjusts the exposure)
+     * @param maxExposure ms, longest exposure at the current frame rate
+     * @return true if the camera should switch to getExposure() / getGain()
+     */
+    bool update(const Frame& frame, const FrameInfo& info, double exposure, int gain, double maxExposure);
+
+    double getExposure() const { return statistics.nextExposure; }
+    int getGain() const { return statistics.nextGain; }
+
+    // Analysis of the last frame passed to update
+    const ExposureStatistics& getStatistics() const { return statistics; }
+    const std::array<uint32_t, 256>& getHistogram() const { return histogram; }
+
+    /**
+     * @brief Add every stepX-th of the first width samples of every stepY-th
+     * row to bins. The samples are spread over four partial histograms
+     * (dense rows read 64 bits at a time) that are merged at the end, so
+     * runs of equal values do not serialize on one counter.
+     * @param stride bytes per row
+     */
+    static void histogram8(const uint8_t* src, size_t stride, size_t width, size_t height,
+                           size_t stepX, size_t stepY, uint32_t* bins);
+
+    // The same for 16 bit samples, reduced to 8 bit by shift
+    static void histogram16(const uint16_t* src, size_t stride, size_t width, size_t height,
+                            size_t stepX, size_t stepY, unsigned shift, uint32_t* bins);
+
+protected:
+    ExposureControlParameters parameters;
+    ExposureStatistics statistics;
+    std::array<uint32_t, 256> histogram;
+
+    // frame number of the last update
+    uint64_t lastUpdate;
+    bool haveUpdate;
+
+    // Fill histogram from the sampled pixels, false if the format is not supported
+    bool analyze(const Frame& frame);
+
+    double gainFactor(int gain) const;
+    int gainFor(double factor) const;
+};
+
+}
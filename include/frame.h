@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "camera_backend.h"
+
+namespace lms_ueye_importer
+{
+
+/**
+ * View of a captured frame as published on the CAMERA_FRAME channel.
+ *
+ * In zero-copy mode the data points directly into a locked sequence buffer
+ * of the driver. The buffer stays locked as long as any copy of the lease
+ * is alive, so consumers that need the pixels beyond the current cycle just
+ * keep a copy of the Frame. Dropping all copies hands the buffer back to
+ * the driver. All copies have to be dropped before the camera is
+ * deinitialized, UeyeCamera::deinit waits for them.
+ */
+struct Frame
+{
+    Frame() :
+        data(NULL),
+        width(0),
+        height(0),
+        stride(0),
+        format(PixelFormat::MONO8),
+        zeroCopy(false)
+    {}
+
+    const uint8_t* data;
+    size_t width;
+    size_t height;
+    size_t stride; // bytes per row
+    PixelFormat format;
+
+    // true if data points into a driver buffer, false if it is a copy
+    bool zeroCopy;
+
+    // keeps the underlying memory valid (and the sequence buffer locked)
+    std::shared_ptr<const void> lease;
+
+    bool valid() const { return NULL != data; }
+};
+
+/**
+ * Metadata of the frame published in the same cycle, on CAMERA_FRAME_INFO.
+ *
+ * Device times are taken from the camera clock, host times are lms::Time
+ * microseconds.
+ */
+struct FrameInfo
+{
+    FrameInfo() :
+        frameNumber(0),
+        seqNum(0),
+        bufferId(0),
+        deviceTimestamp(0),
+        eventTimestamp(0),
+        publishTimestamp(0),
+        triggerTimestamp(0),
+        transferTime(0),
+        buffersInUse(0),
+        queued(0),
+        gap(0),
+        dropped(0),
+        droppedTotal(0),
+        age(0),
+        exposure(0.0),
+        gain(0)
+    {}
+
+    uint64_t frameNumber;       // device frame counter
+    int seqNum;                 // 1-based sequence buffer number
+    int bufferId;               // image memory id
+
+    uint64_t deviceTimestamp;   // us, camera clock
+    int64_t eventTimestamp;     // us, host time of the frame event
+    int64_t publishTimestamp;   // us, host time of publishing
+    int64_t triggerTimestamp;   // us, host time of the software trigger, 0 if not triggered
+
+    uint32_t transferTime;      // us, driver transfer/processing time
+    uint32_t buffersInUse;      // sequence buffers in use at capture time
+    uint32_t queued;            // later frames waiting for delivery (FIFO delivery)
+
+    // computed relative to the previously published frame
+    int64_t gap;                // us, device time since previous frame
+    uint64_t dropped;           // frames skipped since previous frame
+    uint64_t droppedTotal;      // frames skipped since start
+    int64_t age;                // us, publishTimestamp - eventTimestamp
+
+    // settings the frame was taken with, see UeyeCamera::setSettingsDelay
+    double exposure;            // ms
+    int gain;                   // master gain 0..100, -1 for hardware auto gain
+};
+
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <lms/logger.h>
+
+#include "frame.h"
+#include "lossless_codec.h"
+#include "spsc_ring.h"
+
+namespace lms_ueye_importer
+{
+
+/**
+ * Recorder counters, see FrameRecorder::getStatistics
+ */
+struct RecorderStatistics
+{
+    RecorderStatistics() :
+        recorded(0),
+        dropped(0),
+        bytes(0),
+        segments(0),
+        queued(0),
+        rawBytes(0),
+        ratio(1.0),
+        encodeTime(0.0),
+        meanEncodeTime(0.0),
+        maxEncodeTime(0.0)
+    {}
+
+    uint64_t recorded;  // frames on disk
+    uint64_t dropped;   // frames not recorded (queue full, no buffer, write error)
+    uint64_t bytes;     // pixel bytes written (compressed size)
+    uint64_t segments;  // segment files started
+    size_t queued;      // frames waiting for the writer
+
+    // Compression, ratio and encodeTime (ms) of the last frame
+    uint64_t rawBytes;  // pixel bytes before compression
+    double ratio;
+    double encodeTime;
+    double meanEncodeTime;
+    double maxEncodeTime;
+};
+
+/**
+ * Records raw frames to memory-mapped segment files from a writer thread.
+ *
+ * push() only queues the frame: a lent frame keeps its sequence buffer
+ * locked until the writer has copied the pixels into the mapped file, so
+ * frames go from the driver buffer to the page cache with a single copy and
+ * the capture loop never waits for the disk. A full queue drops the frame.
+ *
+ * Files written for a prefix P:
+ *  - P_0000.seg, P_0001.seg, ...: a SegmentHeader followed by records, each
+ *    a RecordHeader and the rows of the frame without padding, aligned to
+ *    64 bytes. Segments are preallocated to the segment size and truncated
+ *    to the used size when they are closed.
+ *  - P.idx: one IndexEntry per recorded frame
+ *
+ * With compression enabled the writer encodes the rows with LosslessCodec
+ * straight into the mapped segment; frames that do not get smaller and
+ * packed formats are stored raw (see RecordHeader::encoding).
+ *
+ * All fields are little endian.
+ */
+class FrameRecorder
+{
+public:
+    // Longest possible queue
+    static const size_t MAX_QUEUE = 64;
+
+    struct SegmentHeader
+    {
+        char magic[8];          // "UEYEREC"
+        uint32_t version;
+        uint32_t headerSize;    // sizeof(SegmentHeader)
+        uint64_t segmentSize;   // preallocated size
+        uint64_t usedSize;      // bytes up to the end of the last record
+        uint32_t frames;
+        uint8_t reserved[28];
+    };
+
+    struct RecordHeader
+    {
+        uint32_t magic;         // RECORD_MAGIC
+        uint32_t format;        // PixelFormat
+        uint32_t width;
+        uint32_t height;
+        uint32_t rowBytes;      // of the decoded rows
+        uint32_t encoding;      // ENCODING_RAW or ENCODING_LOSSLESS
+        uint64_t payloadSize;   // rowBytes * height if raw
+        uint64_t frameNumber;
+        uint64_t deviceTimestamp;
+        int64_t eventTimestamp;
+        uint64_t dropped;       // frames skipped by the camera before this one
+    };
+
+    struct IndexEntry
+    {
+        uint64_t frameNumber;
+        int64_t eventTimestamp;
+        uint32_t segment;
+        uint32_t reserved;
+        uint64_t offset;        // of the RecordHeader in the segment
+    };
+
+    static const uint32_t VERSION = 2;
+    static const uint32_t RECORD_MAGIC = 0x304d5246; // "FRM0"
+
+    static const uint32_t ENCODING_RAW = 0;
+    static const uint32_t ENCODING_LOSSLESS = 1;
+
+    explicit FrameRecorder(lms::logging::Logger& logger);
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    /**
+     * @param prefix path prefix of the segment and index files
+     * @param segmentSize bytes per segment file
+     * @param queueDepth frames waiting for the writer, at most MAX_QUEUE
+     */
+    bool open(const std::string& prefix, size_t segmentSize, size_t queueDepth);
+
+    /**
+     * @brief Compress frames on the given number of threads (including the
+     * writer), 0 stores them raw. Only while closed.
+     */
+    void setCompression(size_t threads);
+
+    // Write the queued frames and close all files
+    void close();
+    bool isOpen() const { return running; }
+
+    /**
+     * @brief Queue a frame for writing without blocking. Invalid frames
+     * (no buffer could be lent) and frames that do not fit into the queue
+     * are counted as dropped.
+     */
+    void push(const Frame& frame, const FrameInfo& info);
+
+    RecorderStatistics getStatistics() const;
+
+protected:
+    struct Item
+    {
+        Frame frame;
+        FrameInfo info;
+    };
+
+    lms::logging::Logger& logger;
+
+    std::string prefix;
+    size_t segmentSize;
+    size_t queueDepth;
+
+    // Module thread -> writer thread
+    SpscRing<Item, MAX_QUEUE> queue;
+    std::thread writer;
+    std::atomic<bool> running;
+    std::atomic<bool> writerWaiting;
+    std::mutex wakeupMutex;
+    std::condition_variable wakeup;
+
+    // Writer thread state
+    int segmentFd;
+    uint8_t* segment;
+    size_t used;
+    uint32_t segmentNumber;
+    FILE* index;
+    std::unique_ptr<LosslessCodec> codec;
+
+    std::atomic<uint64_t> recorded;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> segments;
+    std::atomic<uint64_t> rawBytes;
+    std::atomic<double> ratio;
+    std::atomic<double> encodeTime;
+    std::atomic<double> totalEncodeTime;
+    std::atomic<double> maxEncodeTime;
+
+    void run();
+    bool write(const Item& item);
+    bool nextSegment();
+    void closeSegment();
+};
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+
+#include "camera_backend.h"
+
+namespace lms_ueye_importer
+{
+
+/**
+ * One block of memory the sequence buffers are carved from, registered
+ * with the driver as user memory instead of letting it allocate every
+ * buffer separately.
+ *
+ * The block is backed by huge pages where the system provides them
+ * (reserved hugetlbfs pages first, transparent huge pages otherwise), so
+ * a whole ring of buffers needs a handful of TLB entries instead of one
+ * per 4 KiB. Buffers start on ALIGNMENT and their rows are padded to it,
+ * so row starts are aligned for the SIMD kernels as well.
+ */
+class ImageArena
+{
+public:
+    static const size_t ALIGNMENT = 64;
+
+    enum class Pages
+    {
+        NONE,               // not allocated
+        BASE,               // 4 KiB pages
+        TRANSPARENT_HUGE,   // transparent huge pages requested (madvise)
+        HUGETLB             // reserved huge pages (MAP_HUGETLB)
+    };
+
+    ImageArena();
+    ~ImageArena();
+
+    ImageArena(const ImageArena&) = delete;
+    ImageArena& operator=(const ImageArena&) = delete;
+
+    /**
+     * @brief Map size bytes, replacing a previous block
+     * @param hugePages try huge pages first
+     * @param lock keep the block resident (mlock), allocation still
+     * succeeds if the limit does not allow it, see isLocked
+     * @return false if no memory could be mapped
+     */
+    bool allocate(size_t size, bool hugePages, bool lock);
+
+    // Unmap the block, carved buffers become invalid
+    void release();
+
+    /**
+     * @brief Next size bytes of the block, aligned to ALIGNMENT
+     * @return NULL if the block is exhausted
+     */
+    char* carve(size_t size);
+
+    size_t getSize() const { return size; }
+    size_t getUsed() const { return used; }
+    Pages getPages() const { return pages; }
+    bool isLocked() const { return locked; }
+
+    static const char* name(Pages pages);
+
+    /**
+     * @brief Smallest width >= width whose rows are a multiple of ALIGNMENT
+     * bytes but not of 4 KiB, where consecutive rows would compete for the
+     * same cache sets
+     */
+    static size_t paddedWidth(PixelFormat format, size_t width);
+
+    // Bytes carved for one buffer of width x height
+    static size_t bufferSize(PixelFormat format, size_t width, size_t height);
+
+protected:
+    char* base;
+    size_t size;
+    size_t used;
+    Pages pages;
+    bool locked;
+};
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace lms_ueye_importer
+{
+
+/**
+ * Brightness of the 8 bit samples of a frame, gathered while the frame is
+ * copied out of the sequence buffer and published on
+ * CAMERA_IMAGE_STATISTICS
+ */
+struct ImageStatistics
+{
+    static const size_t NUM_BINS = 16;
+
+    ImageStatistics() :
+        saturationLevel(250)
+    {
+        reset();
+    }
+
+    // Clear the accumulated values, saturationLevel is kept
+    void reset()
+    {
+        frameNumber = 0;
+        pixels = 0;
+        sum = 0;
+        min = 255;
+        max = 0;
+        saturated = 0;
+        mean = 0.0;
+        histogram.fill(0);
+    }
+
+    uint64_t frameNumber;   // device frame counter, see FrameInfo
+    uint64_t pixels;        // samples, 0 if the frame has no 8 bit samples
+
+    uint64_t sum;
+    double mean;
+    uint8_t min;
+    uint8_t max;
+
+    uint8_t saturationLevel;
+    uint64_t saturated;     // samples at saturationLevel or above
+
+    // bin i counts the values 16 * i to 16 * i + 15 of the rows sampled
+    // for the histogram (see UeyeCamera::setImageStatistics)
+    std::array<uint64_t, NUM_BINS> histogram;
+};
+
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace lms_ueye_importer
+{
+
+/**
+ * Distribution of one latency, times in us
+ */
+struct LatencySummary
+{
+    LatencySummary() :
+        count(0),
+        mean(0.0),
+        p50(0.0),
+        p99(0.0),
+        max(0.0)
+    {}
+
+    uint64_t count;
+    double mean;
+    double p50;
+    double p99;
+    double max;
+};
+
+/**
+ * Latencies of the capture path since init, published on CAMERA_LATENCY
+ */
+struct LatencyStatistics
+{
+    enum Stage
+    {
+        WAIT,       // waitForFrame blocked until a frame was ready
+        QUEUE,      // frame event until the consumer took the frame
+        LOCK,       // locking the sequence buffer
+        COPY,       // copying / converting out of the sequence buffer
+        TRANSFER,   // driver transfer and processing of the frame
+        PUBLISH,    // end of exposure until the frame was published
+        TRIGGER,    // software trigger until the frame was published
+        NUM_STAGES
+    };
+
+    LatencyStatistics() :
+        timestamp(0)
+    {}
+
+    int64_t timestamp;  // us, host time of the summary
+    std::array<LatencySummary, NUM_STAGES> stages;
+
+    static const char* name(Stage stage)
+    {
+        static const char* names[NUM_STAGES] = {
+            "WAIT",
+            "QUEUE",
+            "LOCK",
+            "COPY",
+            "TRANSFER",
+            "PUBLISH",
+            "TRIGGER"
+        };
+        return names[stage];
+    }
+};
+
+/**
+ * Lock-free log-linear histogram of durations in ns (HDR histogram style).
+ *
+ * Every power of two is split into 16 buckets, so percentiles are exact to
+ * about 3 %. record() is wait-free apart from updating the maximum and may be
+ * called from any thread; summaries taken concurrently can miss the samples
+ * being recorded at that moment.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(uint64_t nanos);
+    void reset();
+
+    LatencySummary summarize() const;
+
+protected:
+    static const unsigned SUB_BITS = 4;
+    // longest duration told apart, about 18 minutes
+    static const unsigned MAX_BITS = 40;
+    static const size_t NUM_BUCKETS = ( MAX_BITS - SUB_BITS + 1 ) << SUB_BITS;
+
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+
+    static size_t bucketOf(uint64_t nanos);
+    // middle of the values falling into a bucket
+    static uint64_t bucketValue(size_t bucket);
+};
+
+}
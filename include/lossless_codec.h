@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "camera_backend.h"
+#include "thread_pool.h"
+
+namespace lms_ueye_importer
+{
+
+/**
+ * Lossless compression of single frames for recording.
+ *
+ * Every sample is predicted from its left, upper and upper left neighbour of
+ * the same color (median edge detector as in LOCO-I / JPEG-LS) and the
+ * residuals are Rice coded with one parameter per block of 32 samples.
+ *
+ * The frame is cut into horizontal stripes that are coded independently,
+ * so encoding and decoding run in parallel on the thread pool.
+ *
+ * Encoded frame:
+ *  - uint32 number of stripes
+ *  - uint32 encoded size of every stripe
+ *  - the stripes
+ *
+ * Packed formats are not supported, they are stored as is.
+ */
+class LosslessCodec
+{
+public:
+    /**
+     * @param threads threads including the caller, see ThreadPool
+     */
+    explicit LosslessCodec(size_t threads = 1);
+
+    LosslessCodec(const LosslessCodec&) = delete;
+    LosslessCodec& operator=(const LosslessCodec&) = delete;
+
+    static bool supports(PixelFormat format);
+
+    /**
+     * @brief Encode a frame
+     * @param capacity space at dst, usually the raw size so that frames not
+     * worth compressing are stored raw
+     * @return encoded size, 0 if the format is not supported or the encoded
+     * frame does not fit into capacity
+     */
+    size_t encode(const uint8_t* src, size_t stride, PixelFormat format, size_t width, size_t height,
+                  uint8_t* dst, size_t capacity);
+
+    /**
+     * @brief Decode a frame written by encode
+     * @return false on corrupt or truncated data
+     */
+    bool decode(const uint8_t* src, size_t size, PixelFormat format, size_t width, size_t height,
+                uint8_t* dst, size_t stride);
+
+protected:
+    ThreadPool pool;
+
+    // Encoded stripes before they are copied together
+    std::vector< std::vector<uint8_t> > scratch;
+    std::vector<size_t> scratchSize;
+};
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "camera_backend.h"
+
+namespace lms_ueye_importer
+{
+
+enum class Orientation
+{
+    NORMAL,
+    FLIP_HORIZONTAL,    // mirror left / right
+    FLIP_VERTICAL,      // mirror top / bottom
+    ROTATE_180          // both, for upside down mounted cameras
+};
+
+/**
+ * Crop, flip / rotation and an 8 bit lookup table applied to the output of
+ * captureImage while it is written.
+ *
+ * Rows are produced in output order: each output row is read from its
+ * source row once, reversed and mapped through the table in registers
+ * (SSSE3/AVX2 where available) and written once, so the transform replaces
+ * the plain copy instead of adding a pass. The crop rectangle is given in
+ * source coordinates and applied before the flip.
+ */
+class OutputTransform
+{
+public:
+    OutputTransform();
+
+    /**
+     * @param cropWidth 0 extends the crop to the right edge
+     * @param cropHeight 0 extends the crop to the bottom edge
+     * @param lut 256 entries, empty for none. BGRA8 keeps its alpha and
+     * YUYV its chroma unchanged.
+     * @return false if lut has the wrong size
+     */
+    bool configure(Orientation orientation, size_t cropX, size_t cropY, size_t cropWidth, size_t cropHeight,
+                   const std::vector<uint8_t>& lut);
+
+    /**
+     * @brief Fit the transform to frames of the given format and size
+     * @return false if the format is not supported or the crop lies
+     * outside of the frame (or splits YUYV pixel pairs), the transform is
+     * inactive then
+     */
+    bool prepare(PixelFormat format, size_t width, size_t height);
+
+    // true if the output differs from a plain copy of the prepared frame
+    bool isActive() const { return active; }
+
+    size_t getWidth() const { return outputWidth; }
+    size_t getHeight() const { return outputHeight; }
+
+    // MONO8, BAYER8, RGB8, BGRA8 and YUYV
+    static bool supports(PixelFormat format);
+
+    /**
+     * @brief Table out = ( 255 * (in / 255)^(1 / gamma) - 128 ) * contrast
+     * + 128 + brightness, empty if that is the identity
+     */
+    static std::vector<uint8_t> makeLut(double gamma, double contrast, double brightness);
+
+    /**
+     * @brief Transform a frame of the prepared format and size
+     * @param dst getWidth() x getHeight() output
+     */
+    void process(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride) const;
+
+    // Source row of output row y, for callers producing source rows themselves
+    size_t sourceRow(size_t y) const;
+
+    /**
+     * @brief Transform one row
+     * @param src full width source row as returned by sourceRow
+     */
+    void processRow(const uint8_t* src, uint8_t* dst) const;
+
+protected:
+    Orientation orientation;
+    size_t cropX;
+    size_t cropY;
+    size_t cropWidth;
+    size_t cropHeight;
+    std::vector<uint8_t> lut;
+    std::vector<uint8_t> lutDeltas; // lut in the layout of the vector lookup
+
+    // prepared geometry
+    PixelFormat format;
+    size_t outputWidth;
+    size_t outputHeight;
+    size_t pixelBytes;
+    bool flipHorizontal;
+    bool flipVertical;
+    bool active;
+};
+
+}
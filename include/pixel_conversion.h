@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "camera_backend.h"
+#include "image_statistics.h"
+
+namespace lms_ueye_importer
+{
+
+/**
+ * Storage bits per pixel of a pixel format (10 for MONO10_PACKED)
+ */
+size_t bitsPerPixel(PixelFormat format);
+
+/**
+ * Significant bits per pixel of a pixel format (12 for MONO12)
+ */
+size_t significantBits(PixelFormat format);
+
+/**
+ * Bytes needed for one unpadded row of width pixels
+ */
+size_t rowBytes(PixelFormat format, size_t width);
+
+/**
+ * Pixel kernels, vectorized with SSE2/SSSE3/AVX2 (selected at runtime) or
+ * NEON where available. All of them handle any pixel count.
+ *
+ * Packed formats use the GenICam Mono10p/Mono12p layout: pixels are stored
+ * LSB first without gaps (4 pixels in 5 bytes, 2 pixels in 3 bytes).
+ */
+namespace kernels
+{
+void unpackMono10p(const uint8_t* src, uint16_t* dst, size_t pixels);
+void unpackMono12p(const uint8_t* src, uint16_t* dst, size_t pixels);
+
+// dst = src >> shift, saturated to 8 bit
+void shiftMono16To8(const uint16_t* src, uint8_t* dst, size_t pixels, unsigned int shift);
+
+// dst = lut[src & mask]
+void lutMono16To8(const uint16_t* src, uint8_t* dst, size_t pixels, const uint8_t* lut, uint16_t mask);
+
+/**
+ * dst = src while adding the samples to sum, min, max, saturated and, if
+ * histogram is set, the histogram of stats (pixels and mean are left to the
+ * caller). Without dst the samples are only accumulated. The histogram costs
+ * several times the copy.
+ */
+void copyStatistics(const uint8_t* src, uint8_t* dst, size_t pixels, ImageStatistics& stats, bool histogram);
+}
+
+/**
+ * Converts frames of any mono format to 8 bit (linear or tone mapped) or to
+ * unpacked 16 bit. Frames are processed row by row so packed data goes
+ * through a small cache-resident scratch row only.
+ */
+class MonoConverter
+{
+public:
+    MonoConverter();
+
+    /**
+     * @param gamma 1.0 keeps the upper 8 significant bits, any other value
+     * applies out = 255 * (in / max)^(1 / gamma) through a lookup table.
+     * MONO8 is always copied unchanged.
+     */
+    void configure(PixelFormat format, double gamma);
+
+    PixelFormat getFormat() const { return format; }
+
+    void to8(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, size_t width, size_t height);
+
+    // Output keeps the significant bits LSB aligned
+    void to16(const uint8_t* src, size_t srcStride, uint16_t* dst, size_t dstStride, size_t width, size_t height);
+
+protected:
+    PixelFormat format;
+    bool useLut;
+    std::vector<uint8_t> lut;
+    std::vector<uint16_t> scratch;
+
+    void rowTo16(const uint8_t* src, uint16_t* dst, size_t width);
+};
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lms_ueye_importer
+{
+
+enum class PyramidFilter
+{
+    BOX,        // 2x2 mean
+    GAUSSIAN    // 3x3 binomial [1 2 1] x [1 2 1] / 16
+};
+
+/**
+ * Builds 8 bit image pyramids (1/2, 1/4, ... of the input size).
+ *
+ * Frames are streamed row by row: every source row is optionally copied to
+ * the full resolution output and the next level row is computed as soon as
+ * its input rows are available, so the source is read from memory once and
+ * all levels are built from cache-resident rows.
+ */
+class Pyramid
+{
+public:
+    Pyramid();
+
+    void configure(size_t levels, PyramidFilter filter);
+    size_t getLevels() const { return levels; }
+
+    /**
+     * @brief Size of a level, level 0 is the input size
+     */
+    static void levelSize(size_t width, size_t height, size_t level, size_t& levelWidth, size_t& levelHeight);
+
+    /**
+     * @param full copy of the source at full resolution (stride width),
+     * NULL to only build the levels
+     * @param out getLevels() tightly packed level buffers, 1/2 size first
+     */
+    void process(const uint8_t* src, size_t srcStride, uint8_t* full, size_t width, size_t height, uint8_t* const* out);
+
+protected:
+    size_t levels;
+    PyramidFilter filter;
+
+    // per frame state
+    std::vector<size_t> widths;
+    std::vector<size_t> heights;
+    std::vector<const uint8_t*> bases;
+    std::vector<size_t> strides;
+    uint8_t* const* outputs;
+    std::vector<uint16_t> scratch;
+
+    void rowDone(size_t level, size_t y);
+    const uint8_t* row(size_t level, size_t y) const;
+};
+
+}
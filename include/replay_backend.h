@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "frame_recorder.h"
+#include "lossless_codec.h"
+#include "simulated_backend.h"
+
+namespace lms_ueye_importer
+{
+
+enum class ReplayPacing
+{
+    REALTIME,   // recorded host timestamps, scaled by the speed factor
+    FIXED_RATE, // configured frame rate
+    MAX_SPEED   // next frame as soon as the previous one is delivered
+};
+
+/**
+ * Camera backend playing back a recording of FrameRecorder.
+ *
+ * The segment files are memory-mapped and every frame is copied from the
+ * mapping into the next free sequence buffer, in place of the transfer from
+ * the sensor, together with its recorded frame number and device time.
+ * Compressed frames are decoded into the sequence buffer instead.
+ * Everything behind the sequence buffers (zero-copy leases, conversion,
+ * recording, ...) works the same as with a camera.
+ *
+ * Format and size are fixed by the recording, the AOI can only cover the
+ * whole frame.
+ */
+class ReplayBackend : public SimulatedBackend
+{
+public:
+    /**
+     * @param prefix recording prefix as passed to FrameRecorder::open
+     * @param speed playback speed factor for REALTIME pacing
+     * @param loop start over at the end instead of stopping
+     * @param decodeThreads threads for decoding compressed frames
+     */
+    ReplayBackend(const std::string& prefix, ReplayPacing pacing, double speed, bool loop, size_t decodeThreads = 1);
+    ~ReplayBackend();
+
+    std::string name() const override { return "replay"; }
+
+    int open(uint32_t deviceId, const std::string& serial) override;
+    int close() override;
+    int getSensorInfo(SensorInfo& info) override;
+    std::string getLastError() override;
+
+    int setColorMode(PixelFormat format) override;
+    int setTriggerMode(TriggerMode mode) override;
+    int setAOI(size_t width, size_t height, size_t offsetX, size_t offsetY) override;
+    int setBinning(size_t horizontal, size_t vertical) override;
+    int setSubsampling(size_t horizontal, size_t vertical) override;
+    int setFrameRate(double fps, double& actual) override;
+    int startCapture() override;
+
+    // Valid after open
+    PixelFormat getRecordedFormat() const { return recordedFormat; }
+    size_t getFrameCount() const { return records.size(); }
+
+protected:
+    struct Segment
+    {
+        const uint8_t* data;
+        size_t size;
+    };
+
+    std::string prefix;
+    ReplayPacing pacing;
+    double speed;
+    bool loop;
+    std::string lastError;
+
+    std::vector<Segment> segments;
+    std::vector<const FrameRecorder::RecordHeader*> records;
+    PixelFormat recordedFormat;
+    LosslessCodec codec;
+
+    // Playback position, producer thread only
+    size_t cursor;
+    const FrameRecorder::RecordHeader* current;
+    bool restart;
+    Clock::time_point replayStart;
+    int64_t firstTimestamp;
+
+    bool scheduleFrame(Clock::time_point& next) override;
+    void produceFrame(char* dst, size_t rowBytes, size_t rows, PixelFormat format, ImageInfo& info) override;
+
+    bool load();
+    void unload();
+    void mapSegment(size_t number);
+};
+
+}
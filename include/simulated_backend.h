@@ -0,0 +1,188 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "camera_backend.h"
+
+namespace lms_ueye_importer
+{
+
+/**
+ * Camera backend without hardware.
+ *
+ * A producer thread renders a synthetic test pattern into the registered
+ * sequence buffers at the configured frame rate and signals the frame event,
+ * following the uEye ring-buffer semantics (locked buffers are skipped, a
+ * frame is dropped with DRV_OUT_OF_BUFFERS if every buffer is locked).
+ * The achievable frame rate is limited by the pixel clock and AOI size the
+ * same way a real sensor is. The pattern gets brighter with exposure and
+ * gain (1.0 at 10 ms and gain 0, 4.0 at gain 100) and, like on a real
+ * sensor, changes show up in the second frame after them.
+ *
+ * In the trigger modes the exposure starts on trigger() or, for the hardware
+ * modes, on the edges of a pulse generator running at the frame rate. Such a
+ * frame is exposed with the current settings and read out after the
+ * exposure time.
+ */
+class SimulatedBackend : public CameraBackend
+{
+public:
+    SimulatedBackend(size_t sensorWidth, size_t sensorHeight);
+    ~SimulatedBackend();
+
+    std::string name() const override { return "simulated"; }
+
+    int open(uint32_t deviceId, const std::string& serial) override;
+    int close() override;
+    int getSensorInfo(SensorInfo& info) override;
+    std::string getLastError() override;
+
+    int setColorMode(PixelFormat format) override;
+    int setTriggerMode(TriggerMode mode) override;
+    int setAOI(size_t width, size_t height, size_t offsetX, size_t offsetY) override;
+    int getImageSize(size_t& width, size_t& height) override;
+    int setBinning(size_t horizontal, size_t vertical) override;
+    int setSubsampling(size_t horizontal, size_t vertical) override;
+    int getFrameTimeRange(double& minTime, double& maxTime) override;
+
+    int allocImageMem(size_t width, size_t height, size_t bitsPerPixel, char** ptr, int* id) override;
+    int setAllocatedImageMem(size_t width, size_t height, size_t bitsPerPixel, char* ptr, int* id) override;
+    int freeImageMem(char* ptr, int id) override;
+    int addToSequence(char* ptr, int id) override;
+    int clearSequence() override;
+    int getActSeqBuf(int* seqNum, char** ptr) override;
+    int lockSeqBuf(char* ptr) override;
+    int unlockSeqBuf(char* ptr) override;
+    int copyImageMem(char* ptr, int id, char* dest) override;
+    int getImageMemPitch(char* ptr, int id, size_t& pitch) override;
+    int getImageInfo(int id, ImageInfo& info) override;
+
+    int saveParameters(const std::string& file) override;
+    int loadParameters(const std::string& file) override;
+
+    int startCapture() override;
+    int stopCapture() override;
+    int trigger() override;
+    int enableFrameEvent() override;
+    int disableFrameEvent() override;
+    int waitFrameEvent(int timeoutMs) override;
+    int getCaptureStatus(CaptureStatus& status) override;
+    int resetCaptureStatus() override;
+
+    int setPixelClock(unsigned int clock) override;
+    int getPixelClock(unsigned int& clock) override;
+    int setFrameRate(double fps, double& actual) override;
+    int getFrameRate(double& fps) override;
+    int setExposure(double& exposure) override;
+    int getExposure(double& exposure) override;
+    int setHardwareGamma(bool enable) override;
+    int setGamma(int gamma) override;
+    int setGainBoost(bool enable) override;
+    int setAutoGain() override;
+    int setGain(int value) override;
+    int setGlobalShutter(bool enable) override;
+    int setBlacklevelMode(bool autolevel) override;
+    int setBlacklevelOffset(int offset) override;
+    int setEdgeEnhancement(int level) override;
+    int setHDR(bool enable) override;
+    int setHDRKneepoints(const std::vector< std::pair<double, double> >& kneepoints) override;
+
+protected:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Buffer
+    {
+        char* ptr;
+        std::unique_ptr<char[]> data; // empty for memory of the caller
+        size_t size;
+        size_t pitch;
+        bool locked;
+        ImageInfo info;
+    };
+
+    std::mutex mutex;
+    std::condition_variable frameCondition;
+    std::condition_variable stateCondition;
+    std::thread producer;
+
+    bool opened;
+    bool running;
+    bool frameEventEnabled;
+    bool frameEvent;
+
+    size_t sensorWidth;
+    size_t sensorHeight;
+    size_t width;
+    size_t height;
+    PixelFormat format;
+
+    // Binning and subsampling factors, both shrink the readout
+    size_t binningX;
+    size_t binningY;
+    size_t subsamplingX;
+    size_t subsamplingY;
+
+    unsigned int pixelClock;
+    double frameRate;
+    double exposure;
+    int gain; // -1 = auto gain
+
+    // Brightness of the frame being exposed and of the frame being read
+    // out, which was exposed with the settings of one frame earlier
+    double exposingBrightness;
+    double frameBrightness;
+
+    int nextId;
+    std::unordered_map<int, Buffer> memory;
+    std::vector<int> sequence;
+    int activeIndex;
+
+    TriggerMode triggerMode;
+    bool triggerPending;
+
+    uint64_t frameCounter;
+    Clock::time_point startTime;
+    CaptureStatus captureStatus;
+
+    void run();
+    static void render(char* dst, size_t rowBytes, size_t rows, uint64_t frame, PixelFormat format, double brightness = 1.0);
+
+    // Pattern brightness for the current exposure and gain
+    double brightness() const;
+
+    /**
+     * @brief Time of the next frame, called by the producer thread with the
+     * mutex held
+     * @param next time of the previous frame on input
+     * @return false if no more frames follow
+     */
+    virtual bool scheduleFrame(Clock::time_point& next);
+
+    /**
+     * @brief Wait for the start of the next triggered exposure and expose
+     * it, called by the producer thread with the mutex held
+     * @param next time of the previous trigger edge on input
+     * @return false if stopped
+     */
+    bool waitTrigger(std::unique_lock<std::mutex>& lock, Clock::time_point& next);
+
+    /**
+     * @brief Fill a sequence buffer, called without the mutex held
+     * @param info preset with the sensor frame counter and time, may be
+     * replaced by the source
+     */
+    virtual void produceFrame(char* dst, size_t rowBytes, size_t rows, PixelFormat format, ImageInfo& info);
+
+    double maxFrameRate() const;
+    size_t readoutWidth() const { return sensorWidth / ( binningX * subsamplingX ); }
+    size_t readoutHeight() const { return sensorHeight / ( binningY * subsamplingY ); }
+    int setReduction(size_t horizontal, size_t vertical, size_t& factorX, size_t& factorY);
+    Buffer* findBuffer(char* ptr);
+};
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace lms_ueye_importer
+{
+
+/**
+ * Bounded lock-free ring for exactly one producer and one consumer thread.
+ *
+ * Capacity must be a power of two. push() fails instead of overwriting when
+ * the ring is full, the producer is expected to count that as an overflow.
+ */
+template<typename T, size_t Capacity>
+class SpscRing
+{
+    static_assert( Capacity >= 2 && ( Capacity & (Capacity - 1) ) == 0, "Capacity must be a power of two" );
+
+public:
+    SpscRing() :
+        head(0),
+        tail(0)
+    {}
+
+    // Producer side
+    bool push(const T& value)
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if( t - head.load(std::memory_order_acquire) == Capacity )
+        {
+            return false;
+        }
+        slots[t & (Capacity - 1)] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T& value)
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if( h == tail.load(std::memory_order_acquire) )
+        {
+            return false;
+        }
+        // move out so the slot does not keep resources (e.g. leases) alive
+        value = std::move(slots[h & (Capacity - 1)]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Consume all pending entries, keeping only the newest one
+     * @return number of entries consumed (0 if the ring was empty)
+     */
+    size_t popLatest(T& value)
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        const size_t t = tail.load(std::memory_order_acquire);
+        if( h == t )
+        {
+            return 0;
+        }
+        value = slots[(t - 1) & (Capacity - 1)];
+        head.store(t, std::memory_order_release);
+        return t - h;
+    }
+
+    // Consumer side
+    void clear()
+    {
+        head.store(tail.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    size_t size() const
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+protected:
+    std::array<T, Capacity> slots;
+
+    // head and tail on separate cache lines to avoid false sharing
+    char padSlots[64];
+    std::atomic<size_t> head;
+    char padHead[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail;
+    char padTail[64 - sizeof(std::atomic<size_t>)];
+};
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lms_ueye_importer
+{
+
+/**
+ * Fixed set of worker threads for splitting per-frame work into row ranges.
+ *
+ * The calling thread takes part in every job, so a pool of size 1 has no
+ * workers and runs everything inline.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @param threads total number of threads including the caller,
+     * 0 = number of hardware threads
+     */
+    explicit ThreadPool(size_t threads = 1);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size() + 1; }
+
+    /**
+     * @brief Run fn(begin, end) on contiguous parts of [0, count) and block
+     * until all parts are done
+     * @param grain parts are multiples of grain (except the last one)
+     */
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+protected:
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable startCondition;
+    std::condition_variable doneCondition;
+    bool running;
+
+    // current job, valid while pending > 0
+    const std::function<void(size_t, size_t)>* job;
+    std::vector< std::pair<size_t, size_t> > parts;
+    uint64_t generation;
+    size_t pending;
+
+    void work(size_t index);
+};
+
+}
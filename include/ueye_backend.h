@@ -0,0 +1,85 @@
+#pragma once
+
+#include <ueye.h>
+
+#include "camera_backend.h"
+
+namespace lms_ueye_importer
+{
+
+/**
+ * Backend talking to a physical camera through the uEye SDK
+ */
+class UeyeBackend : public CameraBackend
+{
+public:
+    UeyeBackend();
+    ~UeyeBackend();
+
+    std::string name() const override { return "ueye"; }
+
+    int open(uint32_t deviceId, const std::string& serial) override;
+    int close() override;
+    int getSensorInfo(SensorInfo& info) override;
+    std::string getLastError() override;
+
+    int setColorMode(PixelFormat format) override;
+    int setTriggerMode(TriggerMode mode) override;
+    int setAOI(size_t width, size_t height, size_t offsetX, size_t offsetY) override;
+    int getImageSize(size_t& width, size_t& height) override;
+    int setBinning(size_t horizontal, size_t vertical) override;
+    int setSubsampling(size_t horizontal, size_t vertical) override;
+    int getFrameTimeRange(double& minTime, double& maxTime) override;
+
+    int allocImageMem(size_t width, size_t height, size_t bitsPerPixel, char** ptr, int* id) override;
+    int setAllocatedImageMem(size_t width, size_t height, size_t bitsPerPixel, char* ptr, int* id) override;
+    int freeImageMem(char* ptr, int id) override;
+    int addToSequence(char* ptr, int id) override;
+    int clearSequence() override;
+    int getActSeqBuf(int* seqNum, char** ptr) override;
+    int lockSeqBuf(char* ptr) override;
+    int unlockSeqBuf(char* ptr) override;
+    int copyImageMem(char* ptr, int id, char* dest) override;
+    int getImageMemPitch(char* ptr, int id, size_t& pitch) override;
+    int getImageInfo(int id, ImageInfo& info) override;
+
+    int saveParameters(const std::string& file) override;
+    int loadParameters(const std::string& file) override;
+
+    int startCapture() override;
+    int stopCapture() override;
+    int trigger() override;
+    int enableFrameEvent() override;
+    int disableFrameEvent() override;
+    int waitFrameEvent(int timeoutMs) override;
+    int getCaptureStatus(CaptureStatus& status) override;
+    int resetCaptureStatus() override;
+
+    int setPixelClock(unsigned int clock) override;
+    int getPixelClock(unsigned int& clock) override;
+    int setFrameRate(double fps, double& actual) override;
+    int getFrameRate(double& fps) override;
+    int setExposure(double& exposure) override;
+    int getExposure(double& exposure) override;
+    int setHardwareGamma(bool enable) override;
+    int setGamma(int gamma) override;
+    int setGainBoost(bool enable) override;
+    int setAutoGain() override;
+    int setGain(int value) override;
+    int setGlobalShutter(bool enable) override;
+    int setBlacklevelMode(bool autolevel) override;
+    int setBlacklevelOffset(int offset) override;
+    int setEdgeEnhancement(int level) override;
+    int setHDR(bool enable) override;
+    int setHDRKneepoints(const std::vector< std::pair<double, double> >& kneepoints) override;
+
+protected:
+    HIDS handle;
+    TriggerMode triggerMode;
+
+    static INT colorMode(PixelFormat format);
+    static INT reductionMode(size_t horizontal, size_t vertical, bool subsampling);
+    static bool findDeviceId(const std::string& serial, uint32_t& deviceId);
+};
+
+}
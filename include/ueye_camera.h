@@ -1,5 +1,12 @@
 #pragma once
 
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <string>
 
@@ -7,18 +14,43 @@
 #include <lms/imaging/image.h>
 #include <lms/logger.h>
 
-#include <ueye.h>
+#include "buffer_table.h"
+#include "camera_backend.h"
+#include "camera_parameters.h"
+#include "capture_statistics.h"
+#include "demosaic.h"
+#include "frame.h"
+#include "frame_recorder.h"
+#include "image_statistics.h"
+#include "latency_histogram.h"
+#include "output_transform.h"
+#include "pixel_conversion.h"
+#include "pyramid.h"
+#include "spsc_ring.h"
 
 namespace lms_ueye_importer
 {
+
+/**
+ * Which frames captureImage / captureFrame deliver
+ */
+enum class DeliveryMode
+{
+    LATEST, // the newest frame, frames arriving in between are skipped
+    FIFO    // every frame once in capture order, queued frames stay locked
+};
+
 class UeyeCamera
 {
 public:
-    UeyeCamera(lms::logging::Logger &logger);
+    /**
+     * @param backend device backend, ownership is taken over by the camera
+     */
+    UeyeCamera(lms::logging::Logger &logger, CameraBackend* backend);
     ~UeyeCamera();
     
-    // Open camera device
-    bool open();
+    // Open camera device (device id 0 = first free camera)
+    bool open(uint32_t deviceId = 0, const std::string& serial = "");
     bool close();
     
     bool init();
@@ -29,22 +61,253 @@ public:
     bool start();
     bool stop();
 
+    /**
+     * @brief Expose one frame in TriggerMode::SOFTWARE (forces one in the
+     * hardware trigger modes)
+     *
+     * Frames of earlier triggers that were not captured yet are discarded,
+     * so the next frame waitForFrame reports is the one of this trigger.
+     */
+    bool trigger();
+
     // Capture image
     /**
-     * @brief waitForFrame
-     * @return true if the capturing was successfull
+     * @brief Wait until the acquisition thread has delivered a new frame
+     * @param timeOut maximum waiting time in milliseconds
+     * @return true if a new frame is ready for captureImage / captureFrame
      */
     bool waitForFrame(float timeOut = INFINITY);
-    bool captureImage(lms::imaging::Image& image);
+
+    /**
+     * @brief Copy the newest frame into an image of getOutputFormat()
+     *
+     * Formats with more than 8 bits are converted while copying (see
+     * setToneMapping), Bayer frames are demosaiced (see setColorOutput).
+     * The image is getOutputWidth() x getOutputHeight() (see
+     * setOutputTransform).
+     * If wide is given, the frame is additionally unpacked into a
+     * camera-owned 16 bit buffer in the same pass over the locked sequence
+     * buffer.
+     *
+     * @param levels images for the pyramid levels (see setPyramid), sized
+     * as reported by getPyramidSize
+     */
+    bool captureImage(lms::imaging::Image& image, Frame* wide = NULL, const std::vector<lms::imaging::Image*>* levels = NULL);
+
+    /**
+     * @brief Build the pyramid levels from a frame returned by captureFrame
+     * (8 bit grey frames only)
+     */
+    bool buildPyramid(const Frame& frame, const std::vector<lms::imaging::Image*>& levels);
+
+    /**
+     * @brief Hand out the newest frame without copying it
+     *
+     * The sequence buffer is locked and stays locked until every copy of
+     * frame.lease is gone. If lending it would leave the driver with fewer
+     * than minFreeBuffers buffers (or it cannot be locked), the frame is
+     * copied into a camera-owned buffer instead.
+     *
+     * @return true if a frame was available
+     */
+    bool captureFrame(Frame& frame);
+
+    /**
+     * @brief Pass every frame of captureImage / captureFrame to a recorder,
+     * NULL to stop recording. The sequence buffer is lent to the recorder
+     * under the same minFreeBuffers limit as captureFrame, frames without a
+     * free buffer are counted as dropped by the recorder.
+     */
+    void setRecorder(FrameRecorder* recorder) { this->recorder = recorder; }
+
+    /**
+     * @brief Gather ImageStatistics of every captured frame
+     *
+     * 8 bit frames copied unchanged by captureImage are copied and measured
+     * in one pass instead of is_CopyImageMem. Converted frames are measured
+     * on the 8 bit output right after the conversion, Bayer frames on the
+     * mosaic, and frames of captureFrame without copying. Frames without 8
+     * bit samples (zero-copy high bit depth) report 0 pixels.
+     *
+     * @param saturationLevel samples counted as saturated from this value on
+     * @param histogramStep rows between the rows added to the histogram,
+     * which costs several times the copy, 0 disables it
+     */
+    void setImageStatistics(bool enable, uint8_t saturationLevel, size_t histogramStep);
+    const ImageStatistics& getImageStatistics() { return imageStatistics; }
 
     // Info
     size_t getWidth() { return width; }
     size_t getHeight() { return height; }
 
+    // Size of the images written by captureImage
+    size_t getOutputWidth() { return transform.isActive() ? transform.getWidth() : width; }
+    size_t getOutputHeight() { return transform.isActive() ? transform.getHeight() : height; }
+
+    /**
+     * @brief Metadata of the frame returned by the last captureImage /
+     * captureFrame call (publish time and age are left to the caller)
+     */
+    const FrameInfo& getFrameInfo() { return frameInfo; }
+
+    size_t getLentBuffers() { return lentBuffers; }
+    uint64_t getRingOverflows() { return ringOverflows; }
+
+    /**
+     * @brief Average cost of converting high bit depth frames
+     * @return milliseconds per megapixel, 0 if nothing was converted yet
+     */
+    double getConversionCost();
+
     // Configuration
     bool setNumBuffers(size_t num);
+
+    /**
+     * @brief Carve the sequence buffers from one ImageArena registered as
+     * user memory instead of letting the driver allocate each one, must be
+     * called before init
+     * @param lock keep the arena resident (mlock, subject to RLIMIT_MEMLOCK)
+     *
+     * Rows are padded to ImageArena::paddedWidth, so the pitch of the
+     * frames exceeds the row length then.
+     */
+    bool setBufferArena(bool enable, bool lock);
+
+    // Must be called before init
+    bool setPixelFormat(PixelFormat format);
+    PixelFormat getPixelFormat() { return format; }
+
+    // Must be called before init
+    bool setTriggerMode(TriggerMode mode);
+    TriggerMode getTriggerMode() { return triggerMode; }
+
+    /**
+     * @brief Deliver the newest frame or every frame, must be called before
+     * init
+     *
+     * In FIFO mode the acquisition thread locks each captured buffer until
+     * it is delivered. If the consumer falls behind by all buffers the
+     * driver drops new frames (DRV_OUT_OF_BUFFERS), the frames already
+     * queued are kept.
+     */
+    bool setDeliveryMode(DeliveryMode mode);
+    DeliveryMode getDeliveryMode() { return deliveryMode; }
+
+    // Frames captured and not delivered yet
+    size_t getQueuedFrames() { return frameRing.size(); }
+
+    /**
+     * @brief 8 bit output of high bit depth formats
+     * @param gamma 1.0 keeps the upper 8 significant bits, other values apply
+     * a gamma curve over the full range
+     */
+    void setToneMapping(double gamma);
+
+    /**
+     * @brief Output of BAYER8 frames, must be called before init
+     * @param output RGB8, BGRA8, YUYV or BAYER8 to publish the raw mosaic
+     * @param threads demosaic threads, 0 = all hardware threads
+     */
+    bool setColorOutput(PixelFormat output, size_t threads);
+
+    // Override the Bayer pattern reported by the sensor
+    void setBayerPattern(BayerPattern pattern);
+
+    // Format of the images written by captureImage
+    PixelFormat getOutputFormat();
+
+    /**
+     * @brief Downscaled copies of 8 bit grey output, built while copying
+     * @param levels number of levels (1/2, 1/4, ...), 0 disables the pyramid
+     */
+    void setPyramid(size_t levels, PyramidFilter filter);
+    size_t getPyramidLevels() { return pyramid.getLevels(); }
+    void getPyramidSize(size_t level, size_t& levelWidth, size_t& levelHeight);
+
+    /**
+     * @brief Crop, flip / rotate and map the output of captureImage through
+     * a lookup table while it is copied (see OutputTransform)
+     *
+     * The crop is given in AOI coordinates and follows AOI changes, a crop
+     * that no longer fits leaves the output untransformed. Demosaiced frames
+     * are transformed after the demosaic, converted mono frames row by row.
+     * Pyramid levels and statistics are built from the transformed image,
+     * the 16 bit output and captureFrame are not transformed. Flipping or
+     * cropping a raw Bayer mosaic by an odd offset changes its pattern.
+     *
+     * @param lut 256 entries, empty for none
+     * @return false if the lookup table has the wrong size or the crop does
+     * not fit the current AOI
+     */
+    bool setOutputTransform(Orientation orientation, size_t cropX, size_t cropY, size_t cropWidth, size_t cropHeight,
+                            const std::vector<uint8_t>& lut);
+
+    void setMinFreeBuffers(size_t num) { minFreeBuffers = num; }
     bool setAOI(size_t width, size_t height, size_t offsetX = 0, size_t offsetY = 0);
+
+    /**
+     * @brief Sensor binning / subsampling factors (1 = off), must be called
+     * before init and before setAOI, whose coordinates are in reduced pixels
+     */
+    bool setBinning(size_t horizontal, size_t vertical);
+    bool setSubsampling(size_t horizontal, size_t vertical);
+
+    // Highest frame rate for the current pixel clock, AOI and binning (0 on error)
+    double getMaxFrameRate();
     
+    /**
+     * @brief Apply runtime parameters, skipping those that did not change
+     * since the last call
+     *
+     * The first call applies everything. Pixel clock, frame rate and
+     * exposure are applied in this order and a change also reapplies the
+     * following ones, as each limits the range of the next. Parameters
+     * that fail are retried on the next call.
+     *
+     * @return true if every changed parameter was applied
+     */
+    bool applyParameters( const CameraParameters& target );
+
+    /**
+     * @brief Set exposure and manual gain as the applied state, for software
+     * controllers. Unlike the direct setters the cache of applyParameters
+     * follows, so a later timing change keeps these values.
+     * @return true if both were applied
+     */
+    bool applyExposure( double exposure, int gain );
+
+    /**
+     * @brief Save the complete device configuration to a file
+     */
+    bool saveParameterSnapshot( const std::string& file );
+
+    /**
+     * @brief Restore a file written by saveParameterSnapshot in a single
+     * operation instead of applying every parameter, must be called before
+     * init
+     * @param snapshot parameters the file was saved with, taken over as the
+     * applied state by applyParameters
+     */
+    bool loadParameterSnapshot( const std::string& file, const CameraParameters& snapshot );
+
+    // Values read back from the camera by applyParameters
+    unsigned int getPixelClock() { return actualPixelClock; }
+    double getFrameRate() { return actualFrameRate; }
+    double getExposure() { return actualExposure; }
+    // -1 while the hardware auto gain is enabled
+    int getGain() { return actualGain; }
+
+    /**
+     * @brief Frames between the newest frame event and the first frame
+     * taken with a changed exposure or gain, used to tag FrameInfo with the
+     * settings in effect. Free running uEye sensors expose the next frame
+     * while the current one is read out, so new settings show up 2 frames
+     * later.
+     */
+    void setSettingsDelay(size_t frames) { settingsDelay = frames; }
+
+    // Direct setters, not tracked by applyParameters. Exposure and gain
+    // end up in getExposure / getGain and in the FrameInfo of later frames.
     bool setPixelClock( unsigned int clock );
     double setFrameRate( double fps );
     double setExposure( double exposure );
@@ -63,36 +326,236 @@ public:
     bool setHDR( bool enable );
     bool setHDRKneepoints( const std::vector< std::pair<double, double> >& kneepoints );
     
+    /**
+     * @brief Configure the capture status monitor thread
+     * @param interval sampling interval in milliseconds, 0 disables the monitor
+     * @param maxBuffers grow the sequence up to this many buffers when the
+     * driver runs out of buffers, 0 disables growing
+     */
+    bool setCaptureMonitor(float interval, size_t maxBuffers);
+    CaptureStatistics getCaptureStatistics();
+
+    /**
+     * @brief Add the sequence buffers requested by the capture monitor
+     *
+     * Capturing is stopped briefly while the buffers are added. Must be
+     * called from the thread that captures images.
+     */
+    bool growBuffers();
+    bool isBufferGrowthPending() { return requestedBuffers > numBuffers; }
+
+    /**
+     * @brief Change AOI and number of buffers of an initialized camera
+     *
+     * The new buffers are allocated while the camera keeps capturing, the
+     * switch itself only stops capturing for the AOI change. Buffers still
+     * lent to consumers are freed once they are handed back. On failure
+     * the previous AOI and buffers are restored.
+     *
+     * @return false if the new configuration could not be applied
+     */
+    bool reconfigure(size_t width, size_t height, size_t offsetX, size_t offsetY, size_t numBuffers);
+
+    // Capture blackout of the last reconfigure call in milliseconds
+    float getLastBlackout() { return lastBlackout; }
+    size_t getNumBuffers() { return numBuffers; }
+
+    /**
+     * @brief Add a latency sample, the capture path records all stages
+     * except PUBLISH itself. Thread-safe.
+     */
+    void recordLatency(LatencyStatistics::Stage stage, uint64_t nanos) { latency[stage].record(nanos); }
+    LatencyStatistics getLatencyStatistics() const;
+
     // Debug info
     void info();
     void logCaptureStatus();
+    void logLatency() const;
     
     // Error handling
     std::string getError();
     int getErrorCode();
     
 protected:
+
+    /**
+     * Ready buffer as reported by the acquisition thread
+     */
+    struct FrameEvent
+    {
+        BufferDescriptor* buffer;
+        int seqNum;
+        int64_t timestamp; // host time of the frame event (us)
+        int64_t trigger;   // host time of the last software trigger (us), 0 if none
+        ImageInfo info;
+    };
     
     lms::logging::Logger& logger;
     
-    HIDS handle;
-    INT status;
+    std::unique_ptr<CameraBackend> backend;
+    bool opened;
+    int status;
     
-    size_t format;
+    PixelFormat format;
+    TriggerMode triggerMode;
+    DeliveryMode deliveryMode;
     size_t width;
     size_t height;
+    size_t offsetX;
+    size_t offsetY;
     
     size_t numBuffers;
+    size_t minFreeBuffers;
+    size_t pitch;
+
+    bool arenaEnabled;
+    bool arenaLock;
     
     bool initialized;
     bool capturing;
     
-    std::unordered_map<char*, INT> buffers;
+    BufferTable buffers;
+
+    // Buffers replaced by reconfigure that are still lent to consumers
+    BufferTable retiredBuffers;
+    float lastBlackout; // ms
+
+    // Number of sequence buffers currently locked by a Frame lease,
+    // deinit waits on leaseReleased until it drops to 0. leaseMutex also
+    // orders releases against the FIFO scan of queueFrames.
+    std::atomic<size_t> lentBuffers;
+    std::mutex leaseMutex;
+    std::condition_variable leaseReleased;
+
+    // Acquisition thread waiting on the frame event
+    std::thread acquisitionThread;
+    std::atomic<bool> acquiring;
+    SpscRing<FrameEvent, 64> frameRing;
+    std::atomic<uint64_t> ringOverflows;
+    std::atomic<size_t> maxQueued;
+
+    // FIFO delivery: table index of the newest buffer the acquisition
+    // thread looked at (-1 before the first frame) and the newest frame
+    // number queued
+    int queuedIndex;
+    uint64_t queuedFrameNumber;
+
+    // Wakes a consumer blocked in waitForFrame
+    std::atomic<bool> consumerWaiting;
+    std::mutex wakeupMutex;
+    std::condition_variable wakeup;
+
+    // Capture status monitor thread
+    std::thread monitorThread;
+    std::mutex monitorMutex;
+    std::condition_variable monitorCondition;
+    bool monitoring;
+    float monitorInterval;
+    size_t maxBuffers;
+    std::atomic<size_t> requestedBuffers;
+    CaptureStatistics captureStatistics;
+
+    // Per stage latency since init
+    std::array<LatencyHistogram, LatencyStatistics::NUM_STAGES> latency;
+
+    // Parameters applied by applyParameters and the values read back
+    CameraParameters parameters;
+    bool parametersValid;
+    bool timingValid; // false after an AOI change
+    unsigned int actualPixelClock;
+    double actualFrameRate;
+    double actualExposure;
+    int actualGain;
+
+    /**
+     * Exposure / gain changes and the first frame number taken with them,
+     * the front entry applies to the frame delivered last
+     */
+    struct SettingsChange
+    {
+        uint64_t firstFrame;
+        double exposure;
+        int gain;
+    };
+    std::deque<SettingsChange> settingsHistory;
+    size_t settingsDelay;
+
+    // Newest frame number seen by the acquisition thread
+    std::atomic<uint64_t> latestFrameNumber;
+
+    // Host time of the last trigger call in TriggerMode::SOFTWARE (us)
+    std::atomic<int64_t> lastTrigger;
+
+    // Metadata of the last delivered frame
+    FrameInfo frameInfo;
+    uint64_t deliveredFrames;
+
+    // Receives the captured frames, not owned
+    FrameRecorder* recorder;
+
+    // Statistics of the last delivered frame
+    bool statisticsEnabled;
+    size_t histogramStep;
+    ImageStatistics imageStatistics;
+
+    // Fallback buffer for captureFrame when no sequence buffer can be lent
+    std::shared_ptr< std::vector<uint8_t> > copyBuffer;
+
+    // High bit depth conversion and the unpacked 16 bit output
+    MonoConverter converter;
+    double toneMapping;
+    std::shared_ptr< std::vector<uint16_t> > wideBuffer;
+    uint64_t conversionTime; // us
+    uint64_t convertedPixels;
+
+    // Bayer to color conversion
+    Demosaic demosaic;
+    PixelFormat colorOutput;
+    size_t demosaicThreads;
+    BayerPattern bayerPattern;
+    bool bayerPatternOverride;
+
+    // Downscaled outputs
+    Pyramid pyramid;
+    std::vector<uint8_t*> levelBuffers;
+
+    // Crop / flip / lookup table of the output, transformBuffer holds a
+    // converted row or a demosaiced frame before it is transformed
+    OutputTransform transform;
+    std::vector<uint8_t> transformBuffer;
 
-    static std::unordered_map<INT, std::string> errorCodes;
+    static std::unordered_map<int, std::string> errorCodes;
     
-    size_t getBPP();
+    void acquire();
+    // Lock and queue the buffers filled up to the one of event (FIFO delivery)
+    void queueFrames(const FrameEvent& event);
+    // Unlock the buffers of queued frames that will not be delivered
+    void releaseQueued();
+    void monitor();
+    // Append up to count buffers to table, to the driver sequence as well if sequence is set
+    size_t allocateMemory(BufferTable& table, size_t count, size_t width, size_t height, size_t& pitch, bool sequence);
+    // Arena for count buffers owned by table, NULL if disabled or not available
+    ImageArena* createArena(BufferTable& table, size_t count, size_t width, size_t height);
+    // Image memory from arena or, without one, from the driver
+    int allocImageMem(ImageArena* arena, size_t width, size_t height, char** ptr, int* id);
+    bool addToSequence(BufferTable& table);
+    void freeBuffers(BufferTable& table);
+    bool freeRetiredBuffers();
+    bool nextFrame(FrameEvent& event);
+    void updateFrameInfo(const FrameEvent& event, size_t consumed);
+    bool lendBuffer(BufferDescriptor* buf, Frame& frame);
+    void releaseBuffer(BufferDescriptor* buf);
+    bool copyFrame(BufferDescriptor* buf, Frame& frame);
+    void convertFrame(BufferDescriptor* buf, lms::imaging::Image& image, Frame* wide, const std::vector<lms::imaging::Image*>* levels);
+    uint8_t* const* pyramidBuffers(const std::vector<lms::imaging::Image*>& levels);
+    // Measure an 8 bit frame into imageStatistics, copying it to dst if given
+    void gatherStatistics(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, size_t width, size_t height);
+    // Fit the output transform to the output format and AOI
+    bool prepareTransform();
     void initParameters();
+    void readTiming();
+    // Tag the frames from latestFrameNumber + settingsDelay on with the current settings
+    void noteSettings();
     
     static void initErrorCodes();
 };
@@ -1,10 +1,17 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include <lms/module.h>
 #include <lms/config.h>
 #include <lms/imaging/image.h>
+#include <lms/time.h>
 
 #include "ueye_camera.h"
+#include "exposure_control.h"
+#include "replay_backend.h"
+#include "frame.h"
 
 namespace lms_ueye_importer {
 
@@ -19,9 +26,181 @@ public:
 
 protected:
 
-    lms::WriteDataChannel<lms::imaging::Image> imagePtr;
-    
-    UeyeCamera* camera;
+    /**
+     * One camera together with its output channels.
+     *
+     * Config keys are looked up as "<name>.<key>" first and fall back to
+     * "<key>", so settings shared by all cameras only need to be given once.
+     */
+    struct CameraContext
+    {
+        // empty for the single camera setup
+        std::string name;
+
+        UeyeCamera* camera;
+
+        // the channels below were obtained, not yet if opening failed
+        bool hasChannels;
+        lms::WriteDataChannel<lms::imaging::Image> imagePtr;
+        lms::WriteDataChannel<Frame> framePtr;
+        lms::WriteDataChannel<FrameInfo> frameInfoPtr;
+        lms::WriteDataChannel<CaptureStatistics> captureStatusPtr;
+
+        // Brightness statistics gathered while copying, if enabled
+        bool imageStatistics;
+        lms::WriteDataChannel<ImageStatistics> imageStatisticsPtr;
+
+        // Latency histograms summarized on CAMERA_LATENCY and in the log
+        lms::WriteDataChannel<LatencyStatistics> latencyPtr;
+        float latencyInterval;
+        float latencyLogInterval;
+        lms::Time lastLatencyPublish;
+        lms::Time lastLatencyLog;
+
+        // Raw recording of every frame, NULL if disabled
+        FrameRecorder* recorder;
+        lms::WriteDataChannel<RecorderStatistics> recorderStatusPtr;
+
+        // Backend of the camera if it plays back a recording, NULL otherwise
+        ReplayBackend* replay;
+
+        // Software auto exposure / gain, NULL if disabled
+        ExposureController* exposureControl;
+        lms::WriteDataChannel<ExposureStatistics> exposurePtr;
+
+        // Publish CAMERA_FRAME as a lease on the driver buffer instead of copying
+        bool zeroCopy;
+
+        // FIFO delivery: frames taken per cycle, with more than one they are
+        // also published together on CAMERA_FRAME_BATCH / CAMERA_FRAME_INFO_BATCH
+        size_t batchSize;
+        lms::WriteDataChannel< std::vector<Frame> > frameBatchPtr;
+        lms::WriteDataChannel< std::vector<FrameInfo> > frameInfoBatchPtr;
+
+        // num_buffers as last applied, buffer growth may have added more
+        size_t numBuffers;
+
+        // Publish high bit depth frames unpacked to 16 bit on CAMERA_FRAME
+        bool wideOutput;
+
+        // Start of initCamera, the delay to the first frame is logged once
+        lms::Time startTime;
+        bool firstFrame;
+
+        // Pyramid levels (1/2, 1/4, ...) and their images for this cycle
+        std::vector< lms::WriteDataChannel<lms::imaging::Image> > levelPtrs;
+        std::vector<lms::imaging::Image*> levelImages;
+    };
+
+    std::vector<CameraContext*> cameras;
+
+    // Wait until every camera has a new frame before publishing
+    bool syncCameras;
+
+    /**
+     * @brief Create the camera backend selected by the "backend" config key
+     * ("ueye", "simulated" or "replay")
+     */
+    CameraBackend* createBackend(CameraContext& ctx);
+
+    // Runtime camera parameters from the config
+    CameraParameters readParameters(const CameraContext& ctx);
+
+    // "mono8", "mono12", "mono12_packed", "bayer8", ...
+    static bool parsePixelFormat(const std::string& name, PixelFormat& format);
+    // "rgb", "bgra", "yuyv" or "raw"
+    static bool parseColorOutput(const std::string& name, PixelFormat& format);
+    // "rggb", "grbg", "gbrg" or "bggr"
+    static bool parseBayerPattern(const std::string& name, BayerPattern& pattern);
+    // "none", "horizontal", "vertical" or "rotate180"
+    static bool parseOrientation(const std::string& name, Orientation& orientation);
+    // "off", "software", "rising" or "falling"
+    static bool parseTriggerMode(const std::string& name, TriggerMode& mode);
+    // "latest" or "fifo"
+    static bool parseDeliveryMode(const std::string& name, DeliveryMode& mode);
+
+    // lms image format for the output of UeyeCamera::captureImage
+    static lms::imaging::Format imageFormat(PixelFormat format);
+
+    bool initCamera(CameraContext& ctx);
+
+    /**
+     * @brief Open the camera, retrying with exponential backoff for up to
+     * initTimeout ms while the device is busy (e.g. after a fast restart)
+     */
+    bool openCamera(CameraContext& ctx);
+
+    // Start recording if "record" is set
+    bool startRecorder(CameraContext& ctx);
+
+    /**
+     * @brief Parameter snapshot file for the current config, empty if warm
+     * starts are disabled. The name contains a hash of every config key that
+     * ends up in the snapshot, so a changed config never loads a stale one.
+     */
+    std::string snapshotFile(const CameraContext& ctx);
+    void deinitCamera(CameraContext& ctx);
+
+    // Apply a changed AOI / num_buffers to a running camera
+    void reconfigureCamera(CameraContext& ctx);
+    // Size CAMERA_IMAGE and the pyramid channels to the camera output size
+    void resizeChannels(CameraContext& ctx);
+
+    // Crop / flip / lookup table of CAMERA_IMAGE from the output_* keys
+    void configureOutputTransform(CameraContext& ctx);
+
+    bool captureCamera(CameraContext& ctx);
+
+    // Fill CAMERA_FRAME_INFO (and CAMERA_IMAGE_STATISTICS) for the frame captured in this cycle
+    void publishFrameInfo(CameraContext& ctx);
+
+    // Append the frame on CAMERA_FRAME / CAMERA_FRAME_INFO to the batch channels
+    void appendToBatch(CameraContext& ctx);
+
+    // Publish / log the latency histograms when their interval has passed
+    void publishLatency(CameraContext& ctx);
+
+    // Create, retune or remove the controller according to "auto_exposure"
+    void configureExposureControl(CameraContext& ctx);
+
+    /**
+     * @brief Feed the frame published in this cycle to the exposure
+     * controller and apply the settings it asks for
+     */
+    void controlExposure(CameraContext& ctx);
+
+    /**
+     * @brief Channel name of a camera, e.g. CAMERA_IMAGE for the single
+     * camera setup and CAMERA_IMAGE_FRONT for a camera named "front"
+     */
+    std::string channelName(const CameraContext& ctx, const std::string& base);
+
+    std::string configKey(const CameraContext& ctx, const std::string& key)
+    {
+        if( !ctx.name.empty() && config().hasKey(ctx.name + "." + key) )
+        {
+            return ctx.name + "." + key;
+        }
+        return key;
+    }
+
+    template<typename T>
+    T param(const CameraContext& ctx, const std::string& key)
+    {
+        return config().get<T>( configKey(ctx, key) );
+    }
+
+    template<typename T>
+    T param(const CameraContext& ctx, const std::string& key, const T& defaultValue)
+    {
+        return config().get<T>( configKey(ctx, key), defaultValue );
+    }
+
+    template<typename T>
+    std::vector<T> paramArray(const CameraContext& ctx, const std::string& key)
+    {
+        return config().getArray<T>( configKey(ctx, key) );
+    }
 };
 
 }  // namespace lms_ueye_importer
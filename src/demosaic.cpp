@@ -0,0 +1,378 @@
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DEMOSAIC_X86
+#endif
+
+#include <algorithm>
+
+#include "demosaic.h"
+#include "cpu_features.h"
+
+namespace lms_ueye_importer
+{
+
+namespace
+{
+
+/**
+ * Bayer rows around the row being interpolated, mirrored at the borders
+ * (mirroring keeps the color phase)
+ */
+struct Rows
+{
+    const uint8_t* up;
+    const uint8_t* cur;
+    const uint8_t* down;
+};
+
+inline uint8_t avg(unsigned int a, unsigned int b)
+{
+    // same rounding as pavgb
+    return uint8_t( ( a + b + 1 ) >> 1 );
+}
+
+/**
+ * Interpolate one pixel. "same" is the color sampled in this row (red in
+ * red rows, blue in blue rows), "other" the color of the other row type.
+ */
+inline void interpolate(const Rows& rows, size_t x, size_t width, bool colorPixel, uint8_t& same, uint8_t& green, uint8_t& other)
+{
+    const size_t l = x > 0 ? x - 1 : x + 1;
+    const size_t r = x + 1 < width ? x + 1 : x - 1;
+    const uint8_t h = avg(rows.cur[l], rows.cur[r]);
+    const uint8_t v = avg(rows.up[x], rows.down[x]);
+
+    if( colorPixel )
+    {
+        same = rows.cur[x];
+        green = avg(h, v);
+        other = avg( avg(rows.up[l], rows.up[r]), avg(rows.down[l], rows.down[r]) );
+    }
+    else
+    {
+        same = h;
+        green = rows.cur[x];
+        other = v;
+    }
+}
+
+inline void yuv(unsigned int r, unsigned int g, unsigned int b, uint8_t& y)
+{
+    y = uint8_t( ( ( 66 * r + 129 * g + 25 * b + 128 ) >> 8 ) + 16 );
+}
+
+inline void chroma(int r, int g, int b, uint8_t& u, uint8_t& v)
+{
+    u = uint8_t( ( ( -38 * r - 74 * g + 112 * b + 128 ) >> 8 ) + 128 );
+    v = uint8_t( ( ( 112 * r - 94 * g - 18 * b + 128 ) >> 8 ) + 128 );
+}
+
+// Writers store pixel pairs (x even) in the output format
+
+struct RgbWriter
+{
+    static const size_t BYTES = 3;
+
+    static void pair(uint8_t* dst, size_t x, const uint8_t (&r)[2], const uint8_t (&g)[2], const uint8_t (&b)[2])
+    {
+        uint8_t* p = dst + x * BYTES;
+        p[0] = r[0]; p[1] = g[0]; p[2] = b[0];
+        p[3] = r[1]; p[4] = g[1]; p[5] = b[1];
+    }
+
+#ifdef DEMOSAIC_X86
+    __attribute__((target("ssse3")))
+    static void block(uint8_t* dst, size_t x, __m128i r, __m128i g, __m128i b)
+    {
+        // byte i of the 48 byte output is channel i % 3 of pixel i / 3
+        const __m128i r0 = _mm_setr_epi8( 0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1,  5);
+        const __m128i g0 = _mm_setr_epi8(-1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1);
+        const __m128i b0 = _mm_setr_epi8(-1, -1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1);
+        const __m128i r1 = _mm_setr_epi8(-1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10, -1);
+        const __m128i g1 = _mm_setr_epi8( 5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10);
+        const __m128i b1 = _mm_setr_epi8(-1,  5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1);
+        const __m128i r2 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+        const __m128i g2 = _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+        const __m128i b2 = _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+
+        __m128i* p = reinterpret_cast<__m128i*>(dst + x * BYTES);
+        _mm_storeu_si128(p + 0, _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, r0), _mm_shuffle_epi8(g, g0)), _mm_shuffle_epi8(b, b0)));
+        _mm_storeu_si128(p + 1, _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, r1), _mm_shuffle_epi8(g, g1)), _mm_shuffle_epi8(b, b1)));
+        _mm_storeu_si128(p + 2, _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, r2), _mm_shuffle_epi8(g, g2)), _mm_shuffle_epi8(b, b2)));
+    }
+#endif
+};
+
+struct BgraWriter
+{
+    static const size_t BYTES = 4;
+
+    static void pair(uint8_t* dst, size_t x, const uint8_t (&r)[2], const uint8_t (&g)[2], const uint8_t (&b)[2])
+    {
+        uint8_t* p = dst + x * BYTES;
+        p[0] = b[0]; p[1] = g[0]; p[2] = r[0]; p[3] = 255;
+        p[4] = b[1]; p[5] = g[1]; p[6] = r[1]; p[7] = 255;
+    }
+
+#ifdef DEMOSAIC_X86
+    __attribute__((target("ssse3")))
+    static void block(uint8_t* dst, size_t x, __m128i r, __m128i g, __m128i b)
+    {
+        const __m128i alpha = _mm_set1_epi8(-1);
+        __m128i bgLo = _mm_unpacklo_epi8(b, g);
+        __m128i bgHi = _mm_unpackhi_epi8(b, g);
+        __m128i raLo = _mm_unpacklo_epi8(r, alpha);
+        __m128i raHi = _mm_unpackhi_epi8(r, alpha);
+
+        __m128i* p = reinterpret_cast<__m128i*>(dst + x * BYTES);
+        _mm_storeu_si128(p + 0, _mm_unpacklo_epi16(bgLo, raLo));
+        _mm_storeu_si128(p + 1, _mm_unpackhi_epi16(bgLo, raLo));
+        _mm_storeu_si128(p + 2, _mm_unpacklo_epi16(bgHi, raHi));
+        _mm_storeu_si128(p + 3, _mm_unpackhi_epi16(bgHi, raHi));
+    }
+#endif
+};
+
+struct YuyvWriter
+{
+    static const size_t BYTES = 2;
+
+    static void pair(uint8_t* dst, size_t x, const uint8_t (&r)[2], const uint8_t (&g)[2], const uint8_t (&b)[2])
+    {
+        uint8_t* p = dst + x * BYTES;
+        yuv(r[0], g[0], b[0], p[0]);
+        yuv(r[1], g[1], b[1], p[2]);
+        chroma(avg(r[0], r[1]), avg(g[0], g[1]), avg(b[0], b[1]), p[1], p[3]);
+    }
+
+#ifdef DEMOSAIC_X86
+    __attribute__((target("ssse3")))
+    static __m128i luma(__m128i r, __m128i g, __m128i b)
+    {
+        // 66 r + 129 g + 25 b + 128 fits into 16 bits unsigned
+        __m128i y = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+        y = _mm_add_epi16(y, _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)), _mm_set1_epi16(128)));
+        return _mm_add_epi16(_mm_srli_epi16(y, 8), _mm_set1_epi16(16));
+    }
+
+    __attribute__((target("ssse3")))
+    static __m128i pairAverage(__m128i v)
+    {
+        const __m128i low = _mm_set1_epi16(0x00FF);
+        __m128i sum = _mm_add_epi16(_mm_and_si128(v, low), _mm_srli_epi16(v, 8));
+        return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(1)), 1);
+    }
+
+    __attribute__((target("ssse3")))
+    static __m128i weigh(__m128i r, __m128i g, __m128i b, int16_t wr, int16_t wg, int16_t wb)
+    {
+        __m128i c = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(wr)), _mm_mullo_epi16(g, _mm_set1_epi16(wg)));
+        c = _mm_add_epi16(c, _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(wb)), _mm_set1_epi16(128)));
+        return _mm_add_epi16(_mm_srai_epi16(c, 8), _mm_set1_epi16(128));
+    }
+
+    __attribute__((target("ssse3")))
+    static void block(uint8_t* dst, size_t x, __m128i r, __m128i g, __m128i b)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i yLo = luma(_mm_unpacklo_epi8(r, zero), _mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(b, zero));
+        __m128i yHi = luma(_mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(b, zero));
+        __m128i y = _mm_packus_epi16(yLo, yHi);
+
+        // one chroma sample per pixel pair
+        __m128i ra = pairAverage(r);
+        __m128i ga = pairAverage(g);
+        __m128i ba = pairAverage(b);
+        __m128i u = weigh(ra, ga, ba, -38, -74, 112);
+        __m128i v = weigh(ra, ga, ba, 112, -94, -18);
+        __m128i uv = _mm_packus_epi16(u, v);
+        uv = _mm_unpacklo_epi8(uv, _mm_srli_si128(uv, 8));
+
+        __m128i* p = reinterpret_cast<__m128i*>(dst + x * BYTES);
+        _mm_storeu_si128(p + 0, _mm_unpacklo_epi8(y, uv));
+        _mm_storeu_si128(p + 1, _mm_unpackhi_epi8(y, uv));
+    }
+#endif
+};
+
+/**
+ * @param colorParity column parity of the non-green pixels in this row
+ * @param redRow true if this row holds red pixels
+ */
+template<class Writer>
+void scalarPairs(const Rows& rows, uint8_t* dst, size_t begin, size_t end, size_t width, size_t colorParity, bool redRow)
+{
+    uint8_t same[2], green[2], other[2];
+    for( size_t x = begin; x + 1 < end; x += 2 )
+    {
+        for( size_t i = 0; i < 2; ++i )
+        {
+            interpolate(rows, x + i, width, ( ( x + i ) & 1 ) == colorParity, same[i], green[i], other[i]);
+        }
+        if( redRow )
+        {
+            Writer::pair(dst, x, same, green, other);
+        }
+        else
+        {
+            Writer::pair(dst, x, other, green, same);
+        }
+    }
+}
+
+template<class Writer>
+void scalarRow(const Rows& rows, uint8_t* dst, size_t width, size_t colorParity, bool redRow)
+{
+    scalarPairs<Writer>(rows, dst, 0, width, width, colorParity, redRow);
+}
+
+#ifdef DEMOSAIC_X86
+
+__attribute__((target("ssse3")))
+inline __m128i select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+__attribute__((target("ssse3")))
+inline __m128i load(const uint8_t* p)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+template<class Writer>
+__attribute__((target("ssse3")))
+void vectorRow(const Rows& rows, uint8_t* dst, size_t width, size_t colorParity, bool redRow)
+{
+    // x stays even, so lane i has column parity i & 1
+    const __m128i even = _mm_set1_epi16(0x00FF);
+    const __m128i colorMask = colorParity == 0 ? even : _mm_andnot_si128(even, _mm_set1_epi8(-1));
+
+    // first pair needs mirroring on the left
+    scalarPairs<Writer>(rows, dst, 0, 2, width, colorParity, redRow);
+
+    size_t x = 2;
+    // loads reach x + 16
+    for( ; x + 17 <= width; x += 16 )
+    {
+        __m128i c = load(rows.cur + x);
+        __m128i h = _mm_avg_epu8(load(rows.cur + x - 1), load(rows.cur + x + 1));
+        __m128i v = _mm_avg_epu8(load(rows.up + x), load(rows.down + x));
+        __m128i d = _mm_avg_epu8(_mm_avg_epu8(load(rows.up + x - 1), load(rows.up + x + 1)),
+                                 _mm_avg_epu8(load(rows.down + x - 1), load(rows.down + x + 1)));
+
+        __m128i same = select(colorMask, c, h);
+        __m128i green = select(colorMask, _mm_avg_epu8(h, v), c);
+        __m128i other = select(colorMask, d, v);
+
+        if( redRow )
+        {
+            Writer::block(dst, x, same, green, other);
+        }
+        else
+        {
+            Writer::block(dst, x, other, green, same);
+        }
+    }
+
+    scalarPairs<Writer>(rows, dst, x, width, width, colorParity, redRow);
+}
+
+#endif // DEMOSAIC_X86
+
+template<class Writer>
+void demosaicRows(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+                  size_t width, size_t height, size_t begin, size_t end, BayerPattern pattern)
+{
+    // position of the red pixel in the top left 2x2 block
+    size_t redY = ( BayerPattern::GBRG == pattern || BayerPattern::BGGR == pattern ) ? 1 : 0;
+    size_t redX = ( BayerPattern::GRBG == pattern || BayerPattern::BGGR == pattern ) ? 1 : 0;
+
+#ifdef DEMOSAIC_X86
+    const bool vector = CpuFeatures::get().ssse3;
+#endif
+
+    for( size_t y = begin; y < end; ++y )
+    {
+        Rows rows;
+        rows.cur  = src + y * srcStride;
+        rows.up   = src + ( y > 0 ? y - 1 : 1 ) * srcStride;
+        rows.down = src + ( y + 1 < height ? y + 1 : height - 2 ) * srcStride;
+
+        const bool redRow = ( y & 1 ) == redY;
+        // blue sits diagonally to red
+        const size_t colorParity = redRow ? redX : 1 - redX;
+        uint8_t* out = dst + y * dstStride;
+
+#ifdef DEMOSAIC_X86
+        if( vector )
+        {
+            vectorRow<Writer>(rows, out, width, colorParity, redRow);
+            continue;
+        }
+#endif
+        scalarRow<Writer>(rows, out, width, colorParity, redRow);
+    }
+}
+
+}  // namespace
+
+Demosaic::Demosaic() :
+    pattern(BayerPattern::RGGB),
+    output(PixelFormat::RGB8),
+    pool(new ThreadPool(1))
+{
+}
+
+bool Demosaic::configure(BayerPattern pattern, PixelFormat output, size_t threads)
+{
+    if( PixelFormat::RGB8 != output && PixelFormat::BGRA8 != output && PixelFormat::YUYV != output )
+    {
+        return false;
+    }
+
+    this->pattern = pattern;
+    this->output = output;
+
+    size_t size = threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threads;
+    if( pool->size() != size )
+    {
+        pool.reset(new ThreadPool(size));
+    }
+    return true;
+}
+
+void Demosaic::process(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, size_t width, size_t height)
+{
+    if( width < 2 || height < 2 )
+    {
+        return;
+    }
+    width &= ~size_t(1);
+
+    // rows are independent, hand them out in small blocks
+    pool->parallelFor(height, 8, [&](size_t begin, size_t end) {
+        processRows(src, srcStride, dst, dstStride, width, height, begin, end);
+    });
+}
+
+void Demosaic::processRows(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+                           size_t width, size_t height, size_t begin, size_t end)
+{
+    switch( output )
+    {
+    case PixelFormat::RGB8:
+        demosaicRows<RgbWriter>(src, srcStride, dst, dstStride, width, height, begin, end, pattern);
+        break;
+    case PixelFormat::BGRA8:
+        demosaicRows<BgraWriter>(src, srcStride, dst, dstStride, width, height, begin, end, pattern);
+        break;
+    case PixelFormat::YUYV:
+        demosaicRows<YuyvWriter>(src, srcStride, dst, dstStride, width, height, begin, end, pattern);
+        break;
+    default:
+        break;
+    }
+}
+
+}
@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "exposure_control.h"
+#include "pixel_conversion.h"
+
+namespace lms_ueye_importer
+{
+
+const unsigned ExposureController::SATURATION_LEVEL;
+
+namespace
+{
+
+typedef std::array< std::array<uint32_t, 256>, 4 > PartialHistograms;
+
+void sampleRow(const uint8_t* row, size_t width, size_t step, PartialHistograms& partial)
+{
+    size_t x = 0;
+    if( 1 == step )
+    {
+        // eight samples per load, byte order does not matter here
+        for( ; x + 8 <= width; x += 8 )
+        {
+            uint64_t word;
+            std::memcpy(&word, row + x, sizeof(word));
+            partial[0][ word         & 0xFF]++;
+            partial[1][(word >>  8)  & 0xFF]++;
+            partial[2][(word >> 16)  & 0xFF]++;
+            partial[3][(word >> 24)  & 0xFF]++;
+            partial[0][(word >> 32)  & 0xFF]++;
+            partial[1][(word >> 40)  & 0xFF]++;
+            partial[2][(word >> 48)  & 0xFF]++;
+            partial[3][ word >> 56         ]++;
+        }
+    }
+    else if( 2 == step )
+    {
+        for( ; x + 8 <= width; x += 8 )
+        {
+            uint64_t word;
+            std::memcpy(&word, row + x, sizeof(word));
+            partial[0][ word         & 0xFF]++;
+            partial[1][(word >> 16)  & 0xFF]++;
+            partial[2][(word >> 32)  & 0xFF]++;
+            partial[3][(word >> 48)  & 0xFF]++;
+        }
+    }
+    else
+    {
+        for( ; x + 3 * step < width; x += 4 * step )
+        {
+            partial[0][row[x]]++;
+            partial[1][row[x + step]]++;
+            partial[2][row[x + 2 * step]]++;
+            partial[3][row[x + 3 * step]]++;
+        }
+    }
+
+    for( ; x < width; x += step )
+    {
+        partial[0][row[x]]++;
+    }
+}
+
+void merge(const PartialHistograms& partial, uint32_t* bins)
+{
+    for( size_t i = 0; i < 256; ++i )
+    {
+        bins[i] += partial[0][i] + partial[1][i] + partial[2][i] + partial[3][i];
+    }
+}
+
+}
+
+ExposureController::ExposureController() :
+    lastUpdate(0),
+    haveUpdate(false)
+{
+    histogram.fill(0);
+}
+
+void ExposureController::setParameters(const ExposureControlParameters& parameters)
+{
+    this->parameters = parameters;
+    this->parameters.stepX = std::max<size_t>(1, parameters.stepX);
+    this->parameters.stepY = std::max<size_t>(1, parameters.stepY);
+    this->parameters.responsiveness = std::min(1.0, std::max(0.0, parameters.responsiveness));
+    this->parameters.maxGain = std::min(100, std::max(0, parameters.maxGain));
+}
+
+bool ExposureController::supports(PixelFormat format)
+{
+    switch( format )
+    {
+    case PixelFormat::MONO8:
+    case PixelFormat::MONO10:
+    case PixelFormat::MONO12:
+    case PixelFormat::MONO16:
+    case PixelFormat::BAYER8:
+    case PixelFormat::RGB8:
+    case PixelFormat::YUYV:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void ExposureController::histogram8(const uint8_t* src, size_t stride, size_t width, size_t height,
+                                    size_t stepX, size_t stepY, uint32_t* bins)
+{
+    PartialHistograms partial = {};
+    for( size_t y = 0; y < height; y += stepY )
+    {
+        sampleRow(src + y * stride, width, stepX, partial);
+    }
+    merge(partial, bins);
+}
+
+void ExposureController::histogram16(const uint16_t* src, size_t stride, size_t width, size_t height,
+                                     size_t stepX, size_t stepY, unsigned shift, uint32_t* bins)
+{
+    PartialHistograms partial = {};
+    std::vector<uint8_t> reduced;
+    if( 1 == stepX )
+    {
+        reduced.resize(width);
+    }
+
+    for( size_t y = 0; y < height; y += stepY )
+    {
+        const uint16_t* row = reinterpret_cast<const uint16_t*>( reinterpret_cast<const uint8_t*>(src) + y * stride );
+        if( 1 == stepX )
+        {
+            // dense rows go through the vectorized shift first
+            kernels::shiftMono16To8(row, reduced.data(), width, shift);
+            sampleRow(reduced.data(), width, 1, partial);
+            continue;
+        }
+
+        size_t x = 0;
+        for( ; x + 3 * stepX < width; x += 4 * stepX )
+        {
+            partial[0][std::min(row[x] >> shift, 255)]++;
+            partial[1][std::min(row[x + stepX] >> shift, 255)]++;
+            partial[2][std::min(row[x + 2 * stepX] >> shift, 255)]++;
+            partial[3][std::min(row[x + 3 * stepX] >> shift, 255)]++;
+        }
+        for( ; x < width; x += stepX )
+        {
+            partial[0][std::min(row[x] >> shift, 255)]++;
+        }
+    }
+    merge(partial, bins);
+}
+
+bool ExposureController::analyze(const Frame& frame)
+{
+    histogram.fill(0);
+
+    const size_t stepX = parameters.stepX;
+    const size_t stepY = parameters.stepY;
+    switch( frame.format )
+    {
+    case PixelFormat::MONO8:
+        histogram8(frame.data, frame.stride, frame.width, frame.height, stepX, stepY, histogram.data());
+        break;
+    case PixelFormat::BAYER8:
+        // odd steps visit all four colors of the mosaic
+        histogram8(frame.data, frame.stride, frame.width, frame.height, stepX | 1, stepY | 1, histogram.data());
+        break;
+    case PixelFormat::RGB8:
+        // a step that is no multiple of 3 cycles through the channels
+        histogram8(frame.data, frame.stride, frame.width * 3, frame.height,
+                   stepX % 3 ? stepX : stepX + 1, stepY, histogram.data());
+        break;
+    case PixelFormat::YUYV:
+        // luma only
+        histogram8(frame.data, frame.stride, frame.width * 2, frame.height, 2 * stepX, stepY, histogram.data());
+        break;
+    case PixelFormat::MONO10:
+    case PixelFormat::MONO12:
+    case PixelFormat::MONO16:
+        histogram16(reinterpret_cast<const uint16_t*>(frame.data), frame.stride, frame.width, frame.height,
+                    stepX, stepY, significantBits(frame.format) - 8, histogram.data());
+        break;
+    default:
+        return false;
+    }
+
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t saturated = 0;
+    for( size_t i = 0; i < histogram.size(); ++i )
+    {
+        count += histogram[i];
+        sum += uint64_t(histogram[i]) * i;
+        if( i >= SATURATION_LEVEL )
+        {
+            saturated += histogram[i];
+        }
+    }
+
+    statistics.samples = count;
+    if( 0 == count )
+    {
+        return false;
+    }
+    statistics.mean = double(sum) / count;
+    statistics.saturated = double(saturated) / count;
+
+    uint64_t seen = 0;
+    for( size_t i = 0; i < histogram.size(); ++i )
+    {
+        seen += histogram[i];
+        if( 2 * seen >= count )
+        {
+            statistics.median = i;
+            break;
+        }
+    }
+    return true;
+}
+
+double ExposureController::gainFactor(int gain) const
+{
+    // unknown under hardware auto gain, the exposure is controlled alone
+    if( gain <= 0 )
+    {
+        return 1.0;
+    }
+    return 1.0 + ( parameters.maxGainFactor - 1.0 ) * gain / 100.0;
+}
+
+int ExposureController::gainFor(double factor) const
+{
+    if( parameters.maxGainFactor <= 1.0 )
+    {
+        return 0;
+    }
+    int gain = int( std::lround( ( factor - 1.0 ) / ( parameters.maxGainFactor - 1.0 ) * 100.0 ) );
+    return std::min(parameters.maxGain, std::max(0, gain));
+}
+
+bool ExposureController::update(const Frame& frame, const FrameInfo& info, double exposure, int gain, double maxExposure)
+{
+    statistics.frameNumber = info.frameNumber;
+    statistics.exposure = info.exposure;
+    statistics.gain = info.gain;
+    statistics.updated = false;
+    statistics.nextExposure = exposure;
+    statistics.nextGain = gain;
+
+    if( !frame.valid() || !analyze(frame) )
+    {
+        return false;
+    }
+
+    // Frames taken before the last change would be corrected twice
+    if( info.exposure != exposure || info.gain != gain )
+    {
+        return false;
+    }
+    if( haveUpdate && info.frameNumber >= lastUpdate && info.frameNumber < lastUpdate + parameters.interval )
+    {
+        return false;
+    }
+
+    // correction in stops
+    const double limit = std::log2( 1.0 + parameters.maxStep );
+    double stops = std::log2( parameters.target / std::max(statistics.mean, 1.0) );
+    if( statistics.saturated > parameters.saturation )
+    {
+        // clipped highlights make the mean too low, always step down
+        stops = -limit;
+    }
+    else if( std::abs(stops) <= std::log2( 1.0 + parameters.deadband ) )
+    {
+        return false;
+    }
+    else
+    {
+        stops = std::min(limit, std::max(-limit, stops * parameters.responsiveness));
+    }
+
+    // Exposure first, the gain makes up for what it cannot reach
+    const double total = exposure * gainFactor(gain) * std::exp2(stops);
+    const double longest = std::max(parameters.minExposure, std::min(parameters.maxExposure, maxExposure));
+    const double nextExposure = std::min(longest, std::max(parameters.minExposure, total));
+    const int nextGain = gain < 0 ? gain : gainFor( total / nextExposure );
+
+    // at the limits there is nothing left to change
+    if( std::abs(nextExposure - exposure) <= 1e-3 * exposure && nextGain == gain )
+    {
+        return false;
+    }
+
+    statistics.updated = true;
+    statistics.nextExposure = nextExposure;
+    statistics.nextGain = nextGain;
+    lastUpdate = info.frameNumber;
+    haveUpdate = true;
+    return true;
+}
+
+}
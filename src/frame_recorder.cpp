@@ -0,0 +1,380 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "frame_recorder.h"
+#include "pixel_conversion.h"
+
+namespace lms_ueye_importer
+{
+
+const size_t FrameRecorder::MAX_QUEUE;
+const uint32_t FrameRecorder::VERSION;
+const uint32_t FrameRecorder::RECORD_MAGIC;
+const uint32_t FrameRecorder::ENCODING_RAW;
+const uint32_t FrameRecorder::ENCODING_LOSSLESS;
+
+namespace
+{
+// Records start on cache line boundaries
+const size_t RECORD_ALIGNMENT = 64;
+
+size_t alignRecord(size_t size)
+{
+    return ( size + RECORD_ALIGNMENT - 1 ) & ~( RECORD_ALIGNMENT - 1 );
+}
+}
+
+FrameRecorder::FrameRecorder(lms::logging::Logger& logger) :
+    logger(logger),
+    segmentSize(0),
+    queueDepth(0),
+    running(false),
+    writerWaiting(false),
+    segmentFd(-1),
+    segment(NULL),
+    used(0),
+    segmentNumber(0),
+    index(NULL),
+    recorded(0),
+    dropped(0),
+    bytes(0),
+    segments(0),
+    rawBytes(0),
+    ratio(1.0),
+    encodeTime(0.0),
+    totalEncodeTime(0.0),
+    maxEncodeTime(0.0)
+{
+    static_assert( sizeof(SegmentHeader) == 64 && sizeof(RecordHeader) == 64 && sizeof(IndexEntry) == 32, "unexpected record layout" );
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    close();
+}
+
+bool FrameRecorder::open(const std::string& prefix, size_t segmentSize, size_t queueDepth)
+{
+    if( running )
+    {
+        logger.error("recorder") << "Recorder already open";
+        return false;
+    }
+
+    if( segmentSize <= sizeof(SegmentHeader) || queueDepth == 0 )
+    {
+        logger.error("recorder") << "Invalid segment size or queue depth";
+        return false;
+    }
+
+    index = fopen((prefix + ".idx").c_str(), "wb");
+    if( NULL == index )
+    {
+        logger.error("recorder") << "Could not create " << prefix << ".idx: " << strerror(errno);
+        return false;
+    }
+
+    this->prefix = prefix;
+    this->segmentSize = segmentSize;
+    this->queueDepth = std::min(queueDepth, MAX_QUEUE);
+    segmentNumber = 0;
+    recorded = 0;
+    dropped = 0;
+    bytes = 0;
+    segments = 0;
+    rawBytes = 0;
+    ratio = 1.0;
+    encodeTime = 0.0;
+    totalEncodeTime = 0.0;
+    maxEncodeTime = 0.0;
+
+    running = true;
+    writer = std::thread(&FrameRecorder::run, this);
+    return true;
+}
+
+void FrameRecorder::setCompression(size_t threads)
+{
+    if( running )
+    {
+        logger.error("recorder") << "Compression can only be changed while the recorder is closed";
+        return;
+    }
+    codec.reset( threads > 0 ? new LosslessCodec(threads) : NULL );
+}
+
+void FrameRecorder::close()
+{
+    if( !running )
+    {
+        return;
+    }
+
+    // The writer drains the queue before it exits
+    running = false;
+    {
+        std::lock_guard<std::mutex> lock(wakeupMutex);
+        wakeup.notify_one();
+    }
+    if( writer.joinable() )
+    {
+        writer.join();
+    }
+
+    closeSegment();
+    fclose(index);
+    index = NULL;
+
+    logger.info("recorder") << "Recorded " << recorded << " frames (" << ( bytes >> 20 ) << " MB) in "
+        << segments << " segments, dropped " << dropped;
+    if( codec && recorded > 0 )
+    {
+        logger.info("recorder") << "Compression " << double(rawBytes) / std::max<uint64_t>(bytes, 1)
+            << ":1, encode " << totalEncodeTime / recorded << " ms per frame (max " << maxEncodeTime << " ms)";
+    }
+}
+
+void FrameRecorder::push(const Frame& frame, const FrameInfo& info)
+{
+    if( !running )
+    {
+        return;
+    }
+
+    Item item;
+    item.frame = frame;
+    item.info = info;
+    if( !frame.valid() || queue.size() >= queueDepth || !queue.push(item) )
+    {
+        dropped++;
+        return;
+    }
+
+    // Pairs with the store of writerWaiting in run
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if( writerWaiting )
+    {
+        std::lock_guard<std::mutex> lock(wakeupMutex);
+        wakeup.notify_one();
+    }
+}
+
+RecorderStatistics FrameRecorder::getStatistics() const
+{
+    RecorderStatistics stats;
+    stats.recorded = recorded;
+    stats.dropped = dropped;
+    stats.bytes = bytes;
+    stats.segments = segments;
+    stats.queued = queue.size();
+    stats.rawBytes = rawBytes;
+    stats.ratio = ratio;
+    stats.encodeTime = encodeTime;
+    stats.meanEncodeTime = stats.recorded > 0 ? totalEncodeTime / stats.recorded : 0.0;
+    stats.maxEncodeTime = maxEncodeTime;
+    return stats;
+}
+
+void FrameRecorder::run()
+{
+    Item item;
+    while( true )
+    {
+        if( queue.pop(item) )
+        {
+            if( !write(item) )
+            {
+                dropped++;
+            }
+            // hand the sequence buffer back
+            item = Item();
+            continue;
+        }
+
+        if( !running )
+        {
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeupMutex);
+        writerWaiting = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wakeup.wait_for(lock, std::chrono::milliseconds(10), [this]{ return !queue.empty() || !running; });
+        writerWaiting = false;
+    }
+}
+
+bool FrameRecorder::write(const Item& item)
+{
+    const Frame& frame = item.frame;
+    const size_t rowLength = rowBytes(frame.format, frame.width);
+    const size_t rawPayload = rowLength * frame.height;
+    // space for the raw frame, compressed frames never take more
+    const size_t recordSize = alignRecord(sizeof(RecordHeader) + rawPayload);
+
+    if( sizeof(SegmentHeader) + recordSize > segmentSize )
+    {
+        logger.error("recorder") << "Frame of " << rawPayload << " bytes does not fit into a segment";
+        return false;
+    }
+    if( NULL == segment || used + recordSize > segmentSize )
+    {
+        if( !nextSegment() )
+        {
+            return false;
+        }
+    }
+
+    uint8_t* dst = segment + used;
+    uint8_t* pixels = dst + sizeof(RecordHeader);
+
+    size_t payload = 0;
+    uint32_t encoding = ENCODING_RAW;
+    if( codec && LosslessCodec::supports(frame.format) )
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        payload = codec->encode(frame.data, frame.stride, frame.format, frame.width, frame.height, pixels, rawPayload);
+        double time = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+
+        encodeTime = time;
+        totalEncodeTime = totalEncodeTime + time;
+        if( time > maxEncodeTime )
+        {
+            maxEncodeTime = time;
+        }
+        if( payload > 0 )
+        {
+            encoding = ENCODING_LOSSLESS;
+        }
+    }
+
+    if( ENCODING_RAW == encoding )
+    {
+        // rows without the driver's padding
+        payload = rawPayload;
+        if( frame.stride == rowLength )
+        {
+            std::memcpy(pixels, frame.data, payload);
+        }
+        else
+        {
+            for( size_t y = 0; y < frame.height; ++y )
+            {
+                std::memcpy(pixels + y * rowLength, frame.data + y * frame.stride, rowLength);
+            }
+        }
+    }
+
+    RecordHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic            = RECORD_MAGIC;
+    header.format           = static_cast<uint32_t>(frame.format);
+    header.width            = frame.width;
+    header.height           = frame.height;
+    header.rowBytes         = rowLength;
+    header.encoding         = encoding;
+    header.payloadSize      = payload;
+    header.frameNumber      = item.info.frameNumber;
+    header.deviceTimestamp  = item.info.deviceTimestamp;
+    header.eventTimestamp   = item.info.eventTimestamp;
+    header.dropped          = item.info.dropped;
+    std::memcpy(dst, &header, sizeof(header));
+
+    IndexEntry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    entry.frameNumber       = item.info.frameNumber;
+    entry.eventTimestamp    = item.info.eventTimestamp;
+    entry.segment           = segmentNumber - 1;
+    entry.offset            = used;
+    fwrite(&entry, sizeof(entry), 1, index);
+
+    // readers trust the segment up to usedSize, also after a crash
+    used += alignRecord(sizeof(RecordHeader) + payload);
+    SegmentHeader* segmentHeader = reinterpret_cast<SegmentHeader*>(segment);
+    segmentHeader->usedSize = used;
+    segmentHeader->frames++;
+
+    recorded++;
+    bytes += payload;
+    rawBytes += rawPayload;
+    ratio = double(rawPayload) / payload;
+    return true;
+}
+
+bool FrameRecorder::nextSegment()
+{
+    closeSegment();
+
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), "_%04u.seg", segmentNumber);
+    const std::string file = prefix + suffix;
+
+    segmentFd = ::open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if( segmentFd < 0 )
+    {
+        logger.error("recorder") << "Could not create " << file << ": " << strerror(errno);
+        return false;
+    }
+
+    // Reserve the blocks up front so writing never extends the file
+    int ret = posix_fallocate(segmentFd, 0, segmentSize);
+    if( 0 != ret && 0 != ftruncate(segmentFd, segmentSize) )
+    {
+        logger.error("recorder") << "Could not allocate " << file << ": " << strerror(ret);
+        ::close(segmentFd);
+        segmentFd = -1;
+        return false;
+    }
+
+    void* mem = mmap(NULL, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, segmentFd, 0);
+    if( MAP_FAILED == mem )
+    {
+        logger.error("recorder") << "Could not map " << file << ": " << strerror(errno);
+        ::close(segmentFd);
+        segmentFd = -1;
+        return false;
+    }
+    madvise(mem, segmentSize, MADV_SEQUENTIAL);
+    segment = static_cast<uint8_t*>(mem);
+
+    SegmentHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::strncpy(header.magic, "UEYEREC", sizeof(header.magic));
+    header.version      = VERSION;
+    header.headerSize   = sizeof(SegmentHeader);
+    header.segmentSize  = segmentSize;
+    header.usedSize     = sizeof(SegmentHeader);
+    std::memcpy(segment, &header, sizeof(header));
+
+    used = sizeof(SegmentHeader);
+    segmentNumber++;
+    segments++;
+    return true;
+}
+
+void FrameRecorder::closeSegment()
+{
+    if( NULL != segment )
+    {
+        munmap(segment, segmentSize);
+        segment = NULL;
+    }
+    if( segmentFd >= 0 )
+    {
+        // drop the unused preallocated tail
+        if( 0 != ftruncate(segmentFd, used) )
+        {
+            logger.warn("recorder") << "Could not truncate segment: " << strerror(errno);
+        }
+        ::close(segmentFd);
+        segmentFd = -1;
+    }
+}
+
+}
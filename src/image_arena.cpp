@@ -0,0 +1,167 @@
+#include <cstdint>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "image_arena.h"
+#include "pixel_conversion.h"
+
+namespace lms_ueye_importer
+{
+
+namespace
+{
+// Size of the default huge pages on x86 and most ARM systems
+const size_t HUGE_PAGE = 2 * 1024 * 1024;
+
+// Rows of this many bytes map to the same cache sets
+const size_t ALIASING_STRIDE = 4096;
+
+size_t roundUp(size_t value, size_t multiple)
+{
+    return ( value + multiple - 1 ) / multiple * multiple;
+}
+}
+
+ImageArena::ImageArena() :
+    base(NULL),
+    size(0),
+    used(0),
+    pages(Pages::NONE),
+    locked(false)
+{
+}
+
+ImageArena::~ImageArena()
+{
+    release();
+}
+
+bool ImageArena::allocate(size_t bytes, bool hugePages, bool lock)
+{
+    release();
+    if( bytes == 0 )
+    {
+        return false;
+    }
+
+#ifdef MAP_HUGETLB
+    // Reserved huge pages, only there if the administrator set some aside
+    if( hugePages )
+    {
+        const size_t length = roundUp(bytes, HUGE_PAGE);
+        void* mem = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if( MAP_FAILED != mem )
+        {
+            base = static_cast<char*>(mem);
+            size = length;
+            pages = Pages::HUGETLB;
+        }
+    }
+#endif
+
+    if( NULL == base )
+    {
+        // Transparent huge pages need huge page aligned ranges, so map one
+        // huge page more and trim the ends
+        const size_t length = hugePages ? roundUp(bytes, HUGE_PAGE) : roundUp(bytes, sysconf(_SC_PAGESIZE));
+        const size_t mapped = hugePages ? length + HUGE_PAGE : length;
+        void* mem = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if( MAP_FAILED == mem )
+        {
+            return false;
+        }
+
+        char* start = static_cast<char*>(mem);
+        if( hugePages )
+        {
+            char* aligned = reinterpret_cast<char*>( roundUp(reinterpret_cast<uintptr_t>(start), HUGE_PAGE) );
+            if( aligned > start )
+            {
+                munmap(start, aligned - start);
+            }
+            if( aligned + length < start + mapped )
+            {
+                munmap(aligned + length, start + mapped - ( aligned + length ));
+            }
+            start = aligned;
+        }
+
+        base = start;
+        size = length;
+        pages = Pages::BASE;
+#ifdef MADV_HUGEPAGE
+        if( hugePages && 0 == madvise(base, size, MADV_HUGEPAGE) )
+        {
+            pages = Pages::TRANSPARENT_HUGE;
+        }
+#endif
+    }
+
+    // Fault the pages in now instead of on the first frames
+    std::memset(base, 0, size);
+    locked = lock && 0 == mlock(base, size);
+    return true;
+}
+
+void ImageArena::release()
+{
+    if( NULL != base )
+    {
+        if( locked )
+        {
+            munlock(base, size);
+        }
+        munmap(base, size);
+    }
+    base = NULL;
+    size = 0;
+    used = 0;
+    pages = Pages::NONE;
+    locked = false;
+}
+
+char* ImageArena::carve(size_t bytes)
+{
+    const size_t offset = roundUp(used, ALIGNMENT);
+    if( NULL == base || offset + bytes > size )
+    {
+        return NULL;
+    }
+    used = offset + bytes;
+    return base + offset;
+}
+
+const char* ImageArena::name(Pages pages)
+{
+    switch( pages )
+    {
+    case Pages::NONE:               return "none";
+    case Pages::BASE:               return "base";
+    case Pages::TRANSPARENT_HUGE:   return "transparent_huge";
+    case Pages::HUGETLB:            return "hugetlb";
+    }
+    return "";
+}
+
+size_t ImageArena::paddedWidth(PixelFormat format, size_t width)
+{
+    // every format reaches a multiple of ALIGNMENT within ALIGNMENT * 8 pixels
+    for( size_t padded = width; padded < width + ALIGNMENT * 8; ++padded )
+    {
+        const size_t bytes = rowBytes(format, padded);
+        if( 0 == bytes % ALIGNMENT && 0 != bytes % ALIASING_STRIDE )
+        {
+            return padded;
+        }
+    }
+    return width;
+}
+
+size_t ImageArena::bufferSize(PixelFormat format, size_t width, size_t height)
+{
+    return roundUp(rowBytes(format, paddedWidth(format, width)) * height, ALIGNMENT);
+}
+
+}
@@ -0,0 +1,110 @@
+#include <algorithm>
+
+#include "latency_histogram.h"
+
+namespace lms_ueye_importer
+{
+
+const unsigned LatencyHistogram::SUB_BITS;
+const unsigned LatencyHistogram::MAX_BITS;
+const size_t LatencyHistogram::NUM_BUCKETS;
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::record(uint64_t nanos)
+{
+    buckets[bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(nanos, std::memory_order_relaxed);
+
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while( nanos > current && !max.compare_exchange_weak(current, nanos, std::memory_order_relaxed) )
+    {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for( auto& bucket : buckets )
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    sum.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+LatencySummary LatencyHistogram::summarize() const
+{
+    std::array<uint64_t, NUM_BUCKETS> counts;
+    uint64_t total = 0;
+    for( size_t i = 0; i < NUM_BUCKETS; ++i )
+    {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    LatencySummary summary;
+    if( 0 == total )
+    {
+        return summary;
+    }
+
+    const uint64_t maxNanos = max.load(std::memory_order_relaxed);
+    summary.count = total;
+    summary.mean = double(sum.load(std::memory_order_relaxed)) / total * 1e-3;
+    summary.max = maxNanos * 1e-3;
+
+    // smallest bucket reaching the rank, reported with its middle
+    const uint64_t rank50 = ( total * 50 + 99 ) / 100;
+    const uint64_t rank99 = ( total * 99 + 99 ) / 100;
+    uint64_t seen = 0;
+    bool have50 = false;
+    for( size_t i = 0; i < NUM_BUCKETS; ++i )
+    {
+        seen += counts[i];
+        if( !have50 && seen >= rank50 )
+        {
+            summary.p50 = std::min(bucketValue(i), maxNanos) * 1e-3;
+            have50 = true;
+        }
+        if( seen >= rank99 )
+        {
+            summary.p99 = std::min(bucketValue(i), maxNanos) * 1e-3;
+            break;
+        }
+    }
+    return summary;
+}
+
+size_t LatencyHistogram::bucketOf(uint64_t nanos)
+{
+    if( nanos < ( 1u << SUB_BITS ) )
+    {
+        return nanos;
+    }
+
+    // position of the highest bit selects the group, the next SUB_BITS bits the bucket
+    const unsigned msb = 63 - __builtin_clzll(nanos);
+    if( msb >= MAX_BITS )
+    {
+        return NUM_BUCKETS - 1;
+    }
+    const unsigned shift = msb - SUB_BITS;
+    return ( size_t(shift + 1) << SUB_BITS ) + ( ( nanos >> shift ) - ( 1u << SUB_BITS ) );
+}
+
+uint64_t LatencyHistogram::bucketValue(size_t bucket)
+{
+    if( bucket < ( 1u << SUB_BITS ) )
+    {
+        return bucket;
+    }
+
+    const unsigned shift = ( bucket >> SUB_BITS ) - 1;
+    const uint64_t lower = uint64_t( ( 1u << SUB_BITS ) + ( bucket & ( ( 1u << SUB_BITS ) - 1 ) ) ) << shift;
+    return lower + ( ( uint64_t(1) << shift ) >> 1 );
+}
+
+}
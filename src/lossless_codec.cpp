@@ -0,0 +1,484 @@
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "lossless_codec.h"
+#include "pixel_conversion.h"
+
+namespace lms_ueye_importer
+{
+
+namespace
+{
+// Samples sharing one Rice parameter
+const size_t BLOCK = 32;
+// Longest unary prefix, larger residuals are escaped and stored verbatim
+const unsigned LIMIT = 16;
+// Bits of the Rice parameter
+const unsigned K_BITS = 4;
+
+struct Layout
+{
+    size_t sampleBytes;
+    unsigned bits;
+    size_t dx;  // distance to the left neighbour of the same color (samples)
+    size_t dy;  // distance to the upper neighbour of the same color (rows)
+};
+
+bool layoutOf(PixelFormat format, Layout& layout)
+{
+    static const std::pair<PixelFormat, Layout> layouts[] = {
+        { PixelFormat::MONO8,   { 1, 8, 1, 1 } },
+        { PixelFormat::MONO10,  { 2, 16, 1, 1 } },
+        { PixelFormat::MONO12,  { 2, 16, 1, 1 } },
+        { PixelFormat::MONO16,  { 2, 16, 1, 1 } },
+        { PixelFormat::BAYER8,  { 1, 8, 2, 2 } },
+        { PixelFormat::RGB8,    { 1, 8, 3, 1 } },
+        { PixelFormat::BGRA8,   { 1, 8, 4, 1 } },
+        { PixelFormat::YUYV,    { 1, 8, 4, 1 } },
+    };
+
+    for( const auto& entry : layouts )
+    {
+        if( entry.first == format )
+        {
+            layout = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Rows [begin, end) of a stripe, stripes start on rows of the first color
+void stripeRows(size_t height, size_t stripes, size_t dy, size_t index, size_t& begin, size_t& end)
+{
+    size_t rows = ( height + stripes - 1 ) / stripes;
+    rows = ( rows + dy - 1 ) / dy * dy;
+    begin = std::min(height, index * rows);
+    end = std::min(height, begin + rows);
+}
+
+// Median edge detector from the left (a), upper (b) and upper left (c) sample
+inline uint32_t med(uint32_t a, uint32_t b, uint32_t c)
+{
+    uint32_t lo = std::min(a, b);
+    uint32_t hi = std::max(a, b);
+    if( c >= hi )
+    {
+        return lo;
+    }
+    if( c <= lo )
+    {
+        return hi;
+    }
+    return a + b - c;
+}
+
+template<typename T>
+inline uint32_t predict(const T* row, const T* up, size_t x, size_t dx)
+{
+    // no row above in the first rows of a stripe
+    if( x < dx )
+    {
+        return NULL != up ? up[x] : 0;
+    }
+    if( NULL == up )
+    {
+        return row[x - dx];
+    }
+    return med(row[x - dx], up[x], up[x - dx]);
+}
+
+class BitWriter
+{
+public:
+    BitWriter(uint8_t* out, size_t capacity) :
+        begin(out), out(out), end(out + capacity), acc(0), count(0), overflow(false)
+    {}
+
+    // n <= 32
+    void put(uint32_t value, unsigned n)
+    {
+        acc = ( acc << n ) | value;
+        count += n;
+        if( count >= 32 )
+        {
+            count -= 32;
+            if( end - out < 4 )
+            {
+                overflow = true;
+                out = end;
+                return;
+            }
+            const uint32_t word = static_cast<uint32_t>( acc >> count );
+            out[0] = static_cast<uint8_t>( word >> 24 );
+            out[1] = static_cast<uint8_t>( word >> 16 );
+            out[2] = static_cast<uint8_t>( word >> 8 );
+            out[3] = static_cast<uint8_t>( word );
+            out += 4;
+        }
+    }
+
+    // write the remaining bits padded to bytes, returns the size or 0 on overflow
+    size_t finish()
+    {
+        while( count > 0 && !overflow )
+        {
+            const unsigned n = std::min(count, 8u);
+            if( out == end )
+            {
+                overflow = true;
+                break;
+            }
+            *out++ = static_cast<uint8_t>( ( acc >> ( count - n ) ) << ( 8 - n ) );
+            count -= n;
+        }
+        return overflow ? 0 : out - begin;
+    }
+
+private:
+    uint8_t* begin;
+    uint8_t* out;
+    uint8_t* end;
+    uint64_t acc;
+    unsigned count;
+    bool overflow;
+};
+
+class BitReader
+{
+public:
+    BitReader(const uint8_t* in, size_t size) :
+        in(in), end(in + size), acc(0), count(0), consumed(0), available(uint64_t(size) * 8)
+    {}
+
+    // n <= 32
+    uint32_t get(unsigned n)
+    {
+        if( 0 == n )
+        {
+            return 0;
+        }
+        refill();
+        uint32_t value = static_cast<uint32_t>( acc >> ( 64 - n ) );
+        skip(n);
+        return value;
+    }
+
+    // Leading one bits up to limit, the terminating zero is consumed too
+    unsigned ones(unsigned limit)
+    {
+        refill();
+        unsigned n = ~acc == 0 ? 64 : __builtin_clzll(~acc);
+        if( n >= limit )
+        {
+            skip(limit);
+            return limit;
+        }
+        skip(n + 1);
+        return n;
+    }
+
+    // false if more bits were read than there are
+    bool valid() const { return consumed <= available; }
+
+private:
+    const uint8_t* in;
+    const uint8_t* end;
+    uint64_t acc;
+    unsigned count;
+    uint64_t consumed;
+    uint64_t available;
+
+    void refill()
+    {
+        // reads zeros past the end, checked with valid()
+        while( count <= 56 )
+        {
+            uint64_t byte = in < end ? *in++ : 0;
+            acc |= byte << ( 56 - count );
+            count += 8;
+        }
+    }
+
+    void skip(unsigned n)
+    {
+        acc <<= n;
+        count -= n;
+        consumed += n;
+    }
+};
+
+void writeBlocks(BitWriter& writer, const uint32_t* residuals, size_t samples, unsigned bits)
+{
+    for( size_t i = 0; i < samples; i += BLOCK )
+    {
+        const size_t n = std::min(BLOCK, samples - i);
+        uint64_t sum = 0;
+        for( size_t j = 0; j < n; ++j )
+        {
+            sum += residuals[i + j];
+        }
+
+        // smallest k with n * 2^k >= sum, about log2 of the mean
+        unsigned k = 0;
+        while( k < bits - 1 && ( uint64_t(n) << k ) < sum )
+        {
+            ++k;
+        }
+        writer.put(k, K_BITS);
+
+        for( size_t j = 0; j < n; ++j )
+        {
+            const uint32_t u = residuals[i + j];
+            const uint32_t q = u >> k;
+            if( q < LIMIT )
+            {
+                // q ones, a zero and the k low bits, at most 32 bits
+                const uint32_t prefix = ( ( 1u << q ) - 1 ) << 1;
+                writer.put( ( prefix << k ) | ( u & ( ( 1u << k ) - 1 ) ), q + 1 + k );
+            }
+            else
+            {
+                writer.put( ( 1u << LIMIT ) - 1, LIMIT );
+                writer.put( u, bits );
+            }
+        }
+    }
+}
+
+bool readBlocks(BitReader& reader, uint32_t* residuals, size_t samples, unsigned bits)
+{
+    for( size_t i = 0; i < samples; i += BLOCK )
+    {
+        const size_t n = std::min(BLOCK, samples - i);
+        const unsigned k = reader.get(K_BITS);
+        if( k >= bits )
+        {
+            return false;
+        }
+
+        for( size_t j = 0; j < n; ++j )
+        {
+            const unsigned q = reader.ones(LIMIT);
+            if( q < LIMIT )
+            {
+                residuals[i + j] = ( q << k ) | reader.get(k);
+            }
+            else
+            {
+                residuals[i + j] = reader.get(bits);
+            }
+        }
+    }
+    return reader.valid();
+}
+
+template<typename T>
+size_t encodeStripe(const uint8_t* src, size_t stride, size_t samples, size_t begin, size_t end,
+                    const Layout& layout, uint8_t* dst, size_t capacity)
+{
+    const uint32_t mask = ( 1u << layout.bits ) - 1;
+    const uint32_t half = 1u << ( layout.bits - 1 );
+    std::vector<uint32_t> residuals(samples);
+    BitWriter writer(dst, capacity);
+
+    for( size_t y = begin; y < end; ++y )
+    {
+        const T* row = reinterpret_cast<const T*>( src + y * stride );
+        const T* up = y >= begin + layout.dy ? reinterpret_cast<const T*>( src + ( y - layout.dy ) * stride ) : NULL;
+
+        // residuals modulo 2^bits, folded to small unsigned values
+        const size_t edge = std::min(layout.dx, samples);
+        for( size_t x = 0; x < edge; ++x )
+        {
+            uint32_t d = ( uint32_t(row[x]) - predict(row, up, x, layout.dx) ) & mask;
+            residuals[x] = d < half ? d << 1 : ( ( mask - d ) << 1 ) | 1;
+        }
+        if( NULL == up )
+        {
+            for( size_t x = edge; x < samples; ++x )
+            {
+                uint32_t d = ( uint32_t(row[x]) - row[x - layout.dx] ) & mask;
+                residuals[x] = d < half ? d << 1 : ( ( mask - d ) << 1 ) | 1;
+            }
+        }
+        else
+        {
+            for( size_t x = edge; x < samples; ++x )
+            {
+                uint32_t d = ( uint32_t(row[x]) - med(row[x - layout.dx], up[x], up[x - layout.dx]) ) & mask;
+                residuals[x] = d < half ? d << 1 : ( ( mask - d ) << 1 ) | 1;
+            }
+        }
+        writeBlocks(writer, residuals.data(), samples, layout.bits);
+    }
+    return writer.finish();
+}
+
+template<typename T>
+bool decodeStripe(const uint8_t* src, size_t size, size_t samples, size_t begin, size_t end,
+                  const Layout& layout, uint8_t* dst, size_t stride)
+{
+    const uint32_t mask = ( 1u << layout.bits ) - 1;
+    std::vector<uint32_t> residuals(samples);
+    BitReader reader(src, size);
+
+    for( size_t y = begin; y < end; ++y )
+    {
+        if( !readBlocks(reader, residuals.data(), samples, layout.bits) )
+        {
+            return false;
+        }
+
+        T* row = reinterpret_cast<T*>( dst + y * stride );
+        const T* up = y >= begin + layout.dy ? reinterpret_cast<const T*>( dst + ( y - layout.dy ) * stride ) : NULL;
+        for( size_t x = 0; x < samples; ++x )
+        {
+            const uint32_t u = residuals[x];
+            const uint32_t d = ( u & 1 ) ? mask - ( u >> 1 ) : u >> 1;
+            row[x] = static_cast<T>( ( predict(row, up, x, layout.dx) + d ) & mask );
+        }
+    }
+    return true;
+}
+
+void writeUint32(uint8_t* dst, uint32_t value)
+{
+    std::memcpy(dst, &value, sizeof(value));
+}
+
+uint32_t readUint32(const uint8_t* src)
+{
+    uint32_t value;
+    std::memcpy(&value, src, sizeof(value));
+    return value;
+}
+}
+
+LosslessCodec::LosslessCodec(size_t threads) :
+    pool(threads)
+{
+}
+
+bool LosslessCodec::supports(PixelFormat format)
+{
+    Layout layout;
+    return layoutOf(format, layout);
+}
+
+size_t LosslessCodec::encode(const uint8_t* src, size_t stride, PixelFormat format, size_t width, size_t height,
+                             uint8_t* dst, size_t capacity)
+{
+    Layout layout;
+    if( !layoutOf(format, layout) || 0 == width || 0 == height )
+    {
+        return 0;
+    }
+
+    const size_t samples = rowBytes(format, width) / layout.sampleBytes;
+    const size_t stripes = std::max<size_t>( 1, std::min(pool.size(), height / layout.dy) );
+    const size_t headerSize = sizeof(uint32_t) * ( 1 + stripes );
+    if( capacity <= headerSize )
+    {
+        return 0;
+    }
+
+    // a single stripe can take all of the space
+    const size_t stripeCapacity = capacity - headerSize;
+    scratch.resize(stripes);
+    scratchSize.assign(stripes, 0);
+    for( auto& buffer : scratch )
+    {
+        if( buffer.size() < stripeCapacity )
+        {
+            buffer.resize(stripeCapacity);
+        }
+    }
+
+    pool.parallelFor(stripes, 1, [&](size_t first, size_t last)
+    {
+        for( size_t s = first; s < last; ++s )
+        {
+            size_t begin, end;
+            stripeRows(height, stripes, layout.dy, s, begin, end);
+            scratchSize[s] = 1 == layout.sampleBytes
+                ? encodeStripe<uint8_t>(src, stride, samples, begin, end, layout, scratch[s].data(), stripeCapacity)
+                : encodeStripe<uint16_t>(src, stride, samples, begin, end, layout, scratch[s].data(), stripeCapacity);
+        }
+    });
+
+    size_t total = headerSize;
+    for( size_t s = 0; s < stripes; ++s )
+    {
+        size_t begin, end;
+        stripeRows(height, stripes, layout.dy, s, begin, end);
+        if( 0 == scratchSize[s] && begin < end )
+        {
+            // stripe larger than the capacity
+            return 0;
+        }
+        total += scratchSize[s];
+    }
+    if( total > capacity )
+    {
+        return 0;
+    }
+
+    writeUint32(dst, stripes);
+    uint8_t* out = dst + headerSize;
+    for( size_t s = 0; s < stripes; ++s )
+    {
+        writeUint32(dst + sizeof(uint32_t) * ( 1 + s ), scratchSize[s]);
+        std::memcpy(out, scratch[s].data(), scratchSize[s]);
+        out += scratchSize[s];
+    }
+    return total;
+}
+
+bool LosslessCodec::decode(const uint8_t* src, size_t size, PixelFormat format, size_t width, size_t height,
+                           uint8_t* dst, size_t stride)
+{
+    Layout layout;
+    if( !layoutOf(format, layout) || size < sizeof(uint32_t) )
+    {
+        return false;
+    }
+
+    const size_t stripes = readUint32(src);
+    const size_t headerSize = sizeof(uint32_t) * ( 1 + stripes );
+    if( 0 == stripes || stripes > height || size < headerSize )
+    {
+        return false;
+    }
+
+    std::vector<size_t> offsets(stripes + 1, headerSize);
+    for( size_t s = 0; s < stripes; ++s )
+    {
+        offsets[s + 1] = offsets[s] + readUint32(src + sizeof(uint32_t) * ( 1 + s ));
+    }
+    if( offsets[stripes] > size )
+    {
+        return false;
+    }
+
+    const size_t samples = rowBytes(format, width) / layout.sampleBytes;
+    std::vector<char> ok(stripes, 0);
+    pool.parallelFor(stripes, 1, [&](size_t first, size_t last)
+    {
+        for( size_t s = first; s < last; ++s )
+        {
+            size_t begin, end;
+            stripeRows(height, stripes, layout.dy, s, begin, end);
+            const uint8_t* data = src + offsets[s];
+            const size_t length = offsets[s + 1] - offsets[s];
+            ok[s] = 1 == layout.sampleBytes
+                ? decodeStripe<uint8_t>(data, length, samples, begin, end, layout, dst, stride)
+                : decodeStripe<uint16_t>(data, length, samples, begin, end, layout, dst, stride);
+        }
+    });
+
+    return std::find(ok.begin(), ok.end(), 0) == ok.end();
+}
+
+}
@@ -0,0 +1,503 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OUTPUT_TRANSFORM_X86
+#endif
+
+#include "output_transform.h"
+#include "cpu_features.h"
+
+namespace lms_ueye_importer
+{
+
+namespace
+{
+
+// Scalar versions, also used for the tails of the vector loops. Reversing
+// kernels write dst pixel i from src pixel pixels - 1 - i.
+
+void reverseScalar(const uint8_t* src, uint8_t* dst, size_t pixels, size_t bytes)
+{
+    for( size_t i = 0; i < pixels; ++i )
+    {
+        std::memcpy(dst + i * bytes, src + ( pixels - 1 - i ) * bytes, bytes);
+    }
+}
+
+// YUYV pairs share their chroma, so pairs are reversed and their lumas swapped
+void reverseYuyvScalar(const uint8_t* src, uint8_t* dst, size_t pairs)
+{
+    for( size_t i = 0; i < pairs; ++i )
+    {
+        const uint8_t* in = src + 4 * ( pairs - 1 - i );
+        uint8_t* out = dst + 4 * i;
+        out[0] = in[2];
+        out[1] = in[1];
+        out[2] = in[0];
+        out[3] = in[3];
+    }
+}
+
+// bit n of keep leaves byte n of every 4 bytes unchanged
+void lutScalar(const uint8_t* src, uint8_t* dst, size_t bytes, const uint8_t* lut, unsigned keep)
+{
+    size_t i = 0;
+    if( 0 == keep )
+    {
+        // eight lookups per 64 bit load and store, byte order does not matter
+        for( ; i + 8 <= bytes; i += 8 )
+        {
+            uint64_t in, out = 0;
+            std::memcpy(&in, src + i, sizeof(in));
+            for( unsigned b = 0; b < 64; b += 8 )
+            {
+                out |= uint64_t( lut[( in >> b ) & 0xFF] ) << b;
+            }
+            std::memcpy(dst + i, &out, sizeof(out));
+        }
+    }
+    for( ; i < bytes; ++i )
+    {
+        dst[i] = ( keep >> ( i & 3 ) ) & 1 ? src[i] : lut[src[i]];
+    }
+}
+
+// XOR of consecutive 16 entry tables within each half, see lutSSSE3
+std::vector<uint8_t> makeDeltas(const std::vector<uint8_t>& lut)
+{
+    std::vector<uint8_t> deltas(lut);
+    for( size_t i = 0; i < lut.size(); ++i )
+    {
+        if( ( i / 16 ) % 8 > 0 )
+        {
+            deltas[i] ^= lut[i - 16];
+        }
+    }
+    return deltas;
+}
+
+#ifdef OUTPUT_TRANSFORM_X86
+
+// Kernels are compiled for their instruction set individually and picked at
+// runtime through CpuFeatures.
+
+__attribute__((target("ssse3")))
+void reverse1SSSE3(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    const __m128i reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+    size_t i = 0;
+    for( ; i + 16 <= pixels; i += 16 )
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pixels - i - 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(v, reverse));
+    }
+    reverseScalar(src, dst + i, pixels - i, 1);
+}
+
+__attribute__((target("avx2")))
+void reverse1AVX2(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    const __m256i reverse = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                             15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+    size_t i = 0;
+    for( ; i + 32 <= pixels; i += 32 )
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + pixels - i - 32));
+        // reverse within the 128 bit lanes, then swap the lanes
+        v = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, reverse), 0x4E);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+    }
+    reverse1SSSE3(src, dst + i, pixels - i);
+}
+
+__attribute__((target("ssse3")))
+void reverse3SSSE3(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    // 5 pixels per 16 bytes, loaded one byte early so the load ends at the
+    // last pixel. The 16th byte stored is overwritten by the next pixel,
+    // which is why one pixel is always left for the next iteration / tail.
+    const __m128i reverse = _mm_setr_epi8(13, 14, 15, 10, 11, 12, 7, 8, 9, 4, 5, 6, 1, 2, 3, -1);
+
+    size_t i = 0;
+    for( ; i + 5 < pixels; i += 5 )
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * ( pixels - i - 5 ) - 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * i), _mm_shuffle_epi8(v, reverse));
+    }
+    reverseScalar(src, dst + 3 * i, pixels - i, 3);
+}
+
+void reverse4SSE2(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    size_t i = 0;
+    for( ; i + 4 <= pixels; i += 4 )
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * ( pixels - i - 4 )));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * i), _mm_shuffle_epi32(v, 0x1B));
+    }
+    reverseScalar(src, dst + 4 * i, pixels - i, 4);
+}
+
+__attribute__((target("avx2")))
+void reverse4AVX2(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+
+    size_t i = 0;
+    for( ; i + 8 <= pixels; i += 8 )
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 4 * ( pixels - i - 8 )));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 4 * i), _mm256_permutevar8x32_epi32(v, reverse));
+    }
+    _mm256_zeroupper();
+    reverse4SSE2(src, dst + 4 * i, pixels - i);
+}
+
+__attribute__((target("ssse3")))
+void reverseYuyvSSSE3(const uint8_t* src, uint8_t* dst, size_t pairs)
+{
+    const __m128i reverse = _mm_setr_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3);
+
+    size_t i = 0;
+    for( ; i + 4 <= pairs; i += 4 )
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * ( pairs - i - 4 )));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * i), _mm_shuffle_epi8(v, reverse));
+    }
+    reverseYuyvScalar(src, dst + 4 * i, pairs - i);
+}
+
+__attribute__((target("avx2")))
+void reverseYuyvAVX2(const uint8_t* src, uint8_t* dst, size_t pairs)
+{
+    const __m256i reverse = _mm256_setr_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3,
+                                             14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3);
+
+    size_t i = 0;
+    for( ; i + 8 <= pairs; i += 8 )
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 4 * ( pairs - i - 8 )));
+        v = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, reverse), 0x4E);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 4 * i), v);
+    }
+    _mm256_zeroupper();
+    reverseYuyvSSSE3(src, dst + 4 * i, pairs - i);
+}
+
+/*
+ * The 256 entry table is looked up as 16 tables of 16 entries with pshufb,
+ * which returns entry (index & 15) for indices 0..127 and 0 for negative
+ * ones. The lower half of the table is looked up with the value itself,
+ * the upper half with value ^ 0x80. Subtracting 16 with signed saturation
+ * before each of the 8 tables of a half makes a value see all tables up to
+ * its own and none after it, so XORing deltas between consecutive tables
+ * (see makeDeltas) leaves exactly its entry. Values of the other half stay
+ * negative and contribute 0.
+ */
+
+__attribute__((target("ssse3")))
+void lutSSSE3(const uint8_t* src, uint8_t* dst, size_t bytes, const uint8_t* lut, const uint8_t* deltas, unsigned keep)
+{
+    __m128i tables[16];
+    for( int t = 0; t < 16; ++t )
+    {
+        tables[t] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(deltas + 16 * t));
+    }
+    const __m128i sixteen = _mm_set1_epi8(16);
+    const __m128i upper = _mm_set1_epi8(char(0x80));
+    const __m128i kept = _mm_set1_epi32( int( ( keep & 1 ? 0xFF : 0 ) | ( keep & 2 ? 0xFF00 : 0 )
+                                            | ( keep & 4 ? 0xFF0000 : 0 ) | ( keep & 8 ? 0xFF000000u : 0 ) ) );
+
+    size_t i = 0;
+    for( ; i + 16 <= bytes; i += 16 )
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        // two independent chains for the two halves
+        __m128i lo = v;
+        __m128i hi = _mm_xor_si128(v, upper);
+        __m128i a = _mm_shuffle_epi8(tables[0], lo);
+        __m128i b = _mm_shuffle_epi8(tables[8], hi);
+        for( int t = 1; t < 8; ++t )
+        {
+            lo = _mm_subs_epi8(lo, sixteen);
+            hi = _mm_subs_epi8(hi, sixteen);
+            a = _mm_xor_si128(a, _mm_shuffle_epi8(tables[t], lo));
+            b = _mm_xor_si128(b, _mm_shuffle_epi8(tables[8 + t], hi));
+        }
+        __m128i r = _mm_or_si128(a, b);
+        r = _mm_or_si128(_mm_and_si128(kept, v), _mm_andnot_si128(kept, r));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), r);
+    }
+    lutScalar(src + i, dst + i, bytes - i, lut, keep);
+}
+
+__attribute__((target("avx2")))
+void lutAVX2(const uint8_t* src, uint8_t* dst, size_t bytes, const uint8_t* lut, const uint8_t* deltas, unsigned keep)
+{
+    __m256i tables[16];
+    for( int t = 0; t < 16; ++t )
+    {
+        tables[t] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(deltas + 16 * t)));
+    }
+    const __m256i sixteen = _mm256_set1_epi8(16);
+    const __m256i upper = _mm256_set1_epi8(char(0x80));
+    const __m256i kept = _mm256_set1_epi32( int( ( keep & 1 ? 0xFF : 0 ) | ( keep & 2 ? 0xFF00 : 0 )
+                                               | ( keep & 4 ? 0xFF0000 : 0 ) | ( keep & 8 ? 0xFF000000u : 0 ) ) );
+
+    size_t i = 0;
+    for( ; i + 32 <= bytes; i += 32 )
+    {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i lo = v;
+        __m256i hi = _mm256_xor_si256(v, upper);
+        __m256i a = _mm256_shuffle_epi8(tables[0], lo);
+        __m256i b = _mm256_shuffle_epi8(tables[8], hi);
+        for( int t = 1; t < 8; ++t )
+        {
+            lo = _mm256_subs_epi8(lo, sixteen);
+            hi = _mm256_subs_epi8(hi, sixteen);
+            a = _mm256_xor_si256(a, _mm256_shuffle_epi8(tables[t], lo));
+            b = _mm256_xor_si256(b, _mm256_shuffle_epi8(tables[8 + t], hi));
+        }
+        __m256i r = _mm256_blendv_epi8(_mm256_or_si256(a, b), v, kept);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), r);
+    }
+    _mm256_zeroupper();
+    lutSSSE3(src + i, dst + i, bytes - i, lut, deltas, keep);
+}
+
+#endif // OUTPUT_TRANSFORM_X86
+
+void reverseRow(PixelFormat format, const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+#ifdef OUTPUT_TRANSFORM_X86
+    const bool avx2 = CpuFeatures::get().avx2;
+    const bool ssse3 = CpuFeatures::get().ssse3;
+#endif
+
+    switch( format )
+    {
+    case PixelFormat::RGB8:
+#ifdef OUTPUT_TRANSFORM_X86
+        if( ssse3 )
+        {
+            reverse3SSSE3(src, dst, pixels);
+            return;
+        }
+#endif
+        reverseScalar(src, dst, pixels, 3);
+        return;
+    case PixelFormat::BGRA8:
+#ifdef OUTPUT_TRANSFORM_X86
+        avx2 ? reverse4AVX2(src, dst, pixels) : reverse4SSE2(src, dst, pixels);
+#else
+        reverseScalar(src, dst, pixels, 4);
+#endif
+        return;
+    case PixelFormat::YUYV:
+#ifdef OUTPUT_TRANSFORM_X86
+        if( ssse3 )
+        {
+            avx2 ? reverseYuyvAVX2(src, dst, pixels / 2) : reverseYuyvSSSE3(src, dst, pixels / 2);
+            return;
+        }
+#endif
+        reverseYuyvScalar(src, dst, pixels / 2);
+        return;
+    default:
+        // MONO8 and BAYER8
+#ifdef OUTPUT_TRANSFORM_X86
+        if( ssse3 )
+        {
+            avx2 ? reverse1AVX2(src, dst, pixels) : reverse1SSSE3(src, dst, pixels);
+            return;
+        }
+#endif
+        reverseScalar(src, dst, pixels, 1);
+        return;
+    }
+}
+
+void lutRow(const uint8_t* src, uint8_t* dst, size_t bytes, const uint8_t* lut, const uint8_t* deltas, unsigned keep)
+{
+#ifdef OUTPUT_TRANSFORM_X86
+    if( CpuFeatures::get().avx2 )
+    {
+        lutAVX2(src, dst, bytes, lut, deltas, keep);
+        return;
+    }
+    if( CpuFeatures::get().ssse3 )
+    {
+        lutSSSE3(src, dst, bytes, lut, deltas, keep);
+        return;
+    }
+#else
+    (void)deltas;
+#endif
+    lutScalar(src, dst, bytes, lut, keep);
+}
+
+}  // namespace
+
+OutputTransform::OutputTransform() :
+    orientation(Orientation::NORMAL),
+    cropX(0),
+    cropY(0),
+    cropWidth(0),
+    cropHeight(0),
+    format(PixelFormat::MONO8),
+    outputWidth(0),
+    outputHeight(0),
+    pixelBytes(1),
+    flipHorizontal(false),
+    flipVertical(false),
+    active(false)
+{
+}
+
+bool OutputTransform::configure(Orientation orientation, size_t cropX, size_t cropY, size_t cropWidth, size_t cropHeight,
+                                const std::vector<uint8_t>& lut)
+{
+    if( !lut.empty() && lut.size() != 256 )
+    {
+        return false;
+    }
+
+    this->orientation = orientation;
+    this->cropX = cropX;
+    this->cropY = cropY;
+    this->cropWidth = cropWidth;
+    this->cropHeight = cropHeight;
+
+    // an identity table is no table
+    this->lut.clear();
+    for( size_t i = 0; i < lut.size(); ++i )
+    {
+        if( lut[i] != i )
+        {
+            this->lut = lut;
+            break;
+        }
+    }
+    lutDeltas = makeDeltas(this->lut);
+    return true;
+}
+
+bool OutputTransform::supports(PixelFormat format)
+{
+    switch( format )
+    {
+    case PixelFormat::MONO8:
+    case PixelFormat::BAYER8:
+    case PixelFormat::RGB8:
+    case PixelFormat::BGRA8:
+    case PixelFormat::YUYV:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool OutputTransform::prepare(PixelFormat format, size_t width, size_t height)
+{
+    this->format = format;
+    outputWidth = width;
+    outputHeight = height;
+    flipHorizontal = false;
+    flipVertical = false;
+    active = false;
+    pixelBytes = ( PixelFormat::YUYV == format ) ? 2 : ( PixelFormat::RGB8 == format ) ? 3 : ( PixelFormat::BGRA8 == format ) ? 4 : 1;
+
+    const size_t croppedWidth = cropWidth > 0 ? cropWidth : ( width > cropX ? width - cropX : 0 );
+    const size_t croppedHeight = cropHeight > 0 ? cropHeight : ( height > cropY ? height - cropY : 0 );
+    const bool identity = ( Orientation::NORMAL == orientation && lut.empty()
+                            && 0 == cropX && 0 == cropY && croppedWidth == width && croppedHeight == height );
+    if( identity )
+    {
+        return true;
+    }
+
+    if( !supports(format) || 0 == croppedWidth || 0 == croppedHeight
+        || cropX + croppedWidth > width || cropY + croppedHeight > height )
+    {
+        return false;
+    }
+    if( PixelFormat::YUYV == format && ( ( cropX | croppedWidth ) & 1 ) )
+    {
+        return false;
+    }
+
+    outputWidth = croppedWidth;
+    outputHeight = croppedHeight;
+    flipHorizontal = ( Orientation::FLIP_HORIZONTAL == orientation || Orientation::ROTATE_180 == orientation );
+    flipVertical = ( Orientation::FLIP_VERTICAL == orientation || Orientation::ROTATE_180 == orientation );
+    active = true;
+    return true;
+}
+
+std::vector<uint8_t> OutputTransform::makeLut(double gamma, double contrast, double brightness)
+{
+    std::vector<uint8_t> lut(256);
+    bool identity = true;
+    for( size_t i = 0; i < lut.size(); ++i )
+    {
+        double value = 255.0 * std::pow(double(i) / 255.0, 1.0 / ( gamma > 0.0 ? gamma : 1.0 ));
+        value = ( value - 128.0 ) * contrast + 128.0 + brightness;
+        lut[i] = uint8_t( std::lround( std::min(255.0, std::max(0.0, value)) ) );
+        identity = identity && lut[i] == i;
+    }
+
+    if( identity )
+    {
+        lut.clear();
+    }
+    return lut;
+}
+
+size_t OutputTransform::sourceRow(size_t y) const
+{
+    return flipVertical ? cropY + outputHeight - 1 - y : cropY + y;
+}
+
+void OutputTransform::processRow(const uint8_t* src, uint8_t* dst) const
+{
+    const uint8_t* row = src + cropX * pixelBytes;
+    const size_t bytes = outputWidth * pixelBytes;
+    // alpha of BGRA8 and chroma of YUYV are not mapped
+    const unsigned keep = ( PixelFormat::BGRA8 == format ) ? 0x8 : ( PixelFormat::YUYV == format ) ? 0xA : 0;
+
+    if( !flipHorizontal )
+    {
+        if( lut.empty() )
+        {
+            std::memcpy(dst, row, bytes);
+        }
+        else
+        {
+            lutRow(row, dst, bytes, lut.data(), lutDeltas.data(), keep);
+        }
+        return;
+    }
+
+    // the reversed row is still in L1 when the table is applied
+    reverseRow(format, row, dst, outputWidth);
+    if( !lut.empty() )
+    {
+        lutRow(dst, dst, bytes, lut.data(), lutDeltas.data(), keep);
+    }
+}
+
+void OutputTransform::process(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride) const
+{
+    for( size_t y = 0; y < outputHeight; ++y )
+    {
+        processRow(src + sourceRow(y) * srcStride, dst + y * dstStride);
+    }
+}
+
+}
@@ -0,0 +1,737 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIXEL_CONVERSION_X86
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PIXEL_CONVERSION_NEON
+#endif
+
+#include "pixel_conversion.h"
+#include "cpu_features.h"
+
+namespace lms_ueye_importer
+{
+
+size_t bitsPerPixel(PixelFormat format)
+{
+    switch( format )
+    {
+    case PixelFormat::MONO8:
+    case PixelFormat::BAYER8:
+        return 8;
+    case PixelFormat::MONO10:
+    case PixelFormat::MONO12:
+    case PixelFormat::MONO16:
+    case PixelFormat::YUYV:
+        return 16;
+    case PixelFormat::MONO10_PACKED:
+        return 10;
+    case PixelFormat::MONO12_PACKED:
+        return 12;
+    case PixelFormat::RGB8:
+        return 24;
+    case PixelFormat::BGRA8:
+        return 32;
+    }
+    // unknown
+    return 0;
+}
+
+size_t significantBits(PixelFormat format)
+{
+    switch( format )
+    {
+    case PixelFormat::MONO8:
+    case PixelFormat::BAYER8:
+    case PixelFormat::RGB8:
+    case PixelFormat::BGRA8:
+    case PixelFormat::YUYV:
+        return 8;
+    case PixelFormat::MONO10:
+    case PixelFormat::MONO10_PACKED:
+        return 10;
+    case PixelFormat::MONO12:
+    case PixelFormat::MONO12_PACKED:
+        return 12;
+    case PixelFormat::MONO16:
+        return 16;
+    }
+    // unknown
+    return 0;
+}
+
+size_t rowBytes(PixelFormat format, size_t width)
+{
+    return ( width * bitsPerPixel(format) + 7 ) / 8;
+}
+
+namespace kernels
+{
+
+namespace
+{
+
+// Scalar versions, also used for the tails of the vector loops
+
+void unpackMono10pScalar(const uint8_t* src, uint16_t* dst, size_t pixels)
+{
+    size_t i = 0;
+    for( ; i + 4 <= pixels; i += 4, src += 5 )
+    {
+        dst[i + 0] = uint16_t(  src[0]       | ( src[1] & 0x03 ) << 8 );
+        dst[i + 1] = uint16_t( (src[1] >> 2) | ( src[2] & 0x0F ) << 6 );
+        dst[i + 2] = uint16_t( (src[2] >> 4) | ( src[3] & 0x3F ) << 4 );
+        dst[i + 3] = uint16_t( (src[3] >> 6) |   src[4]          << 2 );
+    }
+
+    // partial group at the end of a row
+    size_t bit = 0;
+    for( ; i < pixels; ++i, bit += 10 )
+    {
+        const uint8_t* p = src + bit / 8;
+        unsigned int value = p[0] | ( p[1] << 8 );
+        dst[i] = uint16_t( ( value >> ( bit % 8 ) ) & 0x3FF );
+    }
+}
+
+void unpackMono12pScalar(const uint8_t* src, uint16_t* dst, size_t pixels)
+{
+    size_t i = 0;
+    for( ; i + 2 <= pixels; i += 2, src += 3 )
+    {
+        dst[i + 0] = uint16_t(  src[0]       | ( src[1] & 0x0F ) << 8 );
+        dst[i + 1] = uint16_t( (src[1] >> 4) |   src[2]          << 4 );
+    }
+    if( i < pixels )
+    {
+        dst[i] = uint16_t( src[0] | ( src[1] & 0x0F ) << 8 );
+    }
+}
+
+void shiftMono16To8Scalar(const uint16_t* src, uint8_t* dst, size_t pixels, unsigned int shift)
+{
+    for( size_t i = 0; i < pixels; ++i )
+    {
+        unsigned int value = src[i] >> shift;
+        dst[i] = uint8_t( value > 255 ? 255 : value );
+    }
+}
+
+void copyStatisticsScalar(const uint8_t* src, uint8_t* dst, size_t pixels, ImageStatistics& stats, bool histogram)
+{
+    if( NULL != dst )
+    {
+        std::memcpy(dst, src, pixels);
+    }
+
+    uint64_t sum = 0;
+    uint64_t saturated = 0;
+    uint8_t min = stats.min;
+    uint8_t max = stats.max;
+    for( size_t i = 0; i < pixels; ++i )
+    {
+        const uint8_t value = src[i];
+        sum += value;
+        min = value < min ? value : min;
+        max = value > max ? value : max;
+        saturated += ( value >= stats.saturationLevel );
+    }
+    if( histogram )
+    {
+        for( size_t i = 0; i < pixels; ++i )
+        {
+            stats.histogram[src[i] >> 4]++;
+        }
+    }
+    stats.sum += sum;
+    stats.saturated += saturated;
+    stats.min = min;
+    stats.max = max;
+}
+
+/**
+ * The vector kernels count per threshold instead of per bin: atLeast[k]
+ * samples of the vector part were >= 16 * k (k = 1..15), which takes one
+ * compare per threshold and no scatter. The byte counters are flushed every
+ * 255 vectors before they can overflow.
+ *
+ * The 30 extra operations per vector cost several times the plain copy,
+ * which is why the histogram is optional per call (HISTOGRAM) and only
+ * taken from some of the rows.
+ */
+void addCumulative(ImageStatistics& stats, uint64_t count, const uint64_t* atLeast)
+{
+    uint64_t above = count;
+    for( size_t k = 1; k < ImageStatistics::NUM_BINS; ++k )
+    {
+        stats.histogram[k - 1] += above - atLeast[k];
+        above = atLeast[k];
+    }
+    stats.histogram[ImageStatistics::NUM_BINS - 1] += above;
+}
+
+#ifdef PIXEL_CONVERSION_X86
+
+// Kernels are compiled for their instruction set individually and picked at
+// runtime through CpuFeatures.
+
+__attribute__((target("ssse3")))
+void unpackMono10pSSSE3(const uint8_t* src, uint16_t* dst, size_t pixels)
+{
+    // 8 pixels from 10 bytes: gather the two bytes holding each pixel into
+    // its 16 bit lane, then shift each lane by 0, 2, 4 or 6 bits
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9);
+    // x << (6 - s) followed by >> 6 leaves bits [s, s + 10)
+    const __m128i align = _mm_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1);
+
+    size_t i = 0;
+    // the 16 byte load reads 6 bytes beyond the 10 consumed
+    for( ; i + 8 <= pixels && ( pixels - i ) * 10 / 8 >= 16; i += 8, src += 10 )
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        v = _mm_shuffle_epi8(v, shuffle);
+        v = _mm_srli_epi16(_mm_mullo_epi16(v, align), 6);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    }
+    unpackMono10pScalar(src, dst + i, pixels - i);
+}
+
+__attribute__((target("ssse3")))
+void unpackMono12pSSSE3(const uint8_t* src, uint16_t* dst, size_t pixels)
+{
+    // 8 pixels from 12 bytes: even pixels are the low 12 bits of their
+    // byte pair, odd pixels the high 12 bits
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+    const __m128i evenMask = _mm_setr_epi16(0x0FFF, 0, 0x0FFF, 0, 0x0FFF, 0, 0x0FFF, 0);
+    const __m128i oddMask = _mm_setr_epi16(0, -1, 0, -1, 0, -1, 0, -1);
+
+    size_t i = 0;
+    // the 16 byte load reads 4 bytes beyond the 12 consumed
+    for( ; i + 8 <= pixels && ( pixels - i ) * 12 / 8 >= 16; i += 8, src += 12 )
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        v = _mm_shuffle_epi8(v, shuffle);
+        v = _mm_or_si128(_mm_and_si128(v, evenMask), _mm_and_si128(_mm_srli_epi16(v, 4), oddMask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    }
+    unpackMono12pScalar(src, dst + i, pixels - i);
+}
+
+void shiftMono16To8SSE2(const uint16_t* src, uint8_t* dst, size_t pixels, unsigned int shift)
+{
+    const __m128i count = _mm_cvtsi32_si128(int(shift));
+    // packus saturates signed values, clamp to 255 unsigned first
+    const __m128i clamp = _mm_set1_epi16(int16_t(0xFF00));
+
+    size_t i = 0;
+    for( ; i + 16 <= pixels; i += 16 )
+    {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+        lo = _mm_subs_epu16(_mm_adds_epu16(_mm_srl_epi16(lo, count), clamp), clamp);
+        hi = _mm_subs_epu16(_mm_adds_epu16(_mm_srl_epi16(hi, count), clamp), clamp);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    shiftMono16To8Scalar(src + i, dst + i, pixels - i, shift);
+}
+
+__attribute__((target("avx2")))
+void shiftMono16To8AVX2(const uint16_t* src, uint8_t* dst, size_t pixels, unsigned int shift)
+{
+    const __m128i count = _mm_cvtsi32_si128(int(shift));
+    const __m256i max = _mm256_set1_epi16(255);
+
+    size_t i = 0;
+    for( ; i + 32 <= pixels; i += 32 )
+    {
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 16));
+        lo = _mm256_min_epu16(_mm256_srl_epi16(lo, count), max);
+        hi = _mm256_min_epu16(_mm256_srl_epi16(hi, count), max);
+        // packus works per 128 bit lane, restore pixel order afterwards
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+    }
+    // the SSE2 tail is not VEX encoded, leave the upper halves clean for it
+    _mm256_zeroupper();
+    shiftMono16To8SSE2(src + i, dst + i, pixels - i, shift);
+}
+
+template<bool HISTOGRAM>
+void copyStatisticsSSE2(const uint8_t* src, uint8_t* dst, size_t pixels, ImageStatistics& stats)
+{
+    const size_t THRESHOLDS = ImageStatistics::NUM_BINS - 1;
+    const __m128i zero = _mm_setzero_si128();
+    // unsigned v >= 16 k as signed compare: (v ^ 0x80) > (16 k - 1) ^ 0x80
+    const __m128i bias = _mm_set1_epi8(char(0x80));
+    __m128i thresholds[THRESHOLDS];
+    for( size_t k = 0; k < THRESHOLDS; ++k )
+    {
+        thresholds[k] = _mm_set1_epi8(char( ( 16 * ( k + 1 ) - 1 ) ^ 0x80 ));
+    }
+    const __m128i saturation = _mm_set1_epi8(char(stats.saturationLevel));
+
+    __m128i sum = zero;
+    __m128i min = _mm_set1_epi8(char(0xFF));
+    __m128i max = zero;
+    uint64_t atLeast[ImageStatistics::NUM_BINS] = {};
+    uint64_t saturated = 0;
+
+    size_t i = 0;
+    while( i + 16 <= pixels )
+    {
+        const size_t end = i + std::min<size_t>( 255, ( pixels - i ) / 16 ) * 16;
+        __m128i counts[THRESHOLDS];
+        for( size_t k = 0; k < THRESHOLDS; ++k )
+        {
+            counts[k] = zero;
+        }
+        __m128i saturatedCount = zero;
+
+        for( ; i < end; i += 16 )
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            if( NULL != dst )
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+            }
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(v, zero));
+            min = _mm_min_epu8(min, v);
+            max = _mm_max_epu8(max, v);
+            // matches are -1, subtracting counts them
+            saturatedCount = _mm_sub_epi8(saturatedCount, _mm_cmpeq_epi8(_mm_max_epu8(v, saturation), v));
+            const __m128i biased = _mm_xor_si128(v, bias);
+            for( size_t k = 0; HISTOGRAM && k < THRESHOLDS; ++k )
+            {
+                counts[k] = _mm_sub_epi8(counts[k], _mm_cmpgt_epi8(biased, thresholds[k]));
+            }
+        }
+
+        uint64_t lanes[2];
+        for( size_t k = 0; HISTOGRAM && k < THRESHOLDS; ++k )
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), _mm_sad_epu8(counts[k], zero));
+            atLeast[k + 1] += lanes[0] + lanes[1];
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), _mm_sad_epu8(saturatedCount, zero));
+        saturated += lanes[0] + lanes[1];
+    }
+
+    if( i > 0 )
+    {
+        uint64_t lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sum);
+        stats.sum += lanes[0] + lanes[1];
+        stats.saturated += saturated;
+        if( HISTOGRAM )
+        {
+            addCumulative(stats, i, atLeast);
+        }
+
+        uint8_t bytes[16];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), min);
+        stats.min = std::min(stats.min, *std::min_element(bytes, bytes + 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), max);
+        stats.max = std::max(stats.max, *std::max_element(bytes, bytes + 16));
+    }
+    copyStatisticsScalar(src + i, NULL != dst ? dst + i : NULL, pixels - i, stats, HISTOGRAM);
+}
+
+template<bool HISTOGRAM>
+__attribute__((target("avx2")))
+void copyStatisticsAVX2(const uint8_t* src, uint8_t* dst, size_t pixels, ImageStatistics& stats)
+{
+    const size_t THRESHOLDS = ImageStatistics::NUM_BINS - 1;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i bias = _mm256_set1_epi8(char(0x80));
+    __m256i thresholds[THRESHOLDS];
+    for( size_t k = 0; k < THRESHOLDS; ++k )
+    {
+        thresholds[k] = _mm256_set1_epi8(char( ( 16 * ( k + 1 ) - 1 ) ^ 0x80 ));
+    }
+    const __m256i saturation = _mm256_set1_epi8(char(stats.saturationLevel));
+
+    __m256i sum = zero;
+    __m256i min = _mm256_set1_epi8(char(0xFF));
+    __m256i max = zero;
+    uint64_t atLeast[ImageStatistics::NUM_BINS] = {};
+    uint64_t saturated = 0;
+
+    size_t i = 0;
+    while( i + 32 <= pixels )
+    {
+        const size_t end = i + std::min<size_t>( 255, ( pixels - i ) / 32 ) * 32;
+        __m256i counts[THRESHOLDS];
+        for( size_t k = 0; k < THRESHOLDS; ++k )
+        {
+            counts[k] = zero;
+        }
+        __m256i saturatedCount = zero;
+
+        for( ; i < end; i += 32 )
+        {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            if( NULL != dst )
+            {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+            }
+            sum = _mm256_add_epi64(sum, _mm256_sad_epu8(v, zero));
+            min = _mm256_min_epu8(min, v);
+            max = _mm256_max_epu8(max, v);
+            saturatedCount = _mm256_sub_epi8(saturatedCount, _mm256_cmpeq_epi8(_mm256_max_epu8(v, saturation), v));
+            const __m256i biased = _mm256_xor_si256(v, bias);
+            for( size_t k = 0; HISTOGRAM && k < THRESHOLDS; ++k )
+            {
+                counts[k] = _mm256_sub_epi8(counts[k], _mm256_cmpgt_epi8(biased, thresholds[k]));
+            }
+        }
+
+        uint64_t lanes[4];
+        for( size_t k = 0; HISTOGRAM && k < THRESHOLDS; ++k )
+        {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), _mm256_sad_epu8(counts[k], zero));
+            atLeast[k + 1] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), _mm256_sad_epu8(saturatedCount, zero));
+        saturated += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    if( i > 0 )
+    {
+        uint64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sum);
+        stats.sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        stats.saturated += saturated;
+        if( HISTOGRAM )
+        {
+            addCumulative(stats, i, atLeast);
+        }
+
+        uint8_t bytes[32];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(bytes), min);
+        stats.min = std::min(stats.min, *std::min_element(bytes, bytes + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(bytes), max);
+        stats.max = std::max(stats.max, *std::max_element(bytes, bytes + 32));
+    }
+    copyStatisticsSSE2<HISTOGRAM>(src + i, NULL != dst ? dst + i : NULL, pixels - i, stats);
+}
+
+#endif // PIXEL_CONVERSION_X86
+
+#ifdef PIXEL_CONVERSION_NEON
+
+template<bool HISTOGRAM>
+void copyStatisticsNEON(const uint8_t* src, uint8_t* dst, size_t pixels, ImageStatistics& stats)
+{
+    const size_t THRESHOLDS = ImageStatistics::NUM_BINS - 1;
+    const uint8x16_t saturation = vdupq_n_u8(stats.saturationLevel);
+
+    uint64x2_t sum = vdupq_n_u64(0);
+    uint8x16_t min = vdupq_n_u8(0xFF);
+    uint8x16_t max = vdupq_n_u8(0);
+    uint64_t atLeast[ImageStatistics::NUM_BINS] = {};
+    uint64_t saturated = 0;
+
+    size_t i = 0;
+    while( i + 16 <= pixels )
+    {
+        const size_t end = i + std::min<size_t>( 255, ( pixels - i ) / 16 ) * 16;
+        uint8x16_t counts[THRESHOLDS];
+        for( size_t k = 0; k < THRESHOLDS; ++k )
+        {
+            counts[k] = vdupq_n_u8(0);
+        }
+        uint8x16_t saturatedCount = vdupq_n_u8(0);
+
+        for( ; i < end; i += 16 )
+        {
+            const uint8x16_t v = vld1q_u8(src + i);
+            if( NULL != dst )
+            {
+                vst1q_u8(dst + i, v);
+            }
+            sum = vpadalq_u32(sum, vpaddlq_u16(vpaddlq_u8(v)));
+            min = vminq_u8(min, v);
+            max = vmaxq_u8(max, v);
+            // matches are 0xFF, subtracting counts them
+            saturatedCount = vsubq_u8(saturatedCount, vcgeq_u8(v, saturation));
+            for( size_t k = 0; HISTOGRAM && k < THRESHOLDS; ++k )
+            {
+                counts[k] = vsubq_u8(counts[k], vcgeq_u8(v, vdupq_n_u8(uint8_t( 16 * ( k + 1 ) ))));
+            }
+        }
+
+        for( size_t k = 0; HISTOGRAM && k < THRESHOLDS; ++k )
+        {
+            uint64x2_t total = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(counts[k])));
+            atLeast[k + 1] += vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1);
+        }
+        uint64x2_t total = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(saturatedCount)));
+        saturated += vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1);
+    }
+
+    if( i > 0 )
+    {
+        stats.sum += vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1);
+        stats.saturated += saturated;
+        if( HISTOGRAM )
+        {
+            addCumulative(stats, i, atLeast);
+        }
+
+        uint8_t bytes[16];
+        vst1q_u8(bytes, min);
+        stats.min = std::min(stats.min, *std::min_element(bytes, bytes + 16));
+        vst1q_u8(bytes, max);
+        stats.max = std::max(stats.max, *std::max_element(bytes, bytes + 16));
+    }
+    copyStatisticsScalar(src + i, NULL != dst ? dst + i : NULL, pixels - i, stats, HISTOGRAM);
+}
+
+void shiftMono16To8NEON(const uint16_t* src, uint8_t* dst, size_t pixels, unsigned int shift)
+{
+    const int16x8_t count = vdupq_n_s16( -int16_t(shift) );
+
+    size_t i = 0;
+    for( ; i + 16 <= pixels; i += 16 )
+    {
+        uint16x8_t lo = vshlq_u16(vld1q_u16(src + i), count);
+        uint16x8_t hi = vshlq_u16(vld1q_u16(src + i + 8), count);
+        vst1q_u8(dst + i, vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)));
+    }
+    shiftMono16To8Scalar(src + i, dst + i, pixels - i, shift);
+}
+
+#ifdef __aarch64__
+void unpackMono12pNEON(const uint8_t* src, uint16_t* dst, size_t pixels)
+{
+    static const uint8_t shuffleBytes[16] = { 0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11 };
+    static const int16_t shiftValues[8] = { 0, -4, 0, -4, 0, -4, 0, -4 };
+    const uint8x16_t shuffle = vld1q_u8(shuffleBytes);
+    const int16x8_t shifts = vld1q_s16(shiftValues);
+    const uint16x8_t mask = vdupq_n_u16(0x0FFF);
+
+    size_t i = 0;
+    for( ; i + 8 <= pixels && ( pixels - i ) * 12 / 8 >= 16; i += 8, src += 12 )
+    {
+        uint16x8_t v = vreinterpretq_u16_u8(vqtbl1q_u8(vld1q_u8(src), shuffle));
+        vst1q_u16(dst + i, vandq_u16(vshlq_u16(v, shifts), mask));
+    }
+    unpackMono12pScalar(src, dst + i, pixels - i);
+}
+
+void unpackMono10pNEON(const uint8_t* src, uint16_t* dst, size_t pixels)
+{
+    static const uint8_t shuffleBytes[16] = { 0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9 };
+    static const int16_t shiftValues[8] = { 0, -2, -4, -6, 0, -2, -4, -6 };
+    const uint8x16_t shuffle = vld1q_u8(shuffleBytes);
+    const int16x8_t shifts = vld1q_s16(shiftValues);
+    const uint16x8_t mask = vdupq_n_u16(0x03FF);
+
+    size_t i = 0;
+    for( ; i + 8 <= pixels && ( pixels - i ) * 10 / 8 >= 16; i += 8, src += 10 )
+    {
+        uint16x8_t v = vreinterpretq_u16_u8(vqtbl1q_u8(vld1q_u8(src), shuffle));
+        vst1q_u16(dst + i, vandq_u16(vshlq_u16(v, shifts), mask));
+    }
+    unpackMono10pScalar(src, dst + i, pixels - i);
+}
+#endif // __aarch64__
+
+#endif // PIXEL_CONVERSION_NEON
+
+}  // namespace
+
+void unpackMono10p(const uint8_t* src, uint16_t* dst, size_t pixels)
+{
+#if defined(PIXEL_CONVERSION_X86)
+    if( CpuFeatures::get().ssse3 )
+    {
+        unpackMono10pSSSE3(src, dst, pixels);
+        return;
+    }
+#elif defined(PIXEL_CONVERSION_NEON) && defined(__aarch64__)
+    unpackMono10pNEON(src, dst, pixels);
+    return;
+#endif
+    unpackMono10pScalar(src, dst, pixels);
+}
+
+void unpackMono12p(const uint8_t* src, uint16_t* dst, size_t pixels)
+{
+#if defined(PIXEL_CONVERSION_X86)
+    if( CpuFeatures::get().ssse3 )
+    {
+        unpackMono12pSSSE3(src, dst, pixels);
+        return;
+    }
+#elif defined(PIXEL_CONVERSION_NEON) && defined(__aarch64__)
+    unpackMono12pNEON(src, dst, pixels);
+    return;
+#endif
+    unpackMono12pScalar(src, dst, pixels);
+}
+
+void shiftMono16To8(const uint16_t* src, uint8_t* dst, size_t pixels, unsigned int shift)
+{
+#if defined(PIXEL_CONVERSION_X86)
+    if( CpuFeatures::get().avx2 )
+    {
+        shiftMono16To8AVX2(src, dst, pixels, shift);
+    }
+    else
+    {
+        shiftMono16To8SSE2(src, dst, pixels, shift);
+    }
+#elif defined(PIXEL_CONVERSION_NEON)
+    shiftMono16To8NEON(src, dst, pixels, shift);
+#else
+    shiftMono16To8Scalar(src, dst, pixels, shift);
+#endif
+}
+
+void lutMono16To8(const uint16_t* src, uint8_t* dst, size_t pixels, const uint8_t* lut, uint16_t mask)
+{
+    // table lookups don't vectorize without gathers, unroll instead
+    size_t i = 0;
+    for( ; i + 4 <= pixels; i += 4 )
+    {
+        dst[i + 0] = lut[src[i + 0] & mask];
+        dst[i + 1] = lut[src[i + 1] & mask];
+        dst[i + 2] = lut[src[i + 2] & mask];
+        dst[i + 3] = lut[src[i + 3] & mask];
+    }
+    for( ; i < pixels; ++i )
+    {
+        dst[i] = lut[src[i] & mask];
+    }
+}
+
+void copyStatistics(const uint8_t* src, uint8_t* dst, size_t pixels, ImageStatistics& stats, bool histogram)
+{
+#if defined(PIXEL_CONVERSION_X86)
+    if( CpuFeatures::get().avx2 )
+    {
+        histogram ? copyStatisticsAVX2<true>(src, dst, pixels, stats) : copyStatisticsAVX2<false>(src, dst, pixels, stats);
+    }
+    else
+    {
+        histogram ? copyStatisticsSSE2<true>(src, dst, pixels, stats) : copyStatisticsSSE2<false>(src, dst, pixels, stats);
+    }
+#elif defined(PIXEL_CONVERSION_NEON)
+    histogram ? copyStatisticsNEON<true>(src, dst, pixels, stats) : copyStatisticsNEON<false>(src, dst, pixels, stats);
+#else
+    copyStatisticsScalar(src, dst, pixels, stats, histogram);
+#endif
+}
+
+}  // namespace kernels
+
+MonoConverter::MonoConverter() :
+    format(PixelFormat::MONO8),
+    useLut(false)
+{
+}
+
+void MonoConverter::configure(PixelFormat format, double gamma)
+{
+    this->format = format;
+    // 8 bit data is passed through unchanged
+    useLut = ( significantBits(format) > 8 && gamma > 0.0 && std::fabs(gamma - 1.0) > 1e-6 );
+
+    lut.clear();
+    if( useLut )
+    {
+        const size_t bits = significantBits(format);
+        const size_t size = size_t(1) << bits;
+        const double max = double(size - 1);
+        lut.resize(size);
+        for( size_t i = 0; i < size; ++i )
+        {
+            lut[i] = uint8_t( std::lround( 255.0 * std::pow(double(i) / max, 1.0 / gamma) ) );
+        }
+    }
+}
+
+void MonoConverter::rowTo16(const uint8_t* src, uint16_t* dst, size_t width)
+{
+    switch( format )
+    {
+    case PixelFormat::MONO8:
+    case PixelFormat::BAYER8:
+        for( size_t i = 0; i < width; ++i )
+        {
+            dst[i] = src[i];
+        }
+        break;
+    case PixelFormat::MONO10:
+    case PixelFormat::MONO12:
+    case PixelFormat::MONO16:
+        std::memcpy(dst, src, width * sizeof(uint16_t));
+        break;
+    case PixelFormat::MONO10_PACKED:
+        kernels::unpackMono10p(src, dst, width);
+        break;
+    case PixelFormat::MONO12_PACKED:
+        kernels::unpackMono12p(src, dst, width);
+        break;
+    case PixelFormat::RGB8:
+    case PixelFormat::BGRA8:
+    case PixelFormat::YUYV:
+        // not a single channel format
+        break;
+    }
+}
+
+void MonoConverter::to8(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, size_t width, size_t height)
+{
+    const bool packed = ( PixelFormat::MONO10_PACKED == format || PixelFormat::MONO12_PACKED == format );
+    const bool copy = ( 8 == bitsPerPixel(format) );
+    if( packed && scratch.size() < width )
+    {
+        scratch.resize(width);
+    }
+
+    const unsigned int shift = unsigned(significantBits(format)) - 8;
+    const uint16_t mask = uint16_t( lut.size() - 1 );
+
+    for( size_t y = 0; y < height; ++y, src += srcStride, dst += dstStride )
+    {
+        if( copy )
+        {
+            std::memcpy(dst, src, width);
+            continue;
+        }
+
+        // packed rows are unpacked into the scratch row first
+        const uint16_t* row = reinterpret_cast<const uint16_t*>(src);
+        if( packed )
+        {
+            rowTo16(src, scratch.data(), width);
+            row = scratch.data();
+        }
+
+        if( useLut )
+        {
+            kernels::lutMono16To8(row, dst, width, lut.data(), mask);
+        }
+        else
+        {
+            kernels::shiftMono16To8(row, dst, width, shift);
+        }
+    }
+}
+
+void MonoConverter::to16(const uint8_t* src, size_t srcStride, uint16_t* dst, size_t dstStride, size_t width, size_t height)
+{
+    for( size_t y = 0; y < height; ++y, src += srcStride )
+    {
+        rowTo16(src, reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(dst) + y * dstStride), width);
+    }
+}
+
+}
@@ -0,0 +1,233 @@
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PYRAMID_X86
+#endif
+
+#include "pyramid.h"
+#include "cpu_features.h"
+
+namespace lms_ueye_importer
+{
+
+namespace
+{
+
+void boxRowScalar(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t begin, size_t end)
+{
+    for( size_t x = begin; x < end; ++x )
+    {
+        dst[x] = uint8_t( ( a[2 * x] + a[2 * x + 1] + b[2 * x] + b[2 * x + 1] + 2 ) >> 2 );
+    }
+}
+
+void verticalScalar(const uint8_t* r0, const uint8_t* r1, const uint8_t* r2, uint16_t* sums, size_t begin, size_t end)
+{
+    for( size_t x = begin; x < end; ++x )
+    {
+        sums[x] = uint16_t( r0[x] + 2 * r1[x] + r2[x] );
+    }
+}
+
+void horizontalScalar(const uint16_t* sums, uint8_t* dst, size_t begin, size_t end)
+{
+    for( size_t x = begin; x < end; ++x )
+    {
+        // column -1 is mirrored to column 1
+        unsigned int left = x > 0 ? sums[2 * x - 1] : sums[1];
+        dst[x] = uint8_t( ( left + 2 * sums[2 * x] + sums[2 * x + 1] + 8 ) >> 4 );
+    }
+}
+
+#ifdef PYRAMID_X86
+
+__attribute__((target("ssse3")))
+void boxRowSSSE3(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t width)
+{
+    const __m128i ones = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi16(2);
+
+    size_t x = 0;
+    for( ; x + 16 <= width; x += 16 )
+    {
+        // horizontal pair sums in 16 bit lanes
+        __m128i lo = _mm_add_epi16(_mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + 2 * x)), ones),
+                                   _mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + 2 * x)), ones));
+        __m128i hi = _mm_add_epi16(_mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + 2 * x + 16)), ones),
+                                   _mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + 2 * x + 16)), ones));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(lo, hi));
+    }
+    boxRowScalar(a, b, dst, x, width);
+}
+
+__attribute__((target("ssse3")))
+void verticalSSSE3(const uint8_t* r0, const uint8_t* r1, const uint8_t* r2, uint16_t* sums, size_t width)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t x = 0;
+    for( ; x + 16 <= width; x += 16 )
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0 + x));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + x));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r2 + x));
+
+        __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(c, zero)),
+                                   _mm_slli_epi16(_mm_unpacklo_epi8(b, zero), 1));
+        __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(c, zero)),
+                                   _mm_slli_epi16(_mm_unpackhi_epi8(b, zero), 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + x), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + x + 8), hi);
+    }
+    verticalScalar(r0, r1, r2, sums, x, width);
+}
+
+__attribute__((target("ssse3")))
+inline __m128i horizontal4(const uint16_t* sums, size_t x)
+{
+    // 32 bit lanes hold (sums[2x], sums[2x + 1]), the load 2 elements
+    // earlier provides sums[2x - 1] in the upper halves
+    const __m128i low = _mm_set1_epi32(0xFFFF);
+    __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums + 2 * x));
+    __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums + 2 * x - 2));
+
+    __m128i sum = _mm_add_epi32(_mm_srli_epi32(prev, 16), _mm_slli_epi32(_mm_and_si128(cur, low), 1));
+    sum = _mm_add_epi32(sum, _mm_srli_epi32(cur, 16));
+    return _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(8)), 4);
+}
+
+__attribute__((target("ssse3")))
+void horizontalSSSE3(const uint16_t* sums, uint8_t* dst, size_t width)
+{
+    // first output needs the mirrored column
+    horizontalScalar(sums, dst, 0, 1);
+
+    size_t x = 1;
+    for( ; x + 16 <= width; x += 16 )
+    {
+        __m128i a = _mm_packs_epi32(horizontal4(sums, x), horizontal4(sums, x + 4));
+        __m128i b = _mm_packs_epi32(horizontal4(sums, x + 8), horizontal4(sums, x + 12));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(a, b));
+    }
+    horizontalScalar(sums, dst, x, width);
+}
+
+#endif // PYRAMID_X86
+
+void boxRow(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t width)
+{
+#ifdef PYRAMID_X86
+    if( CpuFeatures::get().ssse3 )
+    {
+        boxRowSSSE3(a, b, dst, width);
+        return;
+    }
+#endif
+    boxRowScalar(a, b, dst, 0, width);
+}
+
+void gaussianRow(const uint8_t* r0, const uint8_t* r1, const uint8_t* r2, uint16_t* sums, size_t inWidth, uint8_t* dst, size_t width)
+{
+#ifdef PYRAMID_X86
+    if( CpuFeatures::get().ssse3 )
+    {
+        verticalSSSE3(r0, r1, r2, sums, inWidth);
+        horizontalSSSE3(sums, dst, width);
+        return;
+    }
+#endif
+    verticalScalar(r0, r1, r2, sums, 0, inWidth);
+    horizontalScalar(sums, dst, 0, width);
+}
+
+}  // namespace
+
+Pyramid::Pyramid() :
+    levels(0),
+    filter(PyramidFilter::BOX),
+    outputs(NULL)
+{
+}
+
+void Pyramid::configure(size_t levels, PyramidFilter filter)
+{
+    this->levels = levels;
+    this->filter = filter;
+}
+
+void Pyramid::levelSize(size_t width, size_t height, size_t level, size_t& levelWidth, size_t& levelHeight)
+{
+    levelWidth = width >> level;
+    levelHeight = height >> level;
+}
+
+const uint8_t* Pyramid::row(size_t level, size_t y) const
+{
+    return bases[level] + y * strides[level];
+}
+
+void Pyramid::process(const uint8_t* src, size_t srcStride, uint8_t* full, size_t width, size_t height, uint8_t* const* out)
+{
+    widths.resize(levels + 1);
+    heights.resize(levels + 1);
+    bases.resize(levels + 1);
+    strides.resize(levels + 1);
+
+    for( size_t level = 0; level <= levels; ++level )
+    {
+        levelSize(width, height, level, widths[level], heights[level]);
+        bases[level] = level == 0 ? src : out[level - 1];
+        strides[level] = level == 0 ? srcStride : widths[level];
+    }
+    outputs = out;
+    if( scratch.size() < width )
+    {
+        scratch.resize(width);
+    }
+
+    for( size_t y = 0; y < height; ++y )
+    {
+        if( NULL != full )
+        {
+            std::memcpy(full + y * width, src + y * srcStride, width);
+        }
+        if( levels > 0 )
+        {
+            rowDone(0, y);
+        }
+    }
+}
+
+void Pyramid::rowDone(size_t level, size_t y)
+{
+    // Output row z of the next level needs rows up to 2z + 1
+    if( ( y & 1 ) == 0 || level >= levels )
+    {
+        return;
+    }
+    const size_t z = y / 2;
+    const size_t next = level + 1;
+    if( z >= heights[next] || widths[next] == 0 )
+    {
+        return;
+    }
+
+    uint8_t* dst = outputs[level] + z * widths[next];
+    if( PyramidFilter::BOX == filter )
+    {
+        boxRow(row(level, 2 * z), row(level, 2 * z + 1), dst, widths[next]);
+    }
+    else
+    {
+        // row -1 is mirrored to row 1
+        const uint8_t* above = row(level, z > 0 ? 2 * z - 1 : 1);
+        gaussianRow(above, row(level, 2 * z), row(level, 2 * z + 1), scratch.data(), widths[level], dst, widths[next]);
+    }
+
+    rowDone(next, z);
+}
+
+}
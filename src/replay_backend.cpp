@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "replay_backend.h"
+#include "pixel_conversion.h"
+
+namespace lms_ueye_importer
+{
+
+ReplayBackend::ReplayBackend(const std::string& prefix, ReplayPacing pacing, double speed, bool loop, size_t decodeThreads) :
+    SimulatedBackend(0, 0),
+    prefix(prefix),
+    pacing(pacing),
+    speed(speed > 0.0 ? speed : 1.0),
+    loop(loop),
+    recordedFormat(PixelFormat::MONO8),
+    codec(decodeThreads),
+    cursor(0),
+    current(NULL),
+    restart(true),
+    firstTimestamp(0)
+{
+}
+
+ReplayBackend::~ReplayBackend()
+{
+    // the producer thread calls into this class
+    close();
+}
+
+int ReplayBackend::open(uint32_t deviceId, const std::string& serial)
+{
+    if( !load() )
+    {
+        unload();
+        return BACKEND_NO_SUCCESS;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const FrameRecorder::RecordHeader* first = records.front();
+        recordedFormat = static_cast<PixelFormat>(first->format);
+        sensorWidth = width = first->width;
+        sensorHeight = height = first->height;
+        format = recordedFormat;
+        cursor = 0;
+        restart = true;
+    }
+    return SimulatedBackend::open(deviceId, serial);
+}
+
+int ReplayBackend::close()
+{
+    int ret = SimulatedBackend::close();
+    unload();
+    return ret;
+}
+
+int ReplayBackend::getSensorInfo(SensorInfo& info)
+{
+    SimulatedBackend::getSensorInfo(info);
+    info.name = "Replay " + prefix;
+    return BACKEND_SUCCESS;
+}
+
+std::string ReplayBackend::getLastError()
+{
+    return lastError.empty() ? SimulatedBackend::getLastError() : lastError;
+}
+
+int ReplayBackend::setColorMode(PixelFormat format)
+{
+    if( format != recordedFormat )
+    {
+        lastError = "Recording has a different pixel format";
+        return BACKEND_NOT_SUPPORTED;
+    }
+    return SimulatedBackend::setColorMode(format);
+}
+
+int ReplayBackend::setTriggerMode(TriggerMode mode)
+{
+    if( mode != TriggerMode::OFF )
+    {
+        lastError = "Recorded frames can not be triggered";
+        return BACKEND_NOT_SUPPORTED;
+    }
+    return SimulatedBackend::setTriggerMode(mode);
+}
+
+int ReplayBackend::setAOI(size_t width, size_t height, size_t offsetX, size_t offsetY)
+{
+    if( width != sensorWidth || height != sensorHeight || offsetX != 0 || offsetY != 0 )
+    {
+        lastError = "AOI of a recording can not be changed";
+        return BACKEND_NOT_SUPPORTED;
+    }
+    return SimulatedBackend::setAOI(width, height, offsetX, offsetY);
+}
+
+int ReplayBackend::setBinning(size_t horizontal, size_t vertical)
+{
+    return ( horizontal == 1 && vertical == 1 ) ? BACKEND_SUCCESS : BACKEND_NOT_SUPPORTED;
+}
+
+int ReplayBackend::setSubsampling(size_t horizontal, size_t vertical)
+{
+    return ( horizontal == 1 && vertical == 1 ) ? BACKEND_SUCCESS : BACKEND_NOT_SUPPORTED;
+}
+
+int ReplayBackend::setFrameRate(double fps, double& actual)
+{
+    if( fps <= 0.0 )
+    {
+        return BACKEND_INVALID_PARAMETER;
+    }
+    // not limited by a sensor readout
+    std::lock_guard<std::mutex> lock(mutex);
+    frameRate = fps;
+    actual = fps;
+    return BACKEND_SUCCESS;
+}
+
+int ReplayBackend::startCapture()
+{
+    {
+        // real-time pacing restarts from the current frame
+        std::lock_guard<std::mutex> lock(mutex);
+        restart = true;
+    }
+    return SimulatedBackend::startCapture();
+}
+
+bool ReplayBackend::scheduleFrame(Clock::time_point& next)
+{
+    if( cursor >= records.size() )
+    {
+        if( !loop || records.empty() )
+        {
+            return false;
+        }
+        cursor = 0;
+        restart = true;
+    }
+    current = records[cursor++];
+
+    switch( pacing )
+    {
+    case ReplayPacing::REALTIME:
+        if( restart )
+        {
+            replayStart = Clock::now();
+            firstTimestamp = current->eventTimestamp;
+            restart = false;
+        }
+        next = replayStart + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double, std::micro>( double(current->eventTimestamp - firstTimestamp) / speed ) );
+        return true;
+    case ReplayPacing::FIXED_RATE:
+        return SimulatedBackend::scheduleFrame(next);
+    case ReplayPacing::MAX_SPEED:
+        next = Clock::now();
+        return true;
+    }
+    // unknown
+    return false;
+}
+
+void ReplayBackend::produceFrame(char* dst, size_t rowBytes, size_t rows, PixelFormat format, ImageInfo& info)
+{
+    const uint8_t* payload = reinterpret_cast<const uint8_t*>(current) + sizeof(FrameRecorder::RecordHeader);
+    if( FrameRecorder::ENCODING_LOSSLESS == current->encoding )
+    {
+        if( !codec.decode(payload, current->payloadSize, format, current->width, rows, reinterpret_cast<uint8_t*>(dst), rowBytes) )
+        {
+            // corrupt frames show up black
+            std::memset(dst, 0, rowBytes * rows);
+        }
+    }
+    else if( rowBytes == current->rowBytes )
+    {
+        std::memcpy(dst, payload, std::min<size_t>(rowBytes * rows, current->payloadSize));
+    }
+    else
+    {
+        // recorded rows are not padded like the sequence buffer
+        const size_t length = std::min<size_t>(rowBytes, current->rowBytes);
+        for( size_t y = 0; y < rows && ( y + 1 ) * current->rowBytes <= current->payloadSize; ++y )
+        {
+            std::memcpy(dst + y * rowBytes, payload + y * current->rowBytes, length);
+        }
+    }
+
+    info.frameNumber = current->frameNumber;
+    info.deviceTimestamp = current->deviceTimestamp;
+}
+
+bool ReplayBackend::load()
+{
+    unload();
+
+    std::ifstream index((prefix + ".idx").c_str(), std::ios::binary);
+    if( !index )
+    {
+        lastError = "Could not open " + prefix + ".idx";
+        return false;
+    }
+
+    FrameRecorder::IndexEntry entry;
+    while( index.read(reinterpret_cast<char*>(&entry), sizeof(entry)) )
+    {
+        while( segments.size() <= entry.segment )
+        {
+            mapSegment(segments.size());
+        }
+
+        // skip entries pointing past the data, e.g. of an interrupted recording
+        const Segment& segment = segments[entry.segment];
+        if( NULL == segment.data || entry.offset + sizeof(FrameRecorder::RecordHeader) > segment.size )
+        {
+            continue;
+        }
+        const FrameRecorder::RecordHeader* record = reinterpret_cast<const FrameRecorder::RecordHeader*>(segment.data + entry.offset);
+        if( FrameRecorder::RECORD_MAGIC != record->magic || entry.offset + sizeof(FrameRecorder::RecordHeader) + record->payloadSize > segment.size )
+        {
+            continue;
+        }
+
+        // every frame has the format of the first one
+        if( !records.empty() && ( record->format != records.front()->format || record->width != records.front()->width || record->height != records.front()->height ) )
+        {
+            continue;
+        }
+        const PixelFormat format = static_cast<PixelFormat>(record->format);
+        const bool valid = FrameRecorder::ENCODING_LOSSLESS == record->encoding
+            ? LosslessCodec::supports(format)
+            : FrameRecorder::ENCODING_RAW == record->encoding && record->payloadSize >= rowBytes(format, record->width) * record->height;
+        if( !valid )
+        {
+            continue;
+        }
+        records.push_back(record);
+    }
+
+    if( records.empty() )
+    {
+        lastError = "No frames in " + prefix;
+        return false;
+    }
+    return true;
+}
+
+void ReplayBackend::unload()
+{
+    records.clear();
+    for( const Segment& segment : segments )
+    {
+        if( NULL != segment.data )
+        {
+            munmap(const_cast<uint8_t*>(segment.data), segment.size);
+        }
+    }
+    segments.clear();
+}
+
+void ReplayBackend::mapSegment(size_t number)
+{
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), "_%04u.seg", unsigned(number));
+
+    Segment segment = { NULL, 0 };
+    int fd = ::open((prefix + suffix).c_str(), O_RDONLY);
+    struct stat info;
+    if( fd >= 0 && 0 == fstat(fd, &info) && info.st_size > 0 )
+    {
+        void* mem = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if( MAP_FAILED != mem )
+        {
+            madvise(mem, info.st_size, MADV_SEQUENTIAL);
+            segment.data = static_cast<const uint8_t*>(mem);
+            segment.size = info.st_size;
+        }
+    }
+    if( fd >= 0 )
+    {
+        ::close(fd);
+    }
+    segments.push_back(segment);
+}
+
+}
@@ -0,0 +1,834 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "simulated_backend.h"
+#include "pixel_conversion.h"
+
+namespace lms_ueye_importer
+{
+
+namespace
+{
+// Horizontal and vertical blanking of the simulated sensor readout (pixels)
+const size_t BLANKING_X = 32;
+const size_t BLANKING_Y = 16;
+
+// Slowest frame rate the simulated sensor supports (fps)
+const double MIN_FRAME_RATE = 0.5;
+}
+
+SimulatedBackend::SimulatedBackend(size_t sensorWidth, size_t sensorHeight) :
+    opened(false),
+    running(false),
+    frameEventEnabled(false),
+    frameEvent(false),
+    sensorWidth(sensorWidth),
+    sensorHeight(sensorHeight),
+    width(sensorWidth),
+    height(sensorHeight),
+    format(PixelFormat::MONO8),
+    binningX(1),
+    binningY(1),
+    subsamplingX(1),
+    subsamplingY(1),
+    pixelClock(30),
+    frameRate(30.0),
+    exposure(10.0),
+    gain(0),
+    exposingBrightness(1.0),
+    frameBrightness(1.0),
+    nextId(1),
+    activeIndex(-1),
+    triggerMode(TriggerMode::OFF),
+    triggerPending(false),
+    frameCounter(0)
+{
+    resetCaptureStatus();
+}
+
+SimulatedBackend::~SimulatedBackend()
+{
+    close();
+}
+
+int SimulatedBackend::open(uint32_t, const std::string&)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    opened = true;
+    startTime = Clock::now();
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::close()
+{
+    stopCapture();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if( !opened )
+    {
+        return BACKEND_INVALID_CAMERA_HANDLE;
+    }
+    sequence.clear();
+    memory.clear();
+    activeIndex = -1;
+    opened = false;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::getSensorInfo(SensorInfo& info)
+{
+    info.name           = "Simulated";
+    info.color          = false;
+    info.maxWidth       = sensorWidth;
+    info.maxHeight      = sensorHeight;
+    info.masterGain     = true;
+    info.globalShutter  = true;
+    info.pixelSize      = 6.0f;
+    info.bayerPattern   = BayerPattern::RGGB;
+    return BACKEND_SUCCESS;
+}
+
+std::string SimulatedBackend::getLastError()
+{
+    return std::string("Simulated backend error");
+}
+
+int SimulatedBackend::setColorMode(PixelFormat format)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->format = format;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setTriggerMode(TriggerMode mode)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if( running )
+    {
+        return BACKEND_CAPTURE_RUNNING;
+    }
+    triggerMode = mode;
+    triggerPending = false;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setAOI(size_t width, size_t height, size_t offsetX, size_t offsetY)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if( running )
+    {
+        return BACKEND_CAPTURE_RUNNING;
+    }
+    if( width == 0 || height == 0 || offsetX + width > readoutWidth() || offsetY + height > readoutHeight() )
+    {
+        return BACKEND_INVALID_PARAMETER;
+    }
+    this->width = width;
+    this->height = height;
+    frameRate = std::min(frameRate, maxFrameRate());
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::getImageSize(size_t& width, size_t& height)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    width = this->width;
+    height = this->height;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setBinning(size_t horizontal, size_t vertical)
+{
+    return setReduction(horizontal, vertical, binningX, binningY);
+}
+
+int SimulatedBackend::setSubsampling(size_t horizontal, size_t vertical)
+{
+    return setReduction(horizontal, vertical, subsamplingX, subsamplingY);
+}
+
+int SimulatedBackend::setReduction(size_t horizontal, size_t vertical, size_t& factorX, size_t& factorY)
+{
+    static const size_t factors[] = { 1, 2, 3, 4, 5, 6, 8, 16 };
+    bool validX = false;
+    bool validY = false;
+    for( size_t f : factors )
+    {
+        validX |= f == horizontal;
+        validY |= f == vertical;
+    }
+    if( !validX || !validY )
+    {
+        return BACKEND_INVALID_PARAMETER;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if( running )
+    {
+        return BACKEND_CAPTURE_RUNNING;
+    }
+    factorX = horizontal;
+    factorY = vertical;
+
+    // like the uEye driver, the AOI is reset to the full reduced sensor
+    width = readoutWidth();
+    height = readoutHeight();
+    frameRate = std::min(frameRate, maxFrameRate());
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::getFrameTimeRange(double& minTime, double& maxTime)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    minTime = 1.0 / maxFrameRate();
+    maxTime = 1.0 / MIN_FRAME_RATE;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::allocImageMem(size_t width, size_t height, size_t bitsPerPixel, char** ptr, int* id)
+{
+    if( bitsPerPixel == 0 || width == 0 || height == 0 )
+    {
+        return BACKEND_INVALID_PARAMETER;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Buffer& buf = memory[nextId];
+    buf.pitch = ( width * bitsPerPixel + 7 ) / 8;
+    buf.size = buf.pitch * height;
+    buf.data.reset(new char[buf.size]);
+    buf.ptr = buf.data.get();
+    buf.locked = false;
+    buf.info = ImageInfo();
+    std::memset(buf.ptr, 0, buf.size);
+
+    *ptr = buf.ptr;
+    *id = nextId++;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setAllocatedImageMem(size_t width, size_t height, size_t bitsPerPixel, char* ptr, int* id)
+{
+    if( bitsPerPixel == 0 || width == 0 || height == 0 || NULL == ptr )
+    {
+        return BACKEND_INVALID_PARAMETER;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Buffer& buf = memory[nextId];
+    buf.pitch = ( width * bitsPerPixel + 7 ) / 8;
+    buf.size = buf.pitch * height;
+    buf.ptr = ptr;
+    buf.locked = false;
+    buf.info = ImageInfo();
+
+    *id = nextId++;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::freeImageMem(char* ptr, int id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = memory.find(id);
+    if( it == memory.end() || it->second.ptr != ptr )
+    {
+        return BACKEND_INVALID_MEMORY_POINTER;
+    }
+    if( std::find(sequence.begin(), sequence.end(), id) != sequence.end() )
+    {
+        // still part of the sequence
+        return BACKEND_CAPTURE_RUNNING;
+    }
+    memory.erase(it);
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::addToSequence(char* ptr, int id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = memory.find(id);
+    if( it == memory.end() || it->second.ptr != ptr )
+    {
+        return BACKEND_INVALID_MEMORY_POINTER;
+    }
+    sequence.push_back(id);
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::clearSequence()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if( running )
+    {
+        return BACKEND_CAPTURE_RUNNING;
+    }
+    sequence.clear();
+    activeIndex = -1;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::getActSeqBuf(int* seqNum, char** ptr)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if( activeIndex < 0 )
+    {
+        if( seqNum ) *seqNum = 0;
+        *ptr = NULL;
+        return BACKEND_SUCCESS;
+    }
+    // sequence numbers are 1-based as in the uEye SDK
+    if( seqNum ) *seqNum = activeIndex + 1;
+    *ptr = memory[sequence[activeIndex]].ptr;
+    return BACKEND_SUCCESS;
+}
+
+SimulatedBackend::Buffer* SimulatedBackend::findBuffer(char* ptr)
+{
+    for( auto& entry : memory )
+    {
+        if( entry.second.ptr == ptr )
+        {
+            return &entry.second;
+        }
+    }
+    return NULL;
+}
+
+int SimulatedBackend::lockSeqBuf(char* ptr)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Buffer* buf = findBuffer(ptr);
+    if( NULL == buf )
+    {
+        return BACKEND_INVALID_MEMORY_POINTER;
+    }
+    if( buf->locked )
+    {
+        return BACKEND_SEQUENCE_BUF_ALREADY_LOCKED;
+    }
+    buf->locked = true;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::unlockSeqBuf(char* ptr)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Buffer* buf = findBuffer(ptr);
+    if( NULL == buf )
+    {
+        return BACKEND_INVALID_MEMORY_POINTER;
+    }
+    buf->locked = false;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::copyImageMem(char* ptr, int id, char* dest)
+{
+    size_t size;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = memory.find(id);
+        if( it == memory.end() || it->second.ptr != ptr )
+        {
+            return BACKEND_INVALID_MEMORY_POINTER;
+        }
+        size = std::min(it->second.size, it->second.pitch * height);
+    }
+    std::memcpy(dest, ptr, size);
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::getImageMemPitch(char* ptr, int id, size_t& pitch)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = memory.find(id);
+    if( it == memory.end() || it->second.ptr != ptr )
+    {
+        return BACKEND_INVALID_MEMORY_POINTER;
+    }
+    pitch = it->second.pitch;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::getImageInfo(int id, ImageInfo& info)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = memory.find(id);
+    if( it == memory.end() )
+    {
+        return BACKEND_INVALID_MEMORY_POINTER;
+    }
+    info = it->second.info;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::saveParameters(const std::string& file)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ofstream out(file.c_str());
+    out << width << " " << height << " "
+        << binningX << " " << binningY << " " << subsamplingX << " " << subsamplingY << " "
+        << pixelClock << " " << frameRate << " " << exposure << "\n";
+    return out ? BACKEND_SUCCESS : BACKEND_INVALID_PARAMETER;
+}
+
+int SimulatedBackend::loadParameters(const std::string& file)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if( running )
+    {
+        return BACKEND_CAPTURE_RUNNING;
+    }
+
+    std::ifstream in(file.c_str());
+    size_t w, h, bx, by, sx, sy;
+    unsigned int clock;
+    double fps, exp;
+    if( !( in >> w >> h >> bx >> by >> sx >> sy >> clock >> fps >> exp ) || bx * sx == 0 || by * sy == 0 || clock == 0 || fps <= 0.0 )
+    {
+        return BACKEND_INVALID_PARAMETER;
+    }
+    if( w == 0 || h == 0 || w > sensorWidth / ( bx * sx ) || h > sensorHeight / ( by * sy ) )
+    {
+        return BACKEND_INVALID_PARAMETER;
+    }
+
+    binningX = bx;
+    binningY = by;
+    subsamplingX = sx;
+    subsamplingY = sy;
+    width = w;
+    height = h;
+    pixelClock = clock;
+    frameRate = std::min(fps, maxFrameRate());
+    exposure = exp;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::startCapture()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if( !opened )
+    {
+        return BACKEND_INVALID_CAMERA_HANDLE;
+    }
+    if( sequence.empty() )
+    {
+        return BACKEND_NO_SUCCESS;
+    }
+    if( running )
+    {
+        return BACKEND_SUCCESS;
+    }
+    running = true;
+    exposingBrightness = frameBrightness = brightness();
+    producer = std::thread(&SimulatedBackend::run, this);
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::stopCapture()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    stateCondition.notify_all();
+    frameCondition.notify_all();
+    if( producer.joinable() )
+    {
+        producer.join();
+    }
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::trigger()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if( triggerMode == TriggerMode::OFF )
+        {
+            return BACKEND_NOT_SUPPORTED;
+        }
+        if( !running )
+        {
+            return BACKEND_NO_SUCCESS;
+        }
+        triggerPending = true;
+    }
+    stateCondition.notify_all();
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::enableFrameEvent()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    frameEventEnabled = true;
+    frameEvent = false;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::disableFrameEvent()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        frameEventEnabled = false;
+        frameEvent = false;
+    }
+    frameCondition.notify_all();
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::waitFrameEvent(int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    auto ready = [this]{ return frameEvent || !frameEventEnabled; };
+    if( timeoutMs < 0 )
+    {
+        frameCondition.wait(lock, ready);
+    }
+    else
+    {
+        frameCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready);
+    }
+
+    if( !frameEvent )
+    {
+        return BACKEND_TIMED_OUT;
+    }
+    frameEvent = false;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::getCaptureStatus(CaptureStatus& status)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    status = captureStatus;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::resetCaptureStatus()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    captureStatus.total = 0;
+    captureStatus.counters.fill(0);
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setPixelClock(unsigned int clock)
+{
+    if( clock == 0 )
+    {
+        return BACKEND_INVALID_PARAMETER;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    pixelClock = clock;
+    frameRate = std::min(frameRate, maxFrameRate());
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::getPixelClock(unsigned int& clock)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    clock = pixelClock;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setFrameRate(double fps, double& actual)
+{
+    if( fps <= 0.0 )
+    {
+        return BACKEND_INVALID_PARAMETER;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    frameRate = std::min(fps, maxFrameRate());
+    exposure = std::min(exposure, 1000.0 / frameRate);
+    actual = frameRate;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::getFrameRate(double& fps)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    fps = frameRate;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::getExposure(double& exposure)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    exposure = this->exposure;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setExposure(double& exposure)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    // 0 selects the maximum exposure for the current frame rate
+    double maxExposure = 1000.0 / frameRate;
+    if( exposure <= 0.0 || exposure > maxExposure )
+    {
+        exposure = maxExposure;
+    }
+    this->exposure = exposure;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setHardwareGamma(bool)
+{
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setGamma(int)
+{
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setGainBoost(bool)
+{
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setAutoGain()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    gain = -1;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setGain(int value)
+{
+    if( value < 0 || value > 100 )
+    {
+        return BACKEND_INVALID_PARAMETER;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    gain = value;
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setGlobalShutter(bool)
+{
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setBlacklevelMode(bool)
+{
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setBlacklevelOffset(int)
+{
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setEdgeEnhancement(int)
+{
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setHDR(bool)
+{
+    return BACKEND_SUCCESS;
+}
+
+int SimulatedBackend::setHDRKneepoints(const std::vector< std::pair<double, double> >&)
+{
+    return BACKEND_SUCCESS;
+}
+
+double SimulatedBackend::maxFrameRate() const
+{
+    // readout time of one frame at the current pixel clock (MHz)
+    double pixels = double(width + BLANKING_X) * double(height + BLANKING_Y);
+    return double(pixelClock) * 1e6 / pixels;
+}
+
+double SimulatedBackend::brightness() const
+{
+    return exposure / 10.0 * ( gain > 0 ? 1.0 + 3.0 * gain / 100.0 : 1.0 );
+}
+
+void SimulatedBackend::render(char* dst, size_t rowBytes, size_t rows, uint64_t frame, PixelFormat format, double brightness)
+{
+    const size_t bits = bitsPerPixel(format);
+    const size_t shift = significantBits(format) - 8;
+
+    // Vertically scrolling gradient, every row filled with a single value
+    for( size_t y = 0; y < rows; ++y )
+    {
+        char* row = dst + y * rowBytes;
+        const int value = std::min( 255, int( ( (y + frame) & 0xFF ) * brightness ) );
+
+        if( 8 == bits )
+        {
+            std::memset(row, value, rowBytes);
+        }
+        else if( 16 == bits )
+        {
+            std::fill_n(reinterpret_cast<uint16_t*>(row), rowBytes / 2, uint16_t(value << shift));
+        }
+        else
+        {
+            // packed: 8 pixels fill exactly "bits" bytes, repeat that group
+            uint8_t group[16] = {};
+            const unsigned int pixel = unsigned(value) << shift;
+            for( size_t i = 0; i < 8 * bits; ++i )
+            {
+                if( pixel & ( 1u << ( i % bits ) ) )
+                {
+                    group[i / 8] |= uint8_t( 1u << ( i % 8 ) );
+                }
+            }
+            for( size_t x = 0; x < rowBytes; x += bits )
+            {
+                std::memcpy(row + x, group, std::min(bits, rowBytes - x));
+            }
+        }
+    }
+
+    // Stamp the frame counter into the first pixels
+    if( rowBytes * rows >= sizeof(frame) )
+    {
+        std::memcpy(dst, &frame, sizeof(frame));
+    }
+}
+
+bool SimulatedBackend::scheduleFrame(Clock::time_point& next)
+{
+    next += std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( 1.0 / frameRate ) );
+    Clock::time_point now = Clock::now();
+    if( next < now )
+    {
+        // fell behind (e.g. frame rate change), do not try to catch up
+        next = now;
+    }
+    return true;
+}
+
+void SimulatedBackend::produceFrame(char* dst, size_t rowBytes, size_t rows, PixelFormat format, ImageInfo& info)
+{
+    render(dst, rowBytes, rows, info.frameNumber, format, frameBrightness);
+}
+
+bool SimulatedBackend::waitTrigger(std::unique_lock<std::mutex>& lock, Clock::time_point& next)
+{
+    if( triggerMode == TriggerMode::SOFTWARE )
+    {
+        stateCondition.wait(lock, [this]{ return !running || triggerPending; });
+    }
+    else
+    {
+        // Edge of the pulse generator, or a forced trigger before it. An
+        // edge still ahead after a forced trigger is kept.
+        if( next <= Clock::now() )
+        {
+            scheduleFrame(next);
+        }
+        stateCondition.wait_until(lock, next, [this]{ return !running || triggerPending; });
+    }
+    if( !running )
+    {
+        return false;
+    }
+
+    // Expose with the settings at the trigger, later triggers are lost
+    // until the exposure ended
+    frameBrightness = brightness();
+    Clock::time_point exposureEnd = Clock::now() +
+        std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double, std::milli>( exposure ) );
+    stateCondition.wait_until(lock, exposureEnd, [this]{ return !running; });
+    triggerPending = false;
+    return running;
+}
+
+void SimulatedBackend::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    Clock::time_point next = Clock::now();
+
+    while( running )
+    {
+        if( triggerMode != TriggerMode::OFF )
+        {
+            if( !waitTrigger(lock, next) )
+            {
+                break;
+            }
+        }
+        else
+        {
+            if( !scheduleFrame(next) )
+            {
+                // source exhausted, idle until stopped
+                stateCondition.wait(lock, [this]{ return !running; });
+                break;
+            }
+
+            stateCondition.wait_until(lock, next, [this]{ return !running; });
+            if( !running )
+            {
+                break;
+            }
+
+            frameBrightness = exposingBrightness;
+            exposingBrightness = brightness();
+        }
+
+        // The sensor exposes a frame even if there is no buffer for it
+        uint64_t frame = ++frameCounter;
+        uint64_t exposureEnd = std::chrono::duration_cast<std::chrono::microseconds>( Clock::now() - startTime ).count();
+
+        // Next free buffer after the active one, like the driver ring
+        int target = -1;
+        const int count = sequence.size();
+        for( int i = 1; i <= count; ++i )
+        {
+            int index = ( activeIndex + i ) % count;
+            if( index < 0 ) index += count;
+            if( !memory[sequence[index]].locked )
+            {
+                target = index;
+                break;
+            }
+        }
+
+        if( target < 0 )
+        {
+            captureStatus.total++;
+            captureStatus.counters[CaptureStatus::DRV_OUT_OF_BUFFERS]++;
+            continue;
+        }
+
+        Buffer& buf = memory[sequence[target]];
+        char* dst = buf.ptr;
+        size_t pitch = buf.pitch;
+        size_t rows = height;
+        PixelFormat pixelFormat = format;
+
+        ImageInfo info;
+        info.frameNumber        = frame;
+        info.deviceTimestamp    = exposureEnd;
+
+        lock.unlock();
+        Clock::time_point transferStart = Clock::now();
+        produceFrame(dst, pitch, rows, pixelFormat, info);
+        Clock::duration transferTime = Clock::now() - transferStart;
+        lock.lock();
+
+        buf.info.frameNumber        = info.frameNumber;
+        buf.info.deviceTimestamp    = info.deviceTimestamp;
+        buf.info.hostProcessTime    = std::chrono::duration_cast<std::chrono::microseconds>( transferTime ).count();
+        buf.info.imageBuffers       = count;
+        buf.info.imageBuffersInUse  = std::count_if( sequence.begin(), sequence.end(), [this](int id) { return memory[id].locked; } );
+
+        activeIndex = target;
+        if( frameEventEnabled )
+        {
+            frameEvent = true;
+            frameCondition.notify_all();
+        }
+    }
+}
+
+}
@@ -0,0 +1,108 @@
+#include <algorithm>
+
+#include "thread_pool.h"
+
+namespace lms_ueye_importer
+{
+
+ThreadPool::ThreadPool(size_t threads) :
+    running(true),
+    job(NULL),
+    generation(0),
+    pending(0)
+{
+    if( threads == 0 )
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    parts.resize(threads);
+    for( size_t i = 1; i < threads; ++i )
+    {
+        workers.push_back( std::thread(&ThreadPool::work, this, i) );
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    startCondition.notify_all();
+    for( auto& worker : workers )
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn)
+{
+    grain = std::max<size_t>(1, grain);
+    const size_t units = ( count + grain - 1 ) / grain;
+    const size_t threads = std::min(size(), units);
+
+    if( threads <= 1 )
+    {
+        if( count > 0 )
+        {
+            fn(0, count);
+        }
+        return;
+    }
+
+    // Distribute the units evenly, the caller takes part 0
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t begin = 0;
+        for( size_t i = 0; i < parts.size(); ++i )
+        {
+            size_t n = i < threads ? units / threads + ( i < units % threads ? 1 : 0 ) : 0;
+            size_t end = std::min(count, begin + n * grain);
+            parts[i] = std::make_pair(begin, end);
+            begin = end;
+        }
+        job = &fn;
+        pending = workers.size();
+        generation++;
+    }
+    startCondition.notify_all();
+
+    fn(parts[0].first, parts[0].second);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this]{ return pending == 0; });
+    job = NULL;
+}
+
+void ThreadPool::work(size_t index)
+{
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while( true )
+    {
+        startCondition.wait(lock, [this, seen]{ return !running || generation != seen; });
+        if( !running )
+        {
+            return;
+        }
+        seen = generation;
+
+        std::pair<size_t, size_t> part = parts[index];
+        const std::function<void(size_t, size_t)>* fn = job;
+        lock.unlock();
+
+        if( part.first < part.second )
+        {
+            (*fn)(part.first, part.second);
+        }
+
+        lock.lock();
+        if( --pending == 0 )
+        {
+            doneCondition.notify_one();
+        }
+    }
+}
+
+}
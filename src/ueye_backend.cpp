@@ -0,0 +1,547 @@
+#include <cstring>
+#include <vector>
+
+#include "ueye_backend.h"
+
+namespace lms_ueye_importer
+{
+
+UeyeBackend::UeyeBackend() :
+    handle(0),
+    triggerMode(TriggerMode::OFF)
+{
+}
+
+UeyeBackend::~UeyeBackend()
+{
+    close();
+}
+
+int UeyeBackend::open(uint32_t deviceId, const std::string& serial)
+{
+    if( !serial.empty() && !findDeviceId(serial, deviceId) )
+    {
+        return IS_INVALID_DEVICE_ID;
+    }
+
+    // set camera handle id (0 = auto), select by device id if given so
+    // several cameras can be opened concurrently without racing for ids
+    handle = 0;
+    if( deviceId != 0 )
+    {
+        handle = deviceId | IS_USE_DEVICE_ID;
+    }
+    INT status = is_InitCamera(&handle, NULL);
+    if( IS_SUCCESS != status )
+    {
+        handle = 0;
+    }
+    return status;
+}
+
+bool UeyeBackend::findDeviceId(const std::string& serial, uint32_t& deviceId)
+{
+    INT count = 0;
+    if( IS_SUCCESS != is_GetNumberOfCameras(&count) || count <= 0 )
+    {
+        return false;
+    }
+
+    std::vector<char> mem( sizeof(UEYE_CAMERA_LIST) + count * sizeof(UEYE_CAMERA_INFO) );
+    UEYE_CAMERA_LIST* list = reinterpret_cast<UEYE_CAMERA_LIST*>( mem.data() );
+    list->dwCount = count;
+    if( IS_SUCCESS != is_GetCameraList(list) )
+    {
+        return false;
+    }
+
+    for( ULONG i = 0; i < list->dwCount; ++i )
+    {
+        if( serial == list->uci[i].SerNo )
+        {
+            deviceId = list->uci[i].dwDeviceID;
+            return true;
+        }
+    }
+    return false;
+}
+
+int UeyeBackend::close()
+{
+    if( 0 == handle )
+    {
+        return IS_INVALID_CAMERA_HANDLE;
+    }
+
+    INT status = is_ExitCamera(handle);
+    if( IS_SUCCESS == status )
+    {
+        handle = 0;
+    }
+    return status;
+}
+
+int UeyeBackend::getSensorInfo(SensorInfo& info)
+{
+    SENSORINFO data;
+    INT status = is_GetSensorInfo(handle, &data);
+    if( IS_SUCCESS != status )
+    {
+        return status;
+    }
+
+    info.name           = data.strSensorName;
+    info.color          = ( data.nColorMode != IS_COLORMODE_MONOCHROME );
+    info.maxWidth       = data.nMaxWidth;
+    info.maxHeight      = data.nMaxHeight;
+    info.masterGain     = data.bMasterGain;
+    info.globalShutter  = data.bGlobShutter;
+    info.pixelSize      = float(data.wPixelSize) * 0.01f;
+
+    // Only the top left pixel is reported, green is assumed to be followed by red
+    switch( data.nUpperLeftBayerPixel )
+    {
+    case BAYER_PIXEL_RED:
+        info.bayerPattern = BayerPattern::RGGB;
+        break;
+    case BAYER_PIXEL_BLUE:
+        info.bayerPattern = BayerPattern::BGGR;
+        break;
+    default:
+        info.bayerPattern = BayerPattern::GRBG;
+        break;
+    }
+    return status;
+}
+
+std::string UeyeBackend::getLastError()
+{
+    INT err;
+    IS_CHAR* errstr;
+    if( IS_SUCCESS == is_GetError(handle, &err, &errstr) )
+    {
+        return std::string(errstr);
+    }
+    return std::string("Error reading is_GetError");
+}
+
+INT UeyeBackend::colorMode(PixelFormat format)
+{
+    switch( format )
+    {
+    case PixelFormat::MONO8:
+        return IS_CM_MONO8;
+    case PixelFormat::MONO10:
+        return IS_CM_MONO10;
+    case PixelFormat::MONO12:
+        return IS_CM_MONO12;
+    case PixelFormat::MONO16:
+        return IS_CM_MONO16;
+    case PixelFormat::MONO10_PACKED:
+#ifdef IS_CM_MONO10_PACKED
+        return IS_CM_MONO10_PACKED;
+#else
+        break;
+#endif
+    case PixelFormat::MONO12_PACKED:
+#ifdef IS_CM_MONO12_PACKED
+        return IS_CM_MONO12_PACKED;
+#else
+        break;
+#endif
+    case PixelFormat::BAYER8:
+        return IS_CM_SENSOR_RAW8;
+    case PixelFormat::RGB8:
+    case PixelFormat::BGRA8:
+    case PixelFormat::YUYV:
+        // host side formats
+        break;
+    }
+    // not available in this SDK version or not a sensor format
+    return -1;
+}
+
+int UeyeBackend::setColorMode(PixelFormat format)
+{
+    INT mode = colorMode(format);
+    if( mode < 0 )
+    {
+        return IS_NOT_SUPPORTED;
+    }
+    return is_SetColorMode(handle, mode);
+}
+
+int UeyeBackend::setTriggerMode(TriggerMode mode)
+{
+    INT trigger;
+    switch( mode )
+    {
+    case TriggerMode::OFF:          trigger = IS_SET_TRIGGER_OFF;       break;
+    case TriggerMode::SOFTWARE:     trigger = IS_SET_TRIGGER_SOFTWARE;  break;
+    case TriggerMode::RISING_EDGE:  trigger = IS_SET_TRIGGER_LO_HI;     break;
+    case TriggerMode::FALLING_EDGE: trigger = IS_SET_TRIGGER_HI_LO;     break;
+    default:
+        return IS_INVALID_PARAMETER;
+    }
+
+    INT status = is_SetExternalTrigger(handle, trigger);
+    if( status == IS_SUCCESS )
+    {
+        triggerMode = mode;
+    }
+    return status;
+}
+
+int UeyeBackend::setAOI(size_t width, size_t height, size_t offsetX, size_t offsetY)
+{
+    IS_RECT rect;
+
+    rect.s32X       = offsetX;
+    rect.s32Y       = offsetY;
+    rect.s32Width   = width;
+    rect.s32Height  = height;
+
+    return is_AOI(handle, IS_AOI_IMAGE_SET_AOI, (void*)&rect, sizeof(rect));
+}
+
+int UeyeBackend::getImageSize(size_t& width, size_t& height)
+{
+    IS_SIZE_2D size;
+    INT status = is_AOI(handle, IS_AOI_IMAGE_GET_SIZE, (void*)&size, sizeof(size));
+    if( IS_SUCCESS == status )
+    {
+        width  = size.s32Width;
+        height = size.s32Height;
+    }
+    return status;
+}
+
+INT UeyeBackend::reductionMode(size_t horizontal, size_t vertical, bool subsampling)
+{
+    struct Factor
+    {
+        size_t factor;
+        INT binH, binV;
+        INT subH, subV;
+    };
+    static const Factor factors[] = {
+        {  2, IS_BINNING_2X_HORIZONTAL,  IS_BINNING_2X_VERTICAL,  IS_SUBSAMPLING_2X_HORIZONTAL,  IS_SUBSAMPLING_2X_VERTICAL },
+        {  3, IS_BINNING_3X_HORIZONTAL,  IS_BINNING_3X_VERTICAL,  IS_SUBSAMPLING_3X_HORIZONTAL,  IS_SUBSAMPLING_3X_VERTICAL },
+        {  4, IS_BINNING_4X_HORIZONTAL,  IS_BINNING_4X_VERTICAL,  IS_SUBSAMPLING_4X_HORIZONTAL,  IS_SUBSAMPLING_4X_VERTICAL },
+        {  5, IS_BINNING_5X_HORIZONTAL,  IS_BINNING_5X_VERTICAL,  IS_SUBSAMPLING_5X_HORIZONTAL,  IS_SUBSAMPLING_5X_VERTICAL },
+        {  6, IS_BINNING_6X_HORIZONTAL,  IS_BINNING_6X_VERTICAL,  IS_SUBSAMPLING_6X_HORIZONTAL,  IS_SUBSAMPLING_6X_VERTICAL },
+        {  8, IS_BINNING_8X_HORIZONTAL,  IS_BINNING_8X_VERTICAL,  IS_SUBSAMPLING_8X_HORIZONTAL,  IS_SUBSAMPLING_8X_VERTICAL },
+        { 16, IS_BINNING_16X_HORIZONTAL, IS_BINNING_16X_VERTICAL, IS_SUBSAMPLING_16X_HORIZONTAL, IS_SUBSAMPLING_16X_VERTICAL }
+    };
+
+    // IS_BINNING_DISABLE and IS_SUBSAMPLING_DISABLE are both 0
+    INT mode = 0;
+    bool foundH = horizontal == 1;
+    bool foundV = vertical == 1;
+    for( const Factor& f : factors )
+    {
+        if( f.factor == horizontal )
+        {
+            mode |= subsampling ? f.subH : f.binH;
+            foundH = true;
+        }
+        if( f.factor == vertical )
+        {
+            mode |= subsampling ? f.subV : f.binV;
+            foundV = true;
+        }
+    }
+    return foundH && foundV ? mode : -1;
+}
+
+int UeyeBackend::setBinning(size_t horizontal, size_t vertical)
+{
+    INT mode = reductionMode(horizontal, vertical, false);
+    if( mode < 0 )
+    {
+        return IS_INVALID_PARAMETER;
+    }
+    return is_SetBinning(handle, mode);
+}
+
+int UeyeBackend::setSubsampling(size_t horizontal, size_t vertical)
+{
+    INT mode = reductionMode(horizontal, vertical, true);
+    if( mode < 0 )
+    {
+        return IS_INVALID_PARAMETER;
+    }
+    return is_SetSubSampling(handle, mode);
+}
+
+int UeyeBackend::getFrameTimeRange(double& minTime, double& maxTime)
+{
+    double interval;
+    return is_GetFrameTimeRange(handle, &minTime, &maxTime, &interval);
+}
+
+int UeyeBackend::allocImageMem(size_t width, size_t height, size_t bitsPerPixel, char** ptr, int* id)
+{
+    return is_AllocImageMem(handle, width, height, bitsPerPixel, ptr, id);
+}
+
+int UeyeBackend::setAllocatedImageMem(size_t width, size_t height, size_t bitsPerPixel, char* ptr, int* id)
+{
+    return is_SetAllocatedImageMem(handle, width, height, bitsPerPixel, ptr, id);
+}
+
+int UeyeBackend::freeImageMem(char* ptr, int id)
+{
+    return is_FreeImageMem(handle, ptr, id);
+}
+
+int UeyeBackend::addToSequence(char* ptr, int id)
+{
+    return is_AddToSequence(handle, ptr, id);
+}
+
+int UeyeBackend::clearSequence()
+{
+    return is_ClearSequence(handle);
+}
+
+int UeyeBackend::getActSeqBuf(int* seqNum, char** ptr)
+{
+    return is_GetActSeqBuf(handle, seqNum, NULL, ptr);
+}
+
+int UeyeBackend::lockSeqBuf(char* ptr)
+{
+    return is_LockSeqBuf(handle, IS_IGNORE_PARAMETER, ptr);
+}
+
+int UeyeBackend::unlockSeqBuf(char* ptr)
+{
+    return is_UnlockSeqBuf(handle, IS_IGNORE_PARAMETER, ptr);
+}
+
+int UeyeBackend::copyImageMem(char* ptr, int id, char* dest)
+{
+    return is_CopyImageMem(handle, ptr, id, dest);
+}
+
+int UeyeBackend::getImageMemPitch(char* ptr, int id, size_t& pitch)
+{
+    INT x, y, bits, linePitch;
+    INT status = is_InquireImageMem(handle, ptr, id, &x, &y, &bits, &linePitch);
+    if( IS_SUCCESS == status )
+    {
+        pitch = linePitch;
+    }
+    return status;
+}
+
+int UeyeBackend::getImageInfo(int id, ImageInfo& info)
+{
+    UEYEIMAGEINFO data;
+    INT status = is_GetImageInfo(handle, id, &data, sizeof(data));
+    if( IS_SUCCESS != status )
+    {
+        return status;
+    }
+
+    info.frameNumber        = data.u64FrameNumber;
+    info.deviceTimestamp    = data.u64TimestampDevice / 10; // 0.1 us ticks
+    info.hostProcessTime    = data.dwHostProcessTime;
+    info.imageBuffers       = data.dwImageBuffers;
+    info.imageBuffersInUse  = data.dwImageBuffersInUse;
+    return status;
+}
+
+int UeyeBackend::saveParameters(const std::string& file)
+{
+    // the SDK takes wide character file names
+    std::wstring name(file.begin(), file.end());
+    return is_ParameterSet(handle, IS_PARAMETERSET_CMD_SAVE_FILE, (void*)name.c_str(), 0);
+}
+
+int UeyeBackend::loadParameters(const std::string& file)
+{
+    std::wstring name(file.begin(), file.end());
+    return is_ParameterSet(handle, IS_PARAMETERSET_CMD_LOAD_FILE, (void*)name.c_str(), 0);
+}
+
+int UeyeBackend::startCapture()
+{
+    if( triggerMode == TriggerMode::SOFTWARE )
+    {
+        // every frame is started by trigger()
+        return IS_SUCCESS;
+    }
+    // in the hardware trigger modes live capture waits for the edges
+    return is_CaptureVideo(handle, IS_DONT_WAIT);
+}
+
+int UeyeBackend::stopCapture()
+{
+    return is_StopLiveVideo(handle, 0);
+}
+
+int UeyeBackend::trigger()
+{
+    if( triggerMode == TriggerMode::SOFTWARE )
+    {
+        return is_FreezeVideo(handle, IS_DONT_WAIT);
+    }
+    if( triggerMode == TriggerMode::OFF )
+    {
+        return IS_NOT_SUPPORTED;
+    }
+    return is_ForceTrigger(handle);
+}
+
+int UeyeBackend::enableFrameEvent()
+{
+    return is_EnableEvent(handle, IS_SET_EVENT_FRAME);
+}
+
+int UeyeBackend::disableFrameEvent()
+{
+    return is_DisableEvent(handle, IS_SET_EVENT_FRAME);
+}
+
+int UeyeBackend::waitFrameEvent(int timeoutMs)
+{
+    return is_WaitEvent(handle, IS_SET_EVENT_FRAME, timeoutMs);
+}
+
+int UeyeBackend::getCaptureStatus(CaptureStatus& status)
+{
+    UEYE_CAPTURE_STATUS_INFO info;
+    INT ret = is_CaptureStatus(handle, IS_CAPTURE_STATUS_INFO_CMD_GET, (void*)&info, sizeof(info));
+    if( IS_SUCCESS != ret )
+    {
+        return ret;
+    }
+
+    status.total = info.dwCapStatusCnt_Total;
+    status.counters[CaptureStatus::API_NO_DEST_MEM]       = info.adwCapStatusCnt_Detail[IS_CAP_STATUS_API_NO_DEST_MEM];
+    status.counters[CaptureStatus::API_CONVERSION_FAILED] = info.adwCapStatusCnt_Detail[IS_CAP_STATUS_API_CONVERSION_FAILED];
+    status.counters[CaptureStatus::API_IMAGE_LOCKED]      = info.adwCapStatusCnt_Detail[IS_CAP_STATUS_API_IMAGE_LOCKED];
+    status.counters[CaptureStatus::DRV_OUT_OF_BUFFERS]    = info.adwCapStatusCnt_Detail[IS_CAP_STATUS_DRV_OUT_OF_BUFFERS];
+    status.counters[CaptureStatus::DRV_DEVICE_NOT_READY]  = info.adwCapStatusCnt_Detail[IS_CAP_STATUS_DRV_DEVICE_NOT_READY];
+    status.counters[CaptureStatus::USB_TRANSFER_FAILED]   = info.adwCapStatusCnt_Detail[IS_CAP_STATUS_USB_TRANSFER_FAILED];
+    status.counters[CaptureStatus::DEV_TIMEOUT]           = info.adwCapStatusCnt_Detail[IS_CAP_STATUS_DEV_TIMEOUT];
+    status.counters[CaptureStatus::ETH_BUFFER_OVERRUN]    = info.adwCapStatusCnt_Detail[IS_CAP_STATUS_ETH_BUFFER_OVERRUN];
+    status.counters[CaptureStatus::ETH_MISSED_IMAGES]     = info.adwCapStatusCnt_Detail[IS_CAP_STATUS_ETH_MISSED_IMAGES];
+    return ret;
+}
+
+int UeyeBackend::resetCaptureStatus()
+{
+    return is_CaptureStatus(handle, IS_CAPTURE_STATUS_INFO_CMD_RESET, NULL, 0);
+}
+
+int UeyeBackend::setPixelClock(unsigned int clock)
+{
+    return is_PixelClock(handle, IS_PIXELCLOCK_CMD_SET, (void*)&clock, sizeof(clock));
+}
+
+int UeyeBackend::getPixelClock(unsigned int& clock)
+{
+    UINT value = 0;
+    INT status = is_PixelClock(handle, IS_PIXELCLOCK_CMD_GET, (void*)&value, sizeof(value));
+    if( IS_SUCCESS == status )
+    {
+        clock = value;
+    }
+    return status;
+}
+
+int UeyeBackend::setFrameRate(double fps, double& actual)
+{
+    return is_SetFrameRate(handle, fps, &actual);
+}
+
+int UeyeBackend::getFrameRate(double& fps)
+{
+    return is_SetFrameRate(handle, IS_GET_FRAMERATE, &fps);
+}
+
+int UeyeBackend::setExposure(double& exposure)
+{
+    return is_Exposure(handle, IS_EXPOSURE_CMD_SET_EXPOSURE, (void*)&exposure, sizeof(exposure));
+}
+
+int UeyeBackend::getExposure(double& exposure)
+{
+    return is_Exposure(handle, IS_EXPOSURE_CMD_GET_EXPOSURE, (void*)&exposure, sizeof(exposure));
+}
+
+int UeyeBackend::setHardwareGamma(bool enable)
+{
+    return is_SetHardwareGamma(handle, enable ? IS_SET_HW_GAMMA_ON : IS_SET_HW_GAMMA_OFF);
+}
+
+int UeyeBackend::setGamma(int gamma)
+{
+    INT value = gamma;
+    return is_Gamma(handle, IS_GAMMA_CMD_SET, (void*)&value, sizeof(value));
+}
+
+int UeyeBackend::setGainBoost(bool enable)
+{
+    return is_SetGainBoost(handle, enable ? IS_SET_GAINBOOST_ON : IS_SET_GAINBOOST_OFF);
+}
+
+int UeyeBackend::setAutoGain()
+{
+    return setGain( IS_SET_ENABLE_AUTO_GAIN );
+}
+
+int UeyeBackend::setGain(int value)
+{
+    return is_SetHardwareGain(handle, value, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER);
+}
+
+int UeyeBackend::setGlobalShutter(bool enable)
+{
+    return is_SetGlobalShutter(handle, enable ? IS_SET_GLOBAL_SHUTTER_ON : IS_SET_GLOBAL_SHUTTER_OFF);
+}
+
+int UeyeBackend::setBlacklevelMode(bool autolevel)
+{
+    INT mode = autolevel ? IS_AUTO_BLACKLEVEL_ON : IS_AUTO_BLACKLEVEL_OFF;
+    return is_Blacklevel(handle, IS_BLACKLEVEL_CMD_SET_MODE, (void*)&mode, sizeof(mode));
+}
+
+int UeyeBackend::setBlacklevelOffset(int offset)
+{
+    INT value = offset;
+    return is_Blacklevel(handle, IS_BLACKLEVEL_CMD_SET_OFFSET, (void*)&value, sizeof(value));
+}
+
+int UeyeBackend::setEdgeEnhancement(int level)
+{
+    INT value = level;
+    return is_EdgeEnhancement(handle, IS_EDGE_ENHANCEMENT_CMD_SET, (void*)&value, sizeof(value));
+}
+
+int UeyeBackend::setHDR(bool enable)
+{
+    return is_EnableHdr(handle, enable ? IS_ENABLE_HDR : IS_DISABLE_HDR);
+}
+
+int UeyeBackend::setHDRKneepoints( const std::vector< std::pair<double, double> >& kneepoints )
+{
+    KNEEPOINTARRAY array;
+
+    // Fill KNEEPOINTARRAY (caller limits the number of points)
+    INT numPoints = kneepoints.size();
+    array.NumberOfUsedKneepoints = numPoints;
+    for( INT i = 0; i < numPoints; i++ )
+    {
+        KNEEPOINT& k = array.Kneepoint[i];
+        k.x = kneepoints[i].first;
+        k.y = kneepoints[i].second;
+    }
+
+    return is_SetHdrKneepoints(handle, &array, numPoints);
+}
+
+}
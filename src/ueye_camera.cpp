@@ -1,335 +1,1841 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include "ueye_camera.h"
 #include "lms/time.h"
 
-#define CHECK_STATUS(NAME) if( IS_SUCCESS != status ) { logger.error(NAME) << getError()<< " code: "<<getErrorCode(); }
+#define CHECK_STATUS(NAME) if( BACKEND_SUCCESS != status ) { logger.error(NAME) << getError()<< " code: "<<getErrorCode(); }
 
 namespace lms_ueye_importer
 {
 
-std::unordered_map<INT, std::string> UeyeCamera::errorCodes;
+std::unordered_map<int, std::string> UeyeCamera::errorCodes;
+
+// odr-used by the log messages
+const size_t BufferTable::MAX_BUFFERS;
+
+namespace
+{
+typedef std::chrono::steady_clock LatencyClock;
+
+uint64_t nanosSince(LatencyClock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( LatencyClock::now() - start ).count();
+}
+}
 
-UeyeCamera::UeyeCamera(lms::logging::Logger &logger)  :
+UeyeCamera::UeyeCamera(lms::logging::Logger &logger, CameraBackend* backend)  :
     logger(logger),
-    handle(0),
-    status(IS_SUCCESS),
-    format(IS_CM_MONO8),
+    backend(backend),
+    opened(false),
+    status(BACKEND_SUCCESS),
+    format(PixelFormat::MONO8),
+    triggerMode(TriggerMode::OFF),
+    deliveryMode(DeliveryMode::LATEST),
     width(0),
     height(0),
+    offsetX(0),
+    offsetY(0),
     numBuffers(8),
+    minFreeBuffers(1),
+    pitch(0),
+    arenaEnabled(false),
+    arenaLock(false),
     initialized(false),
-    capturing(false)
+    capturing(false),
+    lastBlackout(0),
+    lentBuffers(0),
+    acquiring(false),
+    ringOverflows(0),
+    maxQueued(0),
+    queuedIndex(-1),
+    queuedFrameNumber(0),
+    consumerWaiting(false),
+    monitoring(false),
+    monitorInterval(1000),
+    maxBuffers(0),
+    requestedBuffers(0),
+    parametersValid(false),
+    timingValid(false),
+    actualPixelClock(0),
+    actualFrameRate(0.0),
+    actualExposure(0.0),
+    actualGain(0),
+    settingsDelay(2),
+    latestFrameNumber(0),
+    lastTrigger(0),
+    deliveredFrames(0),
+    recorder(NULL),
+    statisticsEnabled(false),
+    histogramStep(8),
+    toneMapping(1.0),
+    conversionTime(0),
+    convertedPixels(0),
+    colorOutput(PixelFormat::RGB8),
+    demosaicThreads(1),
+    bayerPattern(BayerPattern::RGGB),
+    bayerPatternOverride(false)
+{
+    initErrorCodes();
+}
+
+UeyeCamera::~UeyeCamera()
+{
+    close();
+}
+
+bool UeyeCamera::open(uint32_t deviceId, const std::string& serial)
+{
+    status = backend->open(deviceId, serial);
+    CHECK_STATUS("InitCamera")
+    opened = ( BACKEND_SUCCESS == status );
+
+    // nothing is known about a freshly opened device
+    parametersValid = false;
+    return opened;
+}
+
+bool UeyeCamera::close()
+{
+    if( !opened )
+    {
+        // not opened
+        return false;
+    }
+
+    deinit();
+    
+    status = backend->close();
+    CHECK_STATUS("ExitCamera")
+    if( BACKEND_SUCCESS == status )
+    {
+        opened = false;
+        return true;
+    }
+    return false;
+}
+
+bool UeyeCamera::init()
+{
+    if( initialized )
+    {
+        logger.warn("init") << "Already initialized";
+        return false;
+    }
+    
+    if( !opened )
+    {
+        // Camera not opened yet
+        logger.error("init") << "Camera not yet opened";
+        return false;
+    }
+    
+    initParameters();
+
+    for( auto& histogram : latency )
+    {
+        histogram.reset();
+    }
+    
+    // Read back actual image size, the sensor may have rounded the AOI
+    // and binning / subsampling shrink it
+    if(BACKEND_SUCCESS != backend->getImageSize(width, height))
+    {
+        logger.error() << "Error reading image size and format from camera";
+        return false;
+    }
+    logger.debug("init") << "Image size " << width << "x" << height;
+
+    // Initialize buffers, the lease limit counts the ones that exist
+    size_t allocated = allocateMemory(buffers, numBuffers, width, height, pitch, true);
+    if( allocated != numBuffers )
+    {
+        logger.error("init") << "Could not allocate " << numBuffers << " buffers, got " << allocated;
+        if( allocated == 0 )
+        {
+            freeBuffers(buffers);
+            return false;
+        }
+        numBuffers = allocated;
+    }
+    requestedBuffers = numBuffers;
+    
+    // Reset capture status
+    status = backend->resetCaptureStatus();
+    CHECK_STATUS("ResetCaptureStatus")
+
+    captureStatistics = CaptureStatistics();
+    captureStatistics.numBuffers = numBuffers;
+    frameInfo = FrameInfo();
+    deliveredFrames = 0;
+
+    converter.configure(format, toneMapping);
+    conversionTime = 0;
+    convertedPixels = 0;
+
+    if( PixelFormat::BAYER8 == format && PixelFormat::BAYER8 != colorOutput )
+    {
+        SensorInfo sensor;
+        if( !bayerPatternOverride && BACKEND_SUCCESS == backend->getSensorInfo(sensor) )
+        {
+            bayerPattern = sensor.bayerPattern;
+            if( !sensor.color )
+            {
+                logger.warn("init") << "Sensor reports no color filter, demosaicing anyway";
+            }
+        }
+        demosaic.configure(bayerPattern, colorOutput, demosaicThreads);
+    }
+    prepareTransform();
+
+    initialized = true;
+    return true;
+}
+
+size_t UeyeCamera::allocateMemory( BufferTable& table, size_t count, size_t width, size_t height, size_t& pitch, bool sequence )
+{
+    ImageArena* arena = createArena(table, count, width, height);
+    size_t added = 0;
+    for( ; added < count && table.size() < BufferTable::MAX_BUFFERS; ++added )
+    {
+        char* ptr;
+        int id;
+        status = allocImageMem(arena, width, height, &ptr, &id);
+        CHECK_STATUS("AllocImageMem")
+        if( BACKEND_SUCCESS != status )
+        {
+            break;
+        }
+
+        if( sequence )
+        {
+            status = backend->addToSequence(ptr, id);
+            CHECK_STATUS("AddToSequence")
+            if( BACKEND_SUCCESS != status )
+            {
+                backend->freeImageMem(ptr, id);
+                break;
+            }
+        }
+
+        status = backend->getImageMemPitch(ptr, id, pitch);
+        CHECK_STATUS("InquireImageMem")
+
+        // save reference to new buffer
+        table.add(ptr, id);
+    }
+    return added;
+}
+
+ImageArena* UeyeCamera::createArena( BufferTable& table, size_t count, size_t width, size_t height )
+{
+    if( !arenaEnabled || count == 0 )
+    {
+        return NULL;
+    }
+
+    std::unique_ptr<ImageArena> arena( new ImageArena() );
+    const size_t size = count * ImageArena::bufferSize(format, width, height);
+    if( !arena->allocate(size, true, arenaLock) )
+    {
+        logger.warn("createArena") << "Could not map " << size << " bytes, the driver allocates the buffers";
+        return NULL;
+    }
+    if( arenaLock && !arena->isLocked() )
+    {
+        logger.warn("createArena") << "Could not lock " << size << " bytes of buffers, check RLIMIT_MEMLOCK";
+    }
+    logger.debug("createArena") << count << " buffers in " << arena->getSize() << " bytes of "
+        << ImageArena::name(arena->getPages()) << " pages" << ( arena->isLocked() ? ", locked" : "" );
+
+    ImageArena* result = arena.get();
+    table.addArena(std::move(arena));
+    return result;
+}
+
+int UeyeCamera::allocImageMem( ImageArena* arena, size_t width, size_t height, char** ptr, int* id )
+{
+    if( NULL == arena )
+    {
+        return backend->allocImageMem(width, height, bitsPerPixel(format), ptr, id);
+    }
+
+    char* mem = arena->carve(ImageArena::bufferSize(format, width, height));
+    if( NULL == mem )
+    {
+        return BACKEND_OUT_OF_MEMORY;
+    }
+
+    // the driver writes the rows with the pitch of the padded width
+    int ret = backend->setAllocatedImageMem(ImageArena::paddedWidth(format, width), height, bitsPerPixel(format), mem, id);
+    if( BACKEND_SUCCESS == ret )
+    {
+        *ptr = mem;
+    }
+    return ret;
+}
+
+bool UeyeCamera::addToSequence( BufferTable& table )
+{
+    // sequence numbers follow the table order
+    for( auto& buf : table )
+    {
+        status = backend->addToSequence(buf.ptr, buf.id);
+        CHECK_STATUS("AddToSequence")
+        if( BACKEND_SUCCESS != status )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void UeyeCamera::freeBuffers( BufferTable& table )
+{
+    for( auto& buf : table )
+    {
+        status = backend->freeImageMem(buf.ptr, buf.id);
+        CHECK_STATUS("FreeImageMem")
+    }
+    table.clear();
+}
+
+bool UeyeCamera::freeRetiredBuffers()
+{
+    for( auto& buf : retiredBuffers )
+    {
+        if( buf.lent )
+        {
+            return false;
+        }
+    }
+    freeBuffers(retiredBuffers);
+    return true;
+}
+
+bool UeyeCamera::deinit()
+{
+    if( !initialized )
+    {
+        return false;
+    }
+    
+    // Stop capture
+    stop();
+    
+    // print capture status
+    logCaptureStatus();
+    logLatency();
+
+    // Leases point into the sequence buffers and call back into the camera,
+    // so every one of them has to be dropped before the buffers are freed
+    {
+        std::unique_lock<std::mutex> lock(leaseMutex);
+        if( !leaseReleased.wait_for(lock, std::chrono::seconds(1), [this] { return 0 == lentBuffers; }) )
+        {
+            logger.warn("deinit") << "Waiting for " << lentBuffers << " lent buffers to be released";
+            leaseReleased.wait(lock, [this] { return 0 == lentBuffers; });
+        }
+    }
+    copyBuffer.reset();
+    wideBuffer.reset();
+
+    if( convertedPixels > 0 )
+    {
+        logger.info("deinit") << "Pixel conversion: " << getConversionCost() << " ms/MP";
+    }
+    
+    // Clear buffers
+    status = backend->clearSequence();
+    CHECK_STATUS("ClearSequence")
+
+    // Dealloc buffers
+    for( auto& buf : buffers )
+    {
+        logger.debug("deinit") << "Buffer " << buf.id
+            << " delivered: " << buf.delivered
+            << " copied: " << buf.copies
+            << " lent: " << buf.lends;
+    }
+    freeBuffers(buffers);
+    freeBuffers(retiredBuffers);
+    
+    // Disable events
+    status = backend->disableFrameEvent();
+    CHECK_STATUS("DisableFrameEvent")
+
+    initialized = false;
+    
+    return true;
+}
+
+void UeyeCamera::initParameters()
+{
+    status = backend->setColorMode(format);
+    CHECK_STATUS("SetColorMode")
+
+    status = backend->setTriggerMode(triggerMode);
+    CHECK_STATUS("SetExternalTrigger")
+}
+
+bool UeyeCamera::start()
+{
+    // Settings made while stopped apply from the first frame on, the frame
+    // counter may restart with the capture
+    latestFrameNumber = 0;
+    lastTrigger = 0;
+    settingsHistory.clear();
+    noteSettings();
+
+    status = backend->startCapture();
+    CHECK_STATUS("CaptureVideo")
+    if( BACKEND_SUCCESS != status )
+    {
+        return false;
+    }
+    
+    status = backend->enableFrameEvent();
+    CHECK_STATUS("EnableFrameEvent")
+    if( BACKEND_SUCCESS != status )
+    {
+        // stop() only stops a capture that completely started
+        backend->stopCapture();
+        return false;
+    }
+    
+    capturing = true;
+
+    // Start frame event-listener thread
+    frameRing.clear();
+    maxQueued = 0;
+    queuedIndex = -1;
+    queuedFrameNumber = 0;
+    acquiring = true;
+    acquisitionThread = std::thread(&UeyeCamera::acquire, this);
+
+    // Start capture error handler thread
+    if( monitorInterval > 0 )
+    {
+        monitoring = true;
+        monitorThread = std::thread(&UeyeCamera::monitor, this);
+    }
+    
+    return true;
+}
+
+bool UeyeCamera::trigger()
+{
+    if( !capturing || triggerMode == TriggerMode::OFF )
+    {
+        logger.error("trigger") << "camera is not capturing in a trigger mode";
+        return false;
+    }
+
+    // Late frames of earlier triggers, all of them are delivered in FIFO mode
+    if( DeliveryMode::LATEST == deliveryMode )
+    {
+        FrameEvent stale;
+        frameRing.popLatest(stale);
+    }
+
+    if( triggerMode == TriggerMode::SOFTWARE )
+    {
+        lastTrigger.store(lms::Time::now().micros(), std::memory_order_relaxed);
+    }
+    status = backend->trigger();
+    CHECK_STATUS("Trigger")
+    return BACKEND_SUCCESS == status;
+}
+
+bool UeyeCamera::stop()
+{
+    if( !capturing )
+    {
+        return false;
+    }
+
+    // Stop capture error handler thread
+    {
+        std::lock_guard<std::mutex> lock(monitorMutex);
+        monitoring = false;
+    }
+    monitorCondition.notify_all();
+    if( monitorThread.joinable() )
+    {
+        monitorThread.join();
+    }
+
+    // Stop frame event-listener thread
+    acquiring = false;
+    wakeup.notify_all();
+    if( acquisitionThread.joinable() )
+    {
+        acquisitionThread.join();
+    }
+    releaseQueued();
+    
+    status = backend->stopCapture();
+    CHECK_STATUS("StopLiveVideo")
+
+    if( BACKEND_SUCCESS != status )
+    {
+        return false;
+    }
+    
+    capturing = false;
+    return true;
+}
+
+bool UeyeCamera::setNumBuffers( size_t num )
+{
+    if(initialized)
+    {
+        logger.error("setNumBuffers") << "cannot set number of buffers after initilization";
+        return false;
+    }
+    
+    if( num == 0 )
+    {
+        logger.error("setNumBuffers") << "number of buffers must be greater than zero";
+        return false;
+    }
+
+    if( num > BufferTable::MAX_BUFFERS )
+    {
+        logger.error("setNumBuffers") << "number of buffers is limited to " << BufferTable::MAX_BUFFERS;
+        return false;
+    }
+    
+    numBuffers = num;
+    
+    return true;
+}
+
+bool UeyeCamera::captureImage( lms::imaging::Image& image, Frame* wide, const std::vector<lms::imaging::Image*>* levels )
+{
+    if( retiredBuffers.size() > 0 )
+    {
+        freeRetiredBuffers();
+    }
+
+    // We always want the latest fully captured image
+    FrameEvent event;
+    if( !nextFrame(event) )
+    {
+        return false;
+    }
+    BufferDescriptor* buf = event.buffer;
+    imageStatistics.reset();
+
+    // The recorder keeps the buffer locked until the frame is written
+    Frame recorded;
+    if( NULL != recorder )
+    {
+        lendBuffer(buf, recorded);
+    }
+
+    // A lent or queued buffer is already locked by us and won't be overwritten
+    bool lent = buf->lent;
+    if( !lent && !buf->queued )
+    {
+        LatencyClock::time_point lockStart = LatencyClock::now();
+        status = backend->lockSeqBuf(buf->ptr);
+        recordLatency(LatencyStatistics::LOCK, nanosSince(lockStart));
+#ifdef UEYE_DEBUG
+        CHECK_STATUS("LockSeqBuf")
+#endif
+    }
+
+    LatencyClock::time_point copyStart = LatencyClock::now();
+    const bool buildLevels = ( NULL != levels && pyramid.getLevels() > 0 && PixelFormat::MONO8 == getOutputFormat() );
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(buf->ptr);
+    if( getOutputFormat() == format && NULL == wide && !buildLevels )
+    {
+        if( transform.isActive() )
+        {
+            // crop, flip and lookup table in the copy itself
+            transform.process(src, pitch, image.data(), rowBytes(format, transform.getWidth()));
+            if( statisticsEnabled )
+            {
+                gatherStatistics(image.data(), transform.getWidth(), NULL, 0, transform.getWidth(), transform.getHeight());
+            }
+        }
+        else if( statisticsEnabled && 8 == bitsPerPixel(format) )
+        {
+            // copy and measure in one pass
+            gatherStatistics(src, pitch, image.data(), width, width, height);
+        }
+        else if( pitch != rowBytes(format, width) )
+        {
+            // padded rows of arena buffers
+            const size_t length = rowBytes(format, width);
+            for( size_t y = 0; y < height; ++y )
+            {
+                std::memcpy(image.data() + y * length, src + y * pitch, length);
+            }
+        }
+        else
+        {
+            status = backend->copyImageMem(buf->ptr, buf->id, (char*)image.data());
+#ifdef UEYE_DEBUG
+            CHECK_STATUS("CopyImageMem")
+#endif
+        }
+    }
+    else
+    {
+        convertFrame(buf, image, wide, buildLevels ? levels : NULL);
+        if( statisticsEnabled )
+        {
+            // the grey output while it is still cached, color output by its mosaic
+            if( PixelFormat::MONO8 == getOutputFormat() )
+            {
+                gatherStatistics(image.data(), getOutputWidth(), NULL, 0, getOutputWidth(), getOutputHeight());
+            }
+            else if( PixelFormat::BAYER8 == format )
+            {
+                gatherStatistics(src, pitch, NULL, 0, width, height);
+            }
+        }
+    }
+    recordLatency(LatencyStatistics::COPY, nanosSince(copyStart));
+    buf->copies++;
+
+    if( !lent )
+    {
+        // under the FIFO scan lock, see releaseBuffer
+        std::lock_guard<std::mutex> lock(leaseMutex);
+        status = backend->unlockSeqBuf(buf->ptr);
+#ifdef UEYE_DEBUG
+        CHECK_STATUS("UnlockSeqBuf")
+#endif
+        buf->queued = false;
+    }
+
+    if( NULL != recorder )
+    {
+        recorder->push(recorded, frameInfo);
+    }
+
+    return true;
+}
+
+void UeyeCamera::convertFrame( BufferDescriptor* buf, lms::imaging::Image& image, Frame* wide, const std::vector<lms::imaging::Image*>* levels )
+{
+    lms::Time begin = lms::Time::now();
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(buf->ptr);
+    const size_t outputWidth = getOutputWidth();
+    const size_t outputHeight = getOutputHeight();
+
+    if( PixelFormat::BAYER8 == format && PixelFormat::BAYER8 != colorOutput )
+    {
+        if( transform.isActive() )
+        {
+            // the demosaic needs the neighbouring rows, transform its output
+            const size_t stride = rowBytes(colorOutput, width);
+            transformBuffer.resize(stride * height);
+            demosaic.process(src, pitch, transformBuffer.data(), stride, width, height);
+            transform.process(transformBuffer.data(), stride, image.data(), rowBytes(colorOutput, outputWidth));
+        }
+        else
+        {
+            demosaic.process(src, pitch, image.data(), rowBytes(colorOutput, width), width, height);
+        }
+    }
+    else if( transform.isActive() && 8 == bitsPerPixel(format) )
+    {
+        transform.process(src, pitch, image.data(), outputWidth);
+    }
+    else if( transform.isActive() )
+    {
+        // convert only the published rows, each into a cache-resident row
+        transformBuffer.resize(width);
+        for( size_t y = 0; y < outputHeight; ++y )
+        {
+            converter.to8(src + transform.sourceRow(y) * pitch, pitch, transformBuffer.data(), width, width, 1);
+            transform.processRow(transformBuffer.data(), image.data() + y * outputWidth);
+        }
+    }
+    else if( PixelFormat::MONO8 == format && NULL != levels )
+    {
+        // copy and downscale in one pass over the sequence buffer
+        pyramid.process(src, pitch, image.data(), width, height, pyramidBuffers(*levels));
+        levels = NULL;
+    }
+    else
+    {
+        converter.to8(src, pitch, image.data(), width, width, height);
+    }
+
+    if( NULL != levels )
+    {
+        pyramid.process(image.data(), outputWidth, NULL, outputWidth, outputHeight, pyramidBuffers(*levels));
+    }
+
+    if( NULL != wide && significantBits(format) > 8 )
+    {
+        const size_t size = width * height;
+        if( !wideBuffer || wideBuffer.use_count() > 1 || wideBuffer->size() != size )
+        {
+            // previous frame is still referenced by a consumer
+            wideBuffer = std::make_shared< std::vector<uint16_t> >( size );
+        }
+        converter.to16(src, pitch, wideBuffer->data(), width * sizeof(uint16_t), width, height);
+
+        // packed formats are unpacked into 16 bit words
+        PixelFormat wideFormat = format;
+        if( PixelFormat::MONO10_PACKED == format )
+        {
+            wideFormat = PixelFormat::MONO10;
+        }
+        else if( PixelFormat::MONO12_PACKED == format )
+        {
+            wideFormat = PixelFormat::MONO12;
+        }
+
+        wide->data      = reinterpret_cast<const uint8_t*>(wideBuffer->data());
+        wide->width     = width;
+        wide->height    = height;
+        wide->stride    = width * sizeof(uint16_t);
+        wide->format    = wideFormat;
+        wide->zeroCopy  = false;
+        wide->lease     = wideBuffer;
+    }
+
+    conversionTime += lms::Time::since(begin).micros();
+    convertedPixels += width * height;
+}
+
+bool UeyeCamera::buildPyramid( const Frame& frame, const std::vector<lms::imaging::Image*>& levels )
+{
+    if( !frame.valid() || PixelFormat::MONO8 != frame.format || pyramid.getLevels() == 0 )
+    {
+        return false;
+    }
+
+    pyramid.process(frame.data, frame.stride, NULL, frame.width, frame.height, pyramidBuffers(levels));
+    return true;
+}
+
+uint8_t* const* UeyeCamera::pyramidBuffers( const std::vector<lms::imaging::Image*>& levels )
+{
+    levelBuffers.resize(pyramid.getLevels());
+    for( size_t i = 0; i < levelBuffers.size(); ++i )
+    {
+        levelBuffers[i] = levels.at(i)->data();
+    }
+    return levelBuffers.data();
+}
+
+void UeyeCamera::setImageStatistics( bool enable, uint8_t saturationLevel, size_t histogramStep )
+{
+    statisticsEnabled = enable;
+    this->histogramStep = histogramStep;
+    imageStatistics.saturationLevel = saturationLevel;
+    imageStatistics.reset();
+}
+
+void UeyeCamera::gatherStatistics( const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, size_t width, size_t height )
+{
+    ImageStatistics& stats = imageStatistics;
+    stats.reset();
+    stats.frameNumber = frameInfo.frameNumber;
+
+    if( 1 == histogramStep && srcStride == width && ( NULL == dst || dstStride == width ) )
+    {
+        // contiguous rows are one long run
+        kernels::copyStatistics(src, dst, width * height, stats, true);
+    }
+    else
+    {
+        for( size_t y = 0; y < height; ++y )
+        {
+            const bool histogram = ( histogramStep > 0 && 0 == y % histogramStep );
+            kernels::copyStatistics(src + y * srcStride, NULL != dst ? dst + y * dstStride : NULL, width, stats, histogram);
+        }
+    }
+
+    stats.pixels = uint64_t(width) * height;
+    stats.mean = stats.pixels > 0 ? double(stats.sum) / stats.pixels : 0.0;
+}
+
+double UeyeCamera::getConversionCost()
+{
+    if( convertedPixels == 0 )
+    {
+        return 0.0;
+    }
+    // us per pixel * 1e6 pixels per MP / 1e3 us per ms
+    return double(conversionTime) / double(convertedPixels) * 1e3;
+}
+
+bool UeyeCamera::captureFrame( Frame& frame )
+{
+    // Release the frame of the previous cycle
+    frame = Frame();
+
+    if( retiredBuffers.size() > 0 )
+    {
+        freeRetiredBuffers();
+    }
+
+    FrameEvent event;
+    if( !nextFrame(event) )
+    {
+        return false;
+    }
+    BufferDescriptor* buf = event.buffer;
+
+    // All buffers held (or buffer not lockable): fall back to copying
+    bool success = lendBuffer(buf, frame) || copyFrame(buf, frame);
+
+    imageStatistics.reset();
+    if( statisticsEnabled && frame.valid() && 8 == bitsPerPixel(frame.format) )
+    {
+        gatherStatistics(frame.data, frame.stride, NULL, 0, frame.width, frame.height);
+    }
+
+    if( NULL != recorder )
+    {
+        recorder->push(frame, frameInfo);
+    }
+    return success;
+}
+
+bool UeyeCamera::lendBuffer( BufferDescriptor* buf, Frame& frame )
+{
+    if( buf->lent || lentBuffers + minFreeBuffers >= numBuffers )
+    {
+        return false;
+    }
+
+    if( !buf->queued )
+    {
+        LatencyClock::time_point lockStart = LatencyClock::now();
+        status = backend->lockSeqBuf(buf->ptr);
+        recordLatency(LatencyStatistics::LOCK, nanosSince(lockStart));
+#ifdef UEYE_DEBUG
+        CHECK_STATUS("LockSeqBuf")
+#endif
+        if( BACKEND_SUCCESS != status )
+        {
+            return false;
+        }
+    }
+
+    // A queued buffer hands its lock over to the lease. lent is set first,
+    // so the acquisition thread never sees the buffer unlocked.
+    buf->lent = true;
+    buf->queued = false;
+    buf->lends++;
+    lentBuffers++;
+
+    frame.data      = reinterpret_cast<const uint8_t*>(buf->ptr);
+    frame.width     = width;
+    frame.height    = height;
+    frame.stride    = pitch;
+    frame.format    = format;
+    frame.zeroCopy  = true;
+    frame.lease     = std::shared_ptr<const void>(buf->ptr, [this, buf](const void*) {
+        releaseBuffer(buf);
+    });
+    return true;
+}
+
+void UeyeCamera::releaseBuffer( BufferDescriptor* buf )
+{
+    // May be called from any consumer thread, so don't touch status here.
+    // Unlocking and clearing lent happen under the lock queueFrames scans
+    // with, otherwise a frame the driver writes into the buffer right after
+    // the unlock could be skipped as still lent. deinit may destroy the
+    // camera right after the notification, so that happens under it too.
+    std::lock_guard<std::mutex> lock(leaseMutex);
+    if( BACKEND_SUCCESS != backend->unlockSeqBuf(buf->ptr) )
+    {
+        logger.warn("releaseBuffer") << "Could not unlock sequence buffer " << buf->id;
+    }
+    buf->lent = false;
+    lentBuffers--;
+    leaseReleased.notify_all();
+}
+
+bool UeyeCamera::copyFrame( BufferDescriptor* buf, Frame& frame )
+{
+    const size_t size = pitch * height;
+    if( !copyBuffer || copyBuffer.use_count() > 1 || copyBuffer->size() != size )
+    {
+        // previous copy is still referenced by a consumer
+        copyBuffer = std::make_shared< std::vector<uint8_t> >( size );
+    }
+
+    // A lent or queued buffer is already locked and its content is stable
+    bool locked = buf->queued;
+    if( !buf->lent && !locked )
+    {
+        LatencyClock::time_point lockStart = LatencyClock::now();
+        locked = ( BACKEND_SUCCESS == backend->lockSeqBuf(buf->ptr) );
+        recordLatency(LatencyStatistics::LOCK, nanosSince(lockStart));
+    }
+
+    LatencyClock::time_point copyStart = LatencyClock::now();
+    status = backend->copyImageMem(buf->ptr, buf->id, reinterpret_cast<char*>(copyBuffer->data()));
+    recordLatency(LatencyStatistics::COPY, nanosSince(copyStart));
+#ifdef UEYE_DEBUG
+    CHECK_STATUS("CopyImageMem")
+#endif
+    buf->copies++;
+
+    if( locked )
+    {
+        // under the FIFO scan lock, see releaseBuffer
+        std::lock_guard<std::mutex> lock(leaseMutex);
+        backend->unlockSeqBuf(buf->ptr);
+        buf->queued = false;
+    }
+
+    frame.data      = copyBuffer->data();
+    frame.width     = width;
+    frame.height    = height;
+    frame.stride    = pitch;
+    frame.format    = format;
+    frame.zeroCopy  = false;
+    frame.lease     = copyBuffer;
+    return ( BACKEND_SUCCESS == status );
+}
+
+bool UeyeCamera::waitForFrame(float timeOut)
+{
+    if( !frameRing.empty() )
+    {
+        recordLatency(LatencyStatistics::WAIT, 0);
+        return true;
+    }
+
+    LatencyClock::time_point waitStart = LatencyClock::now();
+    std::unique_lock<std::mutex> lock(wakeupMutex);
+    consumerWaiting = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto ready = [this]{ return !frameRing.empty() || !acquiring; };
+    if( std::isinf(timeOut) )
+    {
+        wakeup.wait(lock, ready);
+    }
+    else
+    {
+        wakeup.wait_for(lock, std::chrono::duration<float, std::milli>(timeOut), ready);
+    }
+    consumerWaiting = false;
+
+    // timeouts are not a latency of the capture path
+    if( frameRing.empty() )
+    {
+        return false;
+    }
+    recordLatency(LatencyStatistics::WAIT, nanosSince(waitStart));
+    return true;
+}
+
+bool UeyeCamera::nextFrame( FrameEvent& event )
+{
+    size_t consumed = 0;
+    if( DeliveryMode::FIFO == deliveryMode )
+    {
+        consumed = frameRing.pop(event) ? 1 : 0;
+    }
+    else
+    {
+        consumed = frameRing.popLatest(event);
+    }
+    if( consumed == 0 )
+    {
+        return false;
+    }
+    event.buffer->delivered++;
+    updateFrameInfo(event, consumed);
+    frameInfo.queued = frameRing.size();
+
+    recordLatency(LatencyStatistics::QUEUE, std::max<int64_t>(0, lms::Time::now().micros() - event.timestamp) * 1000);
+    recordLatency(LatencyStatistics::TRANSFER, uint64_t(frameInfo.transferTime) * 1000);
+    return true;
+}
+
+void UeyeCamera::updateFrameInfo( const FrameEvent& event, size_t consumed )
+{
+    FrameInfo previous = frameInfo;
+    FrameInfo& info = frameInfo;
+
+    info.frameNumber        = event.info.frameNumber;
+    info.seqNum             = event.seqNum;
+    info.bufferId           = event.buffer->id;
+    info.deviceTimestamp    = event.info.deviceTimestamp;
+    info.eventTimestamp     = event.timestamp;
+    info.triggerTimestamp   = event.trigger;
+    info.publishTimestamp   = 0;
+    info.transferTime       = event.info.hostProcessTime;
+    info.buffersInUse       = event.info.imageBuffersInUse;
+    info.age                = 0;
+
+    if( deliveredFrames == 0 )
+    {
+        info.gap = 0;
+        info.dropped = 0;
+    }
+    else
+    {
+        info.gap = int64_t(info.deviceTimestamp) - int64_t(previous.deviceTimestamp);
+        if( info.frameNumber > previous.frameNumber )
+        {
+            info.dropped = info.frameNumber - previous.frameNumber - 1;
+        }
+        else
+        {
+            // no usable frame counter, count the skipped frame events
+            info.dropped = consumed - 1;
+        }
+    }
+    info.droppedTotal = previous.droppedTotal + info.dropped;
+
+    // Newest settings change that reached this frame, without a frame
+    // counter the newest one
+    while( settingsHistory.size() > 1 && ( 0 == info.frameNumber || settingsHistory[1].firstFrame <= info.frameNumber ) )
+    {
+        settingsHistory.pop_front();
+    }
+    if( !settingsHistory.empty() )
+    {
+        info.exposure = settingsHistory.front().exposure;
+        info.gain = settingsHistory.front().gain;
+    }
+    deliveredFrames++;
+}
+
+void UeyeCamera::acquire()
+{
+    while( acquiring )
+    {
+        if( BACKEND_SUCCESS != backend->waitFrameEvent( 100 ) )
+        {
+            // timed out, check whether we should still be running
+            continue;
+        }
+
+        FrameEvent event;
+        event.timestamp = lms::Time::now().micros();
+        event.trigger = lastTrigger.load(std::memory_order_relaxed);
+
+        char* ptr = NULL;
+        if( BACKEND_SUCCESS != backend->getActSeqBuf(&event.seqNum, &ptr) || NULL == ptr )
+        {
+            continue;
+        }
+
+        event.buffer = buffers.find(event.seqNum, ptr);
+        if( NULL == event.buffer )
+        {
+            // not one of our buffers
+            continue;
+        }
+
+        if( DeliveryMode::FIFO == deliveryMode )
+        {
+            queueFrames(event);
+        }
+        else
+        {
+            if( BACKEND_SUCCESS != backend->getImageInfo(event.buffer->id, event.info) )
+            {
+                event.info = ImageInfo();
+            }
+            latestFrameNumber.store(event.info.frameNumber, std::memory_order_relaxed);
+
+            if( !frameRing.push(event) )
+            {
+                // consumer is not keeping up
+                ringOverflows++;
+            }
+        }
+
+        // Pairs with the store of consumerWaiting in waitForFrame
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if( consumerWaiting )
+        {
+            std::lock_guard<std::mutex> lock(wakeupMutex);
+            wakeup.notify_one();
+        }
+    }
+}
+
+void UeyeCamera::queueFrames( const FrameEvent& event )
+{
+    // The driver fills the buffers in sequence order and skips locked ones,
+    // so all frames since the previous event are in the unlocked buffers
+    // after the previously seen one. One event may stand for several frames,
+    // up to a whole turn of the ring if the newest buffer is the previously
+    // seen one again, stale buffers fail the fresh check below.
+    const int count = buffers.size();
+    const int newest = event.buffer - buffers.begin();
+    int index = ( queuedIndex < 0 ) ? newest : ( queuedIndex + 1 ) % count;
+
+    // a lent buffer is either still locked or released with a frame seen here
+    std::lock_guard<std::mutex> lock(leaseMutex);
+    while( true )
+    {
+        BufferDescriptor* buf = buffers.begin() + index;
+        if( !buf->queued && !buf->lent && BACKEND_SUCCESS == backend->lockSeqBuf(buf->ptr) )
+        {
+            FrameEvent queued = event;
+            queued.buffer = buf;
+            queued.seqNum = index + 1;
+            if( BACKEND_SUCCESS != backend->getImageInfo(buf->id, queued.info) )
+            {
+                queued.info = ImageInfo();
+            }
+
+            // Without a frame counter only the reported buffer is known to
+            // be new, buffers that were locked while the driver passed them
+            // still hold an old frame
+            const uint64_t frameNumber = queued.info.frameNumber;
+            bool fresh = ( 0 == frameNumber ) ? ( index == newest ) : ( frameNumber > queuedFrameNumber );
+            if( fresh )
+            {
+                buf->queued = true;
+                if( frameRing.push(queued) )
+                {
+                    queuedFrameNumber = std::max(queuedFrameNumber, frameNumber);
+                    latestFrameNumber.store(queuedFrameNumber, std::memory_order_relaxed);
+                    maxQueued = std::max<size_t>(maxQueued, frameRing.size());
+                }
+                else
+                {
+                    buf->queued = false;
+                    ringOverflows++;
+                    fresh = false;
+                }
+            }
+            if( !fresh )
+            {
+                backend->unlockSeqBuf(buf->ptr);
+            }
+        }
+
+        if( index == newest )
+        {
+            break;
+        }
+        index = ( index + 1 ) % count;
+    }
+    queuedIndex = newest;
+}
+
+void UeyeCamera::releaseQueued()
+{
+    FrameEvent event;
+    while( frameRing.pop(event) )
+    {
+        if( event.buffer->queued )
+        {
+            std::lock_guard<std::mutex> lock(leaseMutex);
+            backend->unlockSeqBuf(event.buffer->ptr);
+            event.buffer->queued = false;
+        }
+    }
+}
+
+bool UeyeCamera::setCaptureMonitor( float interval, size_t maxBuffers )
+{
+    if( capturing )
+    {
+        logger.error("setCaptureMonitor") << "cannot configure the capture monitor while capturing";
+        return false;
+    }
+
+    if( maxBuffers > BufferTable::MAX_BUFFERS )
+    {
+        logger.warn("setCaptureMonitor") << "number of buffers is limited to " << BufferTable::MAX_BUFFERS;
+        maxBuffers = BufferTable::MAX_BUFFERS;
+    }
+
+    monitorInterval = interval;
+    this->maxBuffers = maxBuffers;
+    return true;
+}
+
+CaptureStatistics UeyeCamera::getCaptureStatistics()
+{
+    std::lock_guard<std::mutex> lock(monitorMutex);
+    CaptureStatistics statistics = captureStatistics;
+    statistics.maxQueued = maxQueued;
+    statistics.queueOverflows = ringOverflows;
+    return statistics;
+}
+
+void UeyeCamera::monitor()
+{
+#ifdef __linux__
+    // Sampling counters must never compete with the acquisition thread
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 10);
+#endif
+
+    CaptureStatus last;
+    if( BACKEND_SUCCESS != backend->getCaptureStatus(last) )
+    {
+        last.total = 0;
+        last.counters.fill(0);
+    }
+    int64_t lastTime = lms::Time::now().micros();
+
+    std::unique_lock<std::mutex> lock(monitorMutex);
+    while( monitoring )
+    {
+        monitorCondition.wait_for(lock, std::chrono::duration<float, std::milli>(monitorInterval), [this]{ return !monitoring; });
+        if( !monitoring )
+        {
+            break;
+        }
+
+        lock.unlock();
+        CaptureStatus current;
+        int ret = backend->getCaptureStatus(current);
+        int64_t now = lms::Time::now().micros();
+        lock.lock();
+
+        if( BACKEND_SUCCESS != ret || now <= lastTime )
+        {
+            continue;
+        }
+
+        // counters may have been reset in between
+        auto delta = [](uint32_t cur, uint32_t prev) { return cur >= prev ? cur - prev : cur; };
+        const double dt = double(now - lastTime) * 1e-6;
+
+        captureStatistics.timestamp = now;
+        captureStatistics.status = current;
+        captureStatistics.totalRate = delta(current.total, last.total) / dt;
+        for( size_t i = 0; i < CaptureStatus::NUM_COUNTERS; ++i )
+        {
+            captureStatistics.rates[i] = delta(current.counters[i], last.counters[i]) / dt;
+        }
+
+        // Request more buffers if the driver ran out of them
+        size_t requested = requestedBuffers;
+        if( maxBuffers > requested && delta(current.counters[CaptureStatus::DRV_OUT_OF_BUFFERS], last.counters[CaptureStatus::DRV_OUT_OF_BUFFERS]) > 0 )
+        {
+            size_t target = std::min(maxBuffers, requested + std::max<size_t>(1, requested / 2));
+            logger.warn("monitor") << "Driver ran out of buffers ("
+                << captureStatistics.rates[CaptureStatus::DRV_OUT_OF_BUFFERS] << "/s), requesting "
+                << target << " buffers";
+            requestedBuffers = target;
+        }
+
+        last = current;
+        lastTime = now;
+    }
+}
+
+bool UeyeCamera::growBuffers()
+{
+    const size_t target = requestedBuffers;
+    if( !initialized || target <= numBuffers )
+    {
+        return false;
+    }
+
+    lms::Time begin = lms::Time::now();
+    bool wasCapturing = capturing;
+    if( wasCapturing )
+    {
+        stop();
+    }
+
+    size_t added = allocateMemory(buffers, target - numBuffers, width, height, pitch, true);
+    numBuffers += added;
+    // don't retry if the allocation failed
+    requestedBuffers = numBuffers;
+
+    {
+        std::lock_guard<std::mutex> lock(monitorMutex);
+        captureStatistics.numBuffers = numBuffers;
+    }
+
+    if( wasCapturing )
+    {
+        start();
+    }
+
+    logger.info("growBuffers") << "Added " << added << " sequence buffers (now " << numBuffers << ") in "
+        << lms::Time::since(begin).toFloat<std::milli>() << " ms";
+    return added > 0;
+}
+
+bool UeyeCamera::reconfigure( size_t width, size_t height, size_t offsetX, size_t offsetY, size_t numBuffers )
+{
+    if( !initialized )
+    {
+        logger.error("reconfigure") << "Camera not yet initialized";
+        return false;
+    }
+
+    if( numBuffers == 0 || numBuffers > BufferTable::MAX_BUFFERS )
+    {
+        logger.error("reconfigure") << "number of buffers must be between 1 and " << BufferTable::MAX_BUFFERS;
+        return false;
+    }
+
+    // Moving the AOI keeps the buffers
+    const bool resize = ( width != this->width || height != this->height || numBuffers != this->numBuffers );
+    if( !resize && offsetX == this->offsetX && offsetY == this->offsetY )
+    {
+        return true;
+    }
+
+    if( resize && !freeRetiredBuffers() )
+    {
+        logger.warn("reconfigure") << "Buffers of the previous configuration are still lent out";
+        return false;
+    }
+
+    // Allocate the new buffers while the old ones are still capturing
+    BufferTable staged;
+    size_t stagedPitch = pitch;
+    if( resize && allocateMemory(staged, numBuffers, width, height, stagedPitch, false) != numBuffers )
+    {
+        logger.error("reconfigure") << "Could not allocate " << numBuffers << " buffers of " << width << "x" << height;
+        freeBuffers(staged);
+        return false;
+    }
+
+    lms::Time begin = lms::Time::now();
+    bool wasCapturing = capturing;
+    if( wasCapturing )
+    {
+        stop();
+    }
+
+    if( resize )
+    {
+        status = backend->clearSequence();
+        CHECK_STATUS("ClearSequence")
+    }
+
+    status = backend->setAOI(width, height, offsetX, offsetY);
+    CHECK_STATUS("AOI")
+    bool success = ( BACKEND_SUCCESS == status );
+
+    // The buffers only fit if the sensor took the AOI as it is
+    size_t actualWidth, actualHeight;
+    if( success && ( BACKEND_SUCCESS != backend->getImageSize(actualWidth, actualHeight) || actualWidth != width || actualHeight != height ) )
+    {
+        logger.error("reconfigure") << "Camera did not accept the AOI " << width << "x" << height;
+        success = false;
+    }
+
+    if( success && resize )
+    {
+        success = addToSequence(staged);
+        if( success )
+        {
+            // buffers still lent out keep their descriptors until freed
+            retiredBuffers.swap(buffers);
+            buffers.swap(staged);
+        }
+    }
+
+    if( success )
+    {
+        this->width = width;
+        this->height = height;
+        this->offsetX = offsetX;
+        this->offsetY = offsetY;
+        this->numBuffers = numBuffers;
+        pitch = stagedPitch;
+        requestedBuffers = numBuffers;
+
+        // the frame rate range depends on the AOI
+        timingValid = false;
+        prepareTransform();
+
+        std::lock_guard<std::mutex> lock(monitorMutex);
+        captureStatistics.numBuffers = numBuffers;
+    }
+    else
+    {
+        // Restore the previous AOI and sequence
+        if( resize )
+        {
+            backend->clearSequence();
+        }
+        backend->setAOI(this->width, this->height, this->offsetX, this->offsetY);
+        if( resize )
+        {
+            addToSequence(buffers);
+        }
+    }
+
+    if( wasCapturing )
+    {
+        start();
+    }
+    lastBlackout = lms::Time::since(begin).toFloat<std::milli>();
+
+    // Unused new buffers after a failure, old buffers not lent out
+    freeBuffers(staged);
+    freeRetiredBuffers();
+
+    if( success )
+    {
+        logger.info("reconfigure") << "AOI " << width << "x" << height << "+" << offsetX << "+" << offsetY
+            << " with " << numBuffers << " buffers, blackout " << lastBlackout << " ms";
+    }
+    return success;
+}
+
+bool UeyeCamera::setPixelFormat( PixelFormat format )
+{
+    if( initialized )
+    {
+        logger.error("setPixelFormat") << "cannot set pixel format after initilization";
+        return false;
+    }
+
+    this->format = format;
+    return true;
+}
+
+bool UeyeCamera::setTriggerMode( TriggerMode mode )
+{
+    if( initialized )
+    {
+        logger.error("setTriggerMode") << "cannot set trigger mode after initilization";
+        return false;
+    }
+
+    triggerMode = mode;
+    return true;
+}
+
+bool UeyeCamera::setBufferArena( bool enable, bool lock )
+{
+    if( initialized )
+    {
+        logger.error("setBufferArena") << "cannot change the buffer allocation after initilization";
+        return false;
+    }
+
+    arenaEnabled = enable;
+    arenaLock = lock;
+    return true;
+}
+
+bool UeyeCamera::setDeliveryMode( DeliveryMode mode )
+{
+    if( initialized )
+    {
+        logger.error("setDeliveryMode") << "cannot set delivery mode after initilization";
+        return false;
+    }
+
+    deliveryMode = mode;
+    return true;
+}
+
+void UeyeCamera::setToneMapping( double gamma )
+{
+    toneMapping = gamma;
+    converter.configure(format, toneMapping);
+}
+
+bool UeyeCamera::setColorOutput( PixelFormat output, size_t threads )
+{
+    if( initialized )
+    {
+        logger.error("setColorOutput") << "cannot set color output after initilization";
+        return false;
+    }
+
+    if( PixelFormat::BAYER8 != output && PixelFormat::RGB8 != output && PixelFormat::BGRA8 != output && PixelFormat::YUYV != output )
+    {
+        logger.error("setColorOutput") << "unsupported color output";
+        return false;
+    }
+
+    colorOutput = output;
+    demosaicThreads = threads;
+    return true;
+}
+
+void UeyeCamera::setBayerPattern( BayerPattern pattern )
 {
-    initErrorCodes();
+    bayerPattern = pattern;
+    bayerPatternOverride = true;
 }
 
-UeyeCamera::~UeyeCamera()
+PixelFormat UeyeCamera::getOutputFormat()
 {
-    close();
+    if( PixelFormat::BAYER8 == format )
+    {
+        return colorOutput;
+    }
+    // everything else is published as 8 bit grey
+    return PixelFormat::MONO8;
 }
 
-bool UeyeCamera::open()
+void UeyeCamera::setPyramid( size_t levels, PyramidFilter filter )
 {
-    // set camera handle id (0 = auto)
-    status = is_InitCamera(&handle, NULL);
-    CHECK_STATUS("InitCamera")
-            return ( IS_SUCCESS == status );
+    pyramid.configure(levels, filter);
 }
 
-bool UeyeCamera::close()
+bool UeyeCamera::setOutputTransform( Orientation orientation, size_t cropX, size_t cropY, size_t cropWidth, size_t cropHeight,
+                                     const std::vector<uint8_t>& lut )
 {
-    if( 0 == handle )
+    if( !transform.configure(orientation, cropX, cropY, cropWidth, cropHeight, lut) )
     {
-        // not opened
+        logger.error("setOutputTransform") << "lookup table needs 256 entries, not " << lut.size();
         return false;
     }
 
-    deinit();
-    
-    status = is_ExitCamera(handle);
-    CHECK_STATUS("ExitCamera")
-            if( IS_SUCCESS == status )
+    // the AOI is known after init
+    return !initialized || prepareTransform();
+}
+
+bool UeyeCamera::prepareTransform()
+{
+    if( !transform.prepare(getOutputFormat(), width, height) )
     {
-        handle = 0;
-        return true;
+        logger.error("setOutputTransform") << "crop does not fit the " << width << "x" << height
+            << " image, publishing it untransformed";
+        return false;
     }
-    return false;
+    if( transform.isActive() && PixelFormat::BAYER8 == getOutputFormat() )
+    {
+        logger.warn("setOutputTransform") << "flipping or cropping the raw mosaic may change its Bayer pattern";
+    }
+    return true;
 }
 
-bool UeyeCamera::init()
+void UeyeCamera::getPyramidSize( size_t level, size_t& levelWidth, size_t& levelHeight )
 {
-    if( initialized )
+    Pyramid::levelSize(getOutputWidth(), getOutputHeight(), level, levelWidth, levelHeight);
+}
+
+bool UeyeCamera::setAOI(size_t width, size_t height, size_t offsetX, size_t offsetY)
+{
+    if( width & 0x3 )
     {
-        logger.warn("init") << "Already initialized";
-        return false;
+        logger.warn("setAOI") << "ROI width should be a multiple of 4";
     }
     
-    if( 0 == handle )
+    if( height & 0x3 )
     {
-        // Camera not opened yet
-        logger.error("init") << "Camera not yet opened";
-        return false;
+        logger.warn("setAOI") << "ROI height should be a multiple of 4";
     }
     
-    initParameters();
-    
-    // Read back actual image size and format
-    IS_SIZE_2D size;
-    if(IS_SUCCESS == is_AOI(handle, IS_AOI_IMAGE_GET_SIZE, (void*)&size, sizeof(size)))
+    status = backend->setAOI(width, height, offsetX, offsetY);
+    CHECK_STATUS("AOI")
+    if( BACKEND_SUCCESS == status )
     {
-        width  = size.s32Width;
-        height = size.s32Height;
+        this->offsetX = offsetX;
+        this->offsetY = offsetY;
     }
-    else
+    return ( BACKEND_SUCCESS == status );
+}
+
+bool UeyeCamera::setBinning(size_t horizontal, size_t vertical)
+{
+    if( initialized )
     {
-        logger.error() << "Error reading image size and format from camera";
+        logger.error("setBinning") << "cannot set binning after initilization";
         return false;
     }
 
-    // Initialize buffers
-    for( size_t i = 0; i < numBuffers; ++i )
+    status = backend->setBinning(horizontal, vertical);
+    CHECK_STATUS("SetBinning")
+    return ( BACKEND_SUCCESS == status );
+}
+
+bool UeyeCamera::setSubsampling(size_t horizontal, size_t vertical)
+{
+    if( initialized )
     {
-        char* ptr;
-        INT id;
-        status = is_AllocImageMem(handle, width, height, getBPP() * 8, &ptr, &id);
-        CHECK_STATUS("AllocImageMem")
+        logger.error("setSubsampling") << "cannot set subsampling after initilization";
+        return false;
+    }
 
-                status = is_AddToSequence(handle, ptr, id);
-        CHECK_STATUS("AddToSequence")
+    status = backend->setSubsampling(horizontal, vertical);
+    CHECK_STATUS("SetSubsampling")
+    return ( BACKEND_SUCCESS == status );
+}
 
-                // save reference to new buffer
-                buffers[ptr] = id;
-    }
-    
-    // Reset capture status
-    status = is_CaptureStatus(handle, IS_CAPTURE_STATUS_INFO_CMD_RESET, NULL, 0);
-    CHECK_STATUS("ResetCaptureStatus")
+double UeyeCamera::getMaxFrameRate()
+{
+    double minTime, maxTime;
+    status = backend->getFrameTimeRange(minTime, maxTime);
+    CHECK_STATUS("GetFrameTimeRange")
 
-            initialized = true;
-    return true;
+    if( BACKEND_SUCCESS == status && minTime > 0.0 )
+    {
+        return 1.0 / minTime;
+    }
+    return 0.0;
 }
 
-bool UeyeCamera::deinit()
+bool UeyeCamera::applyParameters( const CameraParameters& target )
 {
-    if( !initialized )
+    const bool all = !parametersValid;
+    size_t applied = 0;
+    size_t failed = 0;
+
+    // Counts the result, returns true if the cached value can be updated
+    auto result = [&]( bool ok ) {
+        ok ? applied++ : failed++;
+        return ok;
+    };
+
+    // Timing: each parameter bounds the range of the next one
+    bool timing = all || !timingValid;
+    timingValid = true;
+
+    if( timing || target.pixelClock != parameters.pixelClock )
     {
-        return false;
+        if( result( setPixelClock(target.pixelClock) ) )
+        {
+            parameters.pixelClock = target.pixelClock;
+            timing = true;
+            if( BACKEND_SUCCESS != backend->getPixelClock(actualPixelClock) )
+            {
+                actualPixelClock = target.pixelClock;
+            }
+        }
+        else
+        {
+            timingValid = false;
+        }
     }
-    
-    // Stop capture
-    stop();
-    
-    // print capture status
-    logCaptureStatus();
-    
-    // Clear buffers
-    status = is_ClearSequence(handle);
-    CHECK_STATUS("ClearSequence")
 
-            // Dealloc buffers
-            for( auto& buf : buffers )
+    if( timing || target.frameRate != parameters.frameRate )
     {
-        status = is_FreeImageMem(handle, buf.first /* ptr */, buf.second /* id */);
-        CHECK_STATUS("FreeImageMem")
+        double fps = setFrameRate(target.frameRate);
+        if( result( fps > 0.0 ) )
+        {
+            parameters.frameRate = target.frameRate;
+            actualFrameRate = fps;
+            timing = true;
+        }
+        else
+        {
+            timingValid = false;
+        }
     }
-    buffers.clear();
-    
-    // Disable events
-    status = is_DisableEvent(handle, IS_SET_EVENT_FRAME);
-    CHECK_STATUS("DisableFrameEvent")
 
-            // status = is_DisableEvent(handle, IS_SET_EVENT_CAPTURE_STATUS);
-            // CHECK_STATUS("DisableCaptureStatusEvent")
+    if( timing || target.exposure != parameters.exposure )
+    {
+        double exposure = setExposure(target.exposure);
+        if( result( BACKEND_SUCCESS == status ) )
+        {
+            parameters.exposure = target.exposure;
+            actualExposure = exposure;
+        }
+        else
+        {
+            timingValid = false;
+        }
+    }
 
-            initialized = false;
-    
-    return true;
-}
+    if( all || target.hardwareGamma != parameters.hardwareGamma )
+    {
+        if( result( setHardwareGamma(target.hardwareGamma) ) )
+        {
+            parameters.hardwareGamma = target.hardwareGamma;
+        }
+    }
 
-void UeyeCamera::initParameters()
-{
-    // TODO: set is_EnableAutoExit() to on/off?!
-    
-    status = is_SetColorMode(handle, format);
-    CHECK_STATUS("SetColorMode")
+    if( all || target.gamma != parameters.gamma )
+    {
+        if( result( setGamma(target.gamma) ) )
+        {
+            parameters.gamma = target.gamma;
+        }
+    }
 
-            is_SetExternalTrigger(handle, IS_SET_TRIGGER_OFF);
-    CHECK_STATUS("SetExternalTrigger")
-}
+    if( all || target.gainBoost != parameters.gainBoost )
+    {
+        if( result( setGainBoost(target.gainBoost) ) )
+        {
+            parameters.gainBoost = target.gainBoost;
+        }
+    }
 
-size_t UeyeCamera::getBPP()
-{
-    switch( format )
+    if( all || target.gainAuto != parameters.gainAuto || ( !target.gainAuto && target.gain != parameters.gain ) )
     {
-    // TODO: list all formats
-    case IS_CM_MONO8:
-        return 1;
-    default:
-        // unknown
-        return 0;
+        if( result( target.gainAuto ? setAutoGain() : setGain(target.gain) ) )
+        {
+            parameters.gainAuto = target.gainAuto;
+            parameters.gain = target.gain;
+        }
     }
-}
 
-bool UeyeCamera::start()
-{
-    status = is_CaptureVideo(handle, IS_DONT_WAIT);
-    CHECK_STATUS("CaptureVideo")
-            if( IS_SUCCESS != status )
+    if( all || target.blacklevelAuto != parameters.blacklevelAuto || target.blacklevelOffset != parameters.blacklevelOffset )
     {
-        return false;
+        if( result( setBlacklevel(target.blacklevelAuto, target.blacklevelOffset) ) )
+        {
+            parameters.blacklevelAuto = target.blacklevelAuto;
+            parameters.blacklevelOffset = target.blacklevelOffset;
+        }
     }
-    
-    status = is_EnableEvent(handle, IS_SET_EVENT_FRAME);
-    CHECK_STATUS("EnableFrameEvent")
-            if( IS_SUCCESS != status )
+
+    if( all || target.edgeEnhancement != parameters.edgeEnhancement )
     {
-        return false;
+        if( result( setEdgeEnhancement(target.edgeEnhancement) ) )
+        {
+            parameters.edgeEnhancement = target.edgeEnhancement;
+        }
     }
-    
-    // status = is_EnableEvent(handle, IS_SET_EVENT_CAPTURE_STATUS);
-    // CHECK_STATUS("EnableCaptureStatusEvent")
-    // if( IS_SUCCESS != status )
-    // {
-    //     return false;
-    // }
-    
-    // Start capture error handler thread
-    // TODO
-    
-    // Start frame event-listener thread
-    waitForFrame();
-    
-    capturing = true;
-    
-    return true;
-}
 
-bool UeyeCamera::stop()
-{
-    if( !capturing )
+    if( all || target.hdrKneepoints != parameters.hdrKneepoints )
     {
-        return false;
+        bool ok;
+        if( target.hdrKneepoints.size() > 0 )
+        {
+            ok = setHDRKneepoints(target.hdrKneepoints) && setHDR(true);
+        }
+        else
+        {
+            ok = setHDR(false);
+        }
+        if( result( ok ) )
+        {
+            parameters.hdrKneepoints = target.hdrKneepoints;
+        }
     }
-    
-    status = is_StopLiveVideo(handle, 0);
-    CHECK_STATUS("StopLiveVideo")
 
-            if( IS_SUCCESS != status )
+    // A failed parameter keeps its old cached value and is retried. Until
+    // the first call succeeded completely the cache is not trusted at all.
+    if( failed == 0 )
     {
-        return false;
+        parametersValid = true;
     }
-    
-    capturing = false;
-    return true;
+
+    logger.debug("applyParameters") << "Applied " << applied << " parameters, " << failed << " failed";
+    return failed == 0;
 }
 
-bool UeyeCamera::setNumBuffers( size_t num )
+bool UeyeCamera::applyExposure( double exposure, int gain )
 {
-    if(initialized)
+    bool ok = true;
+    if( exposure != actualExposure )
     {
-        logger.error("setNumBuffers") << "cannot set number of buffers after initilization";
-        return false;
+        setExposure(exposure);
+        if( BACKEND_SUCCESS == status )
+        {
+            // the value read back, which readParameters passes in again
+            // while the controller is active
+            parameters.exposure = actualExposure;
+        }
+        else
+        {
+            ok = false;
+        }
     }
-    
-    if( num == 0 )
+
+    if( gain != actualGain )
     {
-        logger.error("setNumBuffers") << "number of buffers must be greater than zero";
-        return false;
+        if( setGain(gain) )
+        {
+            parameters.gainAuto = false;
+            parameters.gain = gain;
+        }
+        else
+        {
+            ok = false;
+        }
     }
-    
-    numBuffers = num;
-    
-    return true;
+    return ok;
 }
 
-bool UeyeCamera::captureImage( lms::imaging::Image& image )
+bool UeyeCamera::saveParameterSnapshot( const std::string& file )
 {
-    char* ptr;
-    
-    // We always want the latest fully captured image
-    status = is_GetActSeqBuf(handle, NULL, NULL, &ptr);
-#ifdef UEYE_DEBUG
-    CHECK_STATUS("GetActSeqBuf")
-        #endif
+    status = backend->saveParameters(file);
+    CHECK_STATUS("ParameterSet save")
+    return ( BACKEND_SUCCESS == status );
+}
 
-            if( IS_SUCCESS == status && NULL != ptr && buffers.find(ptr) != buffers.end() )
+bool UeyeCamera::loadParameterSnapshot( const std::string& file, const CameraParameters& snapshot )
+{
+    if( initialized )
     {
-        status = is_LockSeqBuf(handle, IS_IGNORE_PARAMETER, ptr);
-#ifdef UEYE_DEBUG
-        CHECK_STATUS("LockSeqBuf")
-        #endif
-
-                status = is_CopyImageMem(handle, ptr, buffers[ptr], (char*)image.data());
-#ifdef UEYE_DEBUG
-        CHECK_STATUS("CopyImageMem")
-        #endif
-
-                status = is_UnlockSeqBuf(handle, IS_IGNORE_PARAMETER, ptr);
-#ifdef UEYE_DEBUG
-        CHECK_STATUS("UnlockSeqBuf")
-        #endif
-
-                return true;
+        logger.error("loadParameterSnapshot") << "cannot load parameters after initilization";
+        return false;
     }
-    
-    return false;
-}
 
-bool UeyeCamera::waitForFrame(float timeOut){
+    status = backend->loadParameters(file);
+    CHECK_STATUS("ParameterSet load")
+    if( BACKEND_SUCCESS != status )
+    {
+        return false;
+    }
 
-    lms::Time start = lms::Time::now();
-    bool success = true;
-    INT ret = 0;
-    do {
-        //std::cout<<"waiting forIMAGE"<<std::endl;
-        ret = is_WaitEvent( this->handle, IS_SET_EVENT_FRAME, 100 );
-        float res =(lms::Time::now() - start).toFloat<std::milli, double>();
-        if( res > timeOut){
-            success = false;
-            break;
-        }
-    } while( IS_TIMED_OUT == ret && this->capturing );
-    return success;
+    parameters = snapshot;
+    parametersValid = true;
+    timingValid = true;
+    readTiming();
+    actualGain = parameters.gainAuto ? -1 : parameters.gain;
+    return true;
 }
 
-bool UeyeCamera::setAOI(size_t width, size_t height, size_t offsetX, size_t offsetY)
+void UeyeCamera::readTiming()
 {
-    if( width & 0x3 )
+    if( BACKEND_SUCCESS != backend->getPixelClock(actualPixelClock) )
     {
-        logger.warn("setAOI") << "ROI width should be a multiple of 4";
+        actualPixelClock = parameters.pixelClock;
     }
-    
-    if( height & 0x3 )
+    if( BACKEND_SUCCESS != backend->getFrameRate(actualFrameRate) )
     {
-        logger.warn("setAOI") << "ROI height should be a multiple of 4";
+        actualFrameRate = parameters.frameRate;
     }
-    
-    IS_RECT rect;
+    if( BACKEND_SUCCESS != backend->getExposure(actualExposure) )
+    {
+        actualExposure = parameters.exposure;
+    }
+}
 
-    rect.s32X       = offsetX;
-    rect.s32Y       = offsetY;
-    rect.s32Width   = width;
-    rect.s32Height  = height;
+void UeyeCamera::noteSettings()
+{
+    SettingsChange change;
+    change.firstFrame = latestFrameNumber.load(std::memory_order_relaxed) + settingsDelay;
+    change.exposure = actualExposure;
+    change.gain = actualGain;
 
-    status = is_AOI( handle, IS_AOI_IMAGE_SET_AOI, (void*)&rect, sizeof(rect));
-    CHECK_STATUS("AOI")
-            return ( IS_SUCCESS == status );
+    // changes that have not reached a frame yet are superseded
+    while( !settingsHistory.empty() && settingsHistory.back().firstFrame >= change.firstFrame )
+    {
+        settingsHistory.pop_back();
+    }
+    settingsHistory.push_back(change);
 }
 
 bool UeyeCamera::setPixelClock( unsigned int clock )
 {
-    status = is_PixelClock(handle, IS_PIXELCLOCK_CMD_SET, (void*)&clock, sizeof(clock));
+    status = backend->setPixelClock(clock);
     CHECK_STATUS("PixelClock")
-            return ( IS_SUCCESS == status );
+    return ( BACKEND_SUCCESS == status );
 }
 
 double UeyeCamera::setExposure(double exposure)
 {
     double exposureParam = exposure;
-    status = is_Exposure(handle, IS_EXPOSURE_CMD_SET_EXPOSURE, (void*)&exposureParam, sizeof(exposureParam));
+    status = backend->setExposure(exposureParam);
     CHECK_STATUS("Exposure")
 
-            if( IS_SUCCESS == status )
+    if( BACKEND_SUCCESS == status )
     {
+        actualExposure = exposureParam;
+        noteSettings();
         return exposureParam;
     }
     return 0.0;
@@ -338,10 +1844,10 @@ double UeyeCamera::setExposure(double exposure)
 double UeyeCamera::setFrameRate(double fps)
 {
     double actual;
-    status = is_SetFrameRate(handle, fps, &actual);
+    status = backend->setFrameRate(fps, actual);
     CHECK_STATUS("SetFrameRate")
 
-            if( IS_SUCCESS == status )
+    if( BACKEND_SUCCESS == status )
     {
         return actual;
     }
@@ -350,182 +1856,180 @@ double UeyeCamera::setFrameRate(double fps)
 
 bool UeyeCamera::setHardwareGamma(bool enable)
 {
-    status = is_SetHardwareGamma(handle, enable ? IS_SET_HW_GAMMA_ON : IS_SET_HW_GAMMA_OFF);
+    status = backend->setHardwareGamma(enable);
     CHECK_STATUS("SetHardwareGamma")
 
-            return ( IS_SUCCESS == status );
+    return ( BACKEND_SUCCESS == status );
 }
 
 bool UeyeCamera::setGamma(double gamma)
 {
-    INT value = static_cast<INT>( gamma * 100.0 );
-    status = is_Gamma(handle, IS_GAMMA_CMD_SET, (void*)&value, sizeof(value));
+    int value = static_cast<int>( gamma * 100.0 );
+    status = backend->setGamma(value);
     CHECK_STATUS("Gamma")
 
-            return ( IS_SUCCESS == status );
+    return ( BACKEND_SUCCESS == status );
 }
 
 bool UeyeCamera::setGainBoost(bool enable)
 {
-    status = is_SetGainBoost(handle, enable ? IS_SET_GAINBOOST_ON : IS_SET_GAINBOOST_OFF);
+    status = backend->setGainBoost(enable);
     CHECK_STATUS("SetGainBoost")
 
-            return ( IS_SUCCESS == status );
+    return ( BACKEND_SUCCESS == status );
 }
 
 bool UeyeCamera::setAutoGain()
 {
-    return setGain( IS_SET_ENABLE_AUTO_GAIN );
+    status = backend->setAutoGain();
+    CHECK_STATUS("SetHardwareGain")
+    if( BACKEND_SUCCESS == status )
+    {
+        actualGain = -1;
+        noteSettings();
+    }
+
+    return ( BACKEND_SUCCESS == status );
 }
 
 bool UeyeCamera::setGain(int value)
 {
-    status = is_SetHardwareGain(handle, value, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER, IS_IGNORE_PARAMETER);
+    status = backend->setGain(value);
     CHECK_STATUS("SetHardwareGain")
+    if( BACKEND_SUCCESS == status )
+    {
+        actualGain = value;
+        noteSettings();
+    }
 
-            return ( IS_SUCCESS == status );
+    return ( BACKEND_SUCCESS == status );
 }
 
 bool UeyeCamera::setGlobalShutter(bool enable)
 {
-    status = is_SetGlobalShutter(handle, enable ? IS_SET_GLOBAL_SHUTTER_ON : IS_SET_GLOBAL_SHUTTER_OFF);
+    status = backend->setGlobalShutter(enable);
     CHECK_STATUS("SetGlobalShutter")
 
-            return ( IS_SUCCESS == status );
+    return ( BACKEND_SUCCESS == status );
 }
 
 bool UeyeCamera::setEdgeEnhancement(int level)
 {
-    status = is_EdgeEnhancement(handle, IS_EDGE_ENHANCEMENT_CMD_SET, (void*)&level, sizeof(level));
+    status = backend->setEdgeEnhancement(level);
     CHECK_STATUS("EdgeEnhancement")
 
-            return ( IS_SUCCESS == status );
+    return ( BACKEND_SUCCESS == status );
 }
 
 bool UeyeCamera::setBlacklevel(bool autolevel, int offset)
 {
     // Set mode
-    INT mode = autolevel ? IS_AUTO_BLACKLEVEL_ON : IS_AUTO_BLACKLEVEL_OFF;
-    status = is_Blacklevel(handle, IS_BLACKLEVEL_CMD_SET_MODE, (void*)&mode, sizeof(mode));
+    status = backend->setBlacklevelMode(autolevel);
     CHECK_STATUS("Blacklevel mode")
 
-            if( IS_SUCCESS != status )
+    if( BACKEND_SUCCESS != status )
     {
         return false;
     }
     
     // set offset
-    status = is_Blacklevel(handle, IS_BLACKLEVEL_CMD_SET_OFFSET, (void*)&offset, sizeof(offset));
+    status = backend->setBlacklevelOffset(offset);
     CHECK_STATUS("Blacklevel offset")
 
-            return ( IS_SUCCESS == status );
+    return ( BACKEND_SUCCESS == status );
 }
 
 bool UeyeCamera::setHDR(bool enable)
 {
-    INT mode = enable ? IS_ENABLE_HDR : IS_DISABLE_HDR;
-    status = is_EnableHdr(handle, mode);
+    status = backend->setHDR(enable);
     
     CHECK_STATUS("HDR enable")
-    return ( IS_SUCCESS == status );
+    return ( BACKEND_SUCCESS == status );
 }
 
 bool UeyeCamera::setHDRKneepoints( const std::vector< std::pair<double, double> >& kneepoints )
 {
-    KNEEPOINTARRAY array;
-    
-    INT numPoints = kneepoints.size();
-    if( numPoints > 10)
+    std::vector< std::pair<double, double> > points = kneepoints;
+    if( points.size() > 10)
     {
         logger.warn("setHDRKneepoints") << "Maxmimum number of HDR points limited to 10 (requested: " << kneepoints.size() << ")";
-        numPoints = 10;
+        points.resize(10);
     }
-    
-    auto it = kneepoints.begin();
-    
-    // Fill KNEEPOINTARRAY
-    array.NumberOfUsedKneepoints = numPoints;
-    for( INT i = 0; i < numPoints; i++ )
-    {
-        KNEEPOINT& k = array.Kneepoint[i];
-        k.x = it->first;
-        k.y = it->second;
-        ++it;
-    }
-    //int hdr = -1;
-    //status = is_GetHdrMode(handle, &hdr);
-    //CHECK_STATUS("HDR 1")
-
-    //logger.error("HDR")<<hdr;
-
-    //status = is_EnableHdr(handle,1);
-    //CHECK_STATUS("HDR ...");
-    /*KNEEPOINTINFO ki[10];
-
-    for(int i = 0; i < 10; i++)
-        ki[i].NumberOfSupportedKneepoints = 0;
-
-    status = is_GetHdrKneepointInfo(handle,ki,10);
-    for(int i = 0; i < 10; i++)
-        logger.error("KNEE INFO")<<ki[i].NumberOfSupportedKneepoints;
-    CHECK_STATUS("HDR CHECK");
-    */
-    status = is_SetHdrKneepoints(handle, &array, numPoints);
+
+    status = backend->setHDRKneepoints(points);
     CHECK_STATUS("HDR Kneepoints");
-/*
-            status = is_GetHdrMode(handle, &hdr);
-            logger.error("HDR")<<hdr;
-            CHECK_STATUS("HDR 2")
-            */
-    return ( IS_SUCCESS == status );
+    return ( BACKEND_SUCCESS == status );
 }
 
 void UeyeCamera::info()
 {
-    SENSORINFO data;
-    status = is_GetSensorInfo(handle, &data);
+    SensorInfo data;
+    status = backend->getSensorInfo(data);
     CHECK_STATUS("GetSensorInfo")
 
-            if( IS_SUCCESS != status )
+    if( BACKEND_SUCCESS != status )
     {
         return;
     }
     
-    logger.info() << "SensorName: "     << data.strSensorName;
-    logger.info() << "ColorMode: "      << ((data.nColorMode == IS_COLORMODE_MONOCHROME) ? "mono" : "color");
-    logger.info() << "MaxWidth:"        << data.nMaxWidth;
-    logger.info() << "MaxHeight:"       << data.nMaxHeight;
-    logger.info() << "MasterGain:"      << std::boolalpha << data.bMasterGain;
-    logger.info() << "GlobalShutter:"   << std::boolalpha << data.bGlobShutter;
-    logger.info() << "PixelSize:"       << ( float(data.wPixelSize) * 0.01f ) << " um";
+    logger.info() << "Backend: "        << backend->name();
+    logger.info() << "SensorName: "     << data.name;
+    logger.info() << "ColorMode: "      << (data.color ? "color" : "mono");
+    logger.info() << "MaxWidth:"        << data.maxWidth;
+    logger.info() << "MaxHeight:"       << data.maxHeight;
+    logger.info() << "MasterGain:"      << std::boolalpha << data.masterGain;
+    logger.info() << "GlobalShutter:"   << std::boolalpha << data.globalShutter;
+    logger.info() << "PixelSize:"       << data.pixelSize << " um";
 }
 
 void UeyeCamera::logCaptureStatus()
 {
-    UEYE_CAPTURE_STATUS_INFO captureStatus;
-    status = is_CaptureStatus(handle, IS_CAPTURE_STATUS_INFO_CMD_GET, (void*)&captureStatus, sizeof(captureStatus));
+    CaptureStatus captureStatus;
+    status = backend->getCaptureStatus(captureStatus);
     CHECK_STATUS("CaptureStatus")
 
-    if( IS_SUCCESS != status ){
+    if( BACKEND_SUCCESS != status ){
         return;
     }
     
-    if( captureStatus.dwCapStatusCnt_Total == 0 ){
+    if( captureStatus.total == 0 ){
         // no errors, nothing to log
         logger.info("captureStatus") << "No errors occured during capture";
         return;
     }
     
-    logger.warn("captureStatus") << "Total Errors: "        << captureStatus.dwCapStatusCnt_Total;
-    logger.warn("captureStatus") << "API_NO_DEST_MEM"       << captureStatus.adwCapStatusCnt_Detail[IS_CAP_STATUS_API_NO_DEST_MEM];
-    logger.warn("captureStatus") << "API_CONVERSION_FAILED" << captureStatus.adwCapStatusCnt_Detail[IS_CAP_STATUS_API_CONVERSION_FAILED];
-    logger.warn("captureStatus") << "API_IMAGE_LOCKED"      << captureStatus.adwCapStatusCnt_Detail[IS_CAP_STATUS_API_IMAGE_LOCKED];
-    logger.warn("captureStatus") << "DRV_OUT_OF_BUFFERS"    << captureStatus.adwCapStatusCnt_Detail[IS_CAP_STATUS_DRV_OUT_OF_BUFFERS];
-    logger.warn("captureStatus") << "DRV_DEVICE_NOT_READY"  << captureStatus.adwCapStatusCnt_Detail[IS_CAP_STATUS_DRV_DEVICE_NOT_READY];
-    logger.warn("captureStatus") << "USB_TRANSFER_FAILED"   << captureStatus.adwCapStatusCnt_Detail[IS_CAP_STATUS_USB_TRANSFER_FAILED];
-    logger.warn("captureStatus") << "DEV_TIMEOUT"           << captureStatus.adwCapStatusCnt_Detail[IS_CAP_STATUS_DEV_TIMEOUT];
-    logger.warn("captureStatus") << "ETH_BUFFER_OVERRUN"    << captureStatus.adwCapStatusCnt_Detail[IS_CAP_STATUS_ETH_BUFFER_OVERRUN];
-    logger.warn("captureStatus") << "ETH_MISSED_IMAGES"     << captureStatus.adwCapStatusCnt_Detail[IS_CAP_STATUS_ETH_MISSED_IMAGES];
+    logger.warn("captureStatus") << "Total Errors: "        << captureStatus.total;
+    for( size_t i = 0; i < CaptureStatus::NUM_COUNTERS; ++i )
+    {
+        CaptureStatus::Counter counter = CaptureStatus::Counter(i);
+        logger.warn("captureStatus") << CaptureStatus::name(counter) << " " << captureStatus.counters[counter];
+    }
+}
+
+LatencyStatistics UeyeCamera::getLatencyStatistics() const
+{
+    LatencyStatistics stats;
+    stats.timestamp = lms::Time::now().micros();
+    for( size_t i = 0; i < LatencyStatistics::NUM_STAGES; ++i )
+    {
+        stats.stages[i] = latency[i].summarize();
+    }
+    return stats;
+}
+
+void UeyeCamera::logLatency() const
+{
+    LatencyStatistics stats = getLatencyStatistics();
+    for( size_t i = 0; i < LatencyStatistics::NUM_STAGES; ++i )
+    {
+        const LatencySummary& stage = stats.stages[i];
+        if( stage.count == 0 )
+        {
+            continue;
+        }
+        logger.info("latency") << LatencyStatistics::name(LatencyStatistics::Stage(i)) << " n=" << stage.count
+            << " mean " << stage.mean << " p50 " << stage.p50 << " p99 " << stage.p99 << " max " << stage.max << " us";
+    }
 }
 
 int UeyeCamera::getErrorCode()
@@ -536,19 +2040,10 @@ int UeyeCamera::getErrorCode()
 std::string UeyeCamera::getError()
 {
     
-    if( IS_NO_SUCCESS == status )
+    if( BACKEND_NO_SUCCESS == status )
     {
         // Use geterror
-        INT err;
-        IS_CHAR* errstr;
-        if( IS_SUCCESS == is_GetError(handle, &err, &errstr) )
-        {
-            return std::string(errstr);
-        }
-        else
-        {
-            return std::string("Error reading is_GetError");
-        }
+        return backend->getLastError();
     } else if( errorCodes.find(status) != errorCodes.end() ) {
         return std::string( errorCodes[status] );
     }
@@ -1,246 +1,1062 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <ctime>
+#include <fstream>
 #include <iomanip>
+#include <sstream>
+#include <thread>
 #include "lms/messaging.h"
 
 #include "ueye_importer.h"
+#ifndef UEYE_IMPORTER_NO_UEYE
+#include "ueye_backend.h"
+#endif
+#include "simulated_backend.h"
 
 namespace lms_ueye_importer {
 
 bool UeyeImporter::initialize() {
     logger.info() << "Init: UeyeImporter";
-    
-    // init camera
-    camera = new UeyeCamera(logger);
 
+    // Without a "cameras" list a single camera with the plain keys is used
+    std::vector<std::string> names;
+    if( config().hasKey("cameras") )
+    {
+        names = config().getArray<std::string>("cameras");
+    }
+    if( names.empty() )
+    {
+        names.push_back("");
+    }
 
-    //use the timeout to give the cam some time (needed for fast restart as the device will be busy from the last run (because of soem reason I don't know))
-    bool camAvailable = false;
-    lms::Time start = lms::Time::now();
-    do{
-        if(camera->open()){
-            camAvailable = true;
-            break;
-        }
-    }while(lms::Time::since(start).toFloat<std::milli>() < config().get<int>("initTimeout",0));
-    //return if the cam can't be accessed
-    if(!camAvailable){
+    syncCameras = config().get<bool>("sync_cameras", true);
+
+    for( const auto& name : names )
+    {
+        CameraContext* ctx = new CameraContext();
+        ctx->name = name;
+        ctx->camera = NULL;
+        ctx->recorder = NULL;
+        ctx->replay = NULL;
+        ctx->exposureControl = NULL;
+        ctx->hasChannels = false;
+        ctx->batchSize = 1;
+        cameras.push_back(ctx);
+
+        if( !initCamera(*ctx) )
+        {
+            logger.error("init") << "Could not initialize camera '" << name << "'";
+
+            // deinitialize is not called after a failed initialize
+            for( auto created : cameras )
+            {
+                deinitCamera(*created);
+                delete created;
+            }
+            cameras.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool UeyeImporter::initCamera(CameraContext& ctx) {
+    // init camera
+    CameraBackend* backend = createBackend(ctx);
+    if( NULL == backend )
+    {
+        return false;
+    }
+    ctx.camera = new UeyeCamera(logger, backend);
+    ctx.startTime = lms::Time::now();
+    ctx.firstFrame = false;
+
+    if( !openCamera(ctx) )
+    {
         return false;
     }
+    float openTime = lms::Time::since(ctx.startTime).toFloat<std::milli>();
     
     // Print camera information
-    camera->info();
+    ctx.camera->info();
     
     // Set config
-    camera->setNumBuffers( config().get<size_t>("num_buffers") );
-    
-    camera->setAOI(
-        config().get<size_t>("width"),
-        config().get<size_t>("height"),
-        config().get<size_t>("offset_x"),
-        config().get<size_t>("offset_y")
-    );
-    camera->setPixelClock( config().get<int>("pixelclock") );
-    auto fps = camera->setFrameRate( config().get<double>("framerate") );
-    auto exposure = camera->setExposure( config().get<double>("exposure") );
-    camera->setHardwareGamma( config().get<bool>("hardware_gamma") );
-    camera->setGamma( config().get<double>("gamma") );
-    camera->setGainBoost( config().get<bool>("gain_boost") );
-    
-    if( config().get<bool>("gain_auto") )
+    ctx.numBuffers = param<size_t>(ctx, "num_buffers");
+    ctx.camera->setNumBuffers( ctx.numBuffers );
+    ctx.camera->setBufferArena( param<bool>(ctx, "buffer_arena", false), param<bool>(ctx, "buffer_arena_lock", false) );
+
+    PixelFormat format;
+    std::string formatName = param<std::string>(ctx, "pixel_format", "mono8");
+    if( !parsePixelFormat(formatName, format) )
     {
-        camera->setAutoGain();
-    } else {
-        camera->setGain( config().get<int>("gain") );
+        logger.error("pixel_format") << "Unknown pixel format: " << formatName;
+        return false;
     }
-    
-    // camera->setGlobalShutter( config().get<bool>("global_shutter") );
-    camera->setBlacklevel(
-        config().get<bool>("blacklevel_auto"),
-        config().get<int>("blacklevel_offset")
-    );
-    
-    camera->setEdgeEnhancement( config().get<int>("edge_enhancement") );
-    
-    // HDR mode
+    if( NULL != ctx.replay && format != ctx.replay->getRecordedFormat() )
     {
-        auto kneepointsX = config().getArray<double>("hdr_kneepoints_x");
-        auto kneepointsY = config().getArray<double>("hdr_kneepoints_y");
-        
-        if( kneepointsX.size() != kneepointsY.size() )
-        {
-            logger.warn("hdr_kneepoints")
-                << "Number of X and Y values for HDR kneepoints differ!"
-                << "( x: " << kneepointsX.size() << ", y:" << kneepointsY.size() << " )";
-        }
-        
-        std::vector< std::pair<double, double> > kneepoints;
-        
-        auto xIt = kneepointsX.begin();
-        auto yIt = kneepointsY.begin();
-        
-        while( xIt != kneepointsX.end() && yIt != kneepointsY.end() )
+        // a recording has exactly one format
+        logger.info("pixel_format") << "Using the pixel format of the recording instead of " << formatName;
+        format = ctx.replay->getRecordedFormat();
+    }
+    ctx.camera->setPixelFormat( format );
+
+    TriggerMode trigger;
+    std::string triggerName = param<std::string>(ctx, "trigger_mode", "off");
+    if( !parseTriggerMode(triggerName, trigger) )
+    {
+        logger.error("trigger_mode") << "Unknown trigger mode: " << triggerName;
+        return false;
+    }
+    if( NULL != ctx.replay && TriggerMode::OFF != trigger )
+    {
+        logger.warn("trigger_mode") << "Recordings cannot be triggered, ignoring trigger_mode";
+        trigger = TriggerMode::OFF;
+    }
+    ctx.camera->setTriggerMode( trigger );
+
+    DeliveryMode delivery;
+    std::string deliveryName = param<std::string>(ctx, "delivery", "latest");
+    if( !parseDeliveryMode(deliveryName, delivery) )
+    {
+        logger.error("delivery") << "Unknown delivery mode: " << deliveryName;
+        return false;
+    }
+    ctx.camera->setDeliveryMode( delivery );
+    ctx.camera->setToneMapping( param<double>(ctx, "tone_mapping_gamma", 1.0) );
+
+    if( PixelFormat::BAYER8 == format )
+    {
+        PixelFormat output;
+        std::string outputName = param<std::string>(ctx, "color_output", "rgb");
+        if( !parseColorOutput(outputName, output) )
         {
-            kneepoints.push_back( std::make_pair( *xIt++, *yIt++ ) );
+            logger.error("color_output") << "Unknown color output: " << outputName;
+            return false;
         }
-        
-        if( kneepoints.size() > 0 )
+        ctx.camera->setColorOutput( output, param<size_t>(ctx, "demosaic_threads", 1) );
+
+        BayerPattern pattern;
+        std::string patternName = param<std::string>(ctx, "bayer_pattern", "auto");
+        if( parseBayerPattern(patternName, pattern) )
         {
-            // Set Kneepoints...
-            camera->setHDRKneepoints( kneepoints );
-            
-            // ... and enable HDR
-            camera->setHDR( true );
+            ctx.camera->setBayerPattern( pattern );
         }
-        else
+        else if( patternName != "auto" )
         {
-            // Disable HDR
-            camera->setHDR( false );
+            logger.warn("bayer_pattern") << "Unknown Bayer pattern " << patternName << ", using the sensor default";
         }
     }
+
+    if( NULL == ctx.replay )
+    {
+        // Binning / subsampling reset the AOI, which is given in reduced pixels
+        ctx.camera->setBinning( param<size_t>(ctx, "binning_x", 1), param<size_t>(ctx, "binning_y", 1) );
+        ctx.camera->setSubsampling( param<size_t>(ctx, "subsampling_x", 1), param<size_t>(ctx, "subsampling_y", 1) );
+
+        ctx.camera->setAOI(
+            param<size_t>(ctx, "width"),
+            param<size_t>(ctx, "height"),
+            param<size_t>(ctx, "offset_x"),
+            param<size_t>(ctx, "offset_y")
+        );
+    }
+    else
+    {
+        // geometry is fixed by the recording
+        logger.info("replay") << "Replaying " << ctx.replay->getFrameCount() << " frames from "
+            << param<std::string>(ctx, "replay_path");
+    }
+
+    // Restore the parameters of the last start with the same config in one
+    // operation, otherwise apply them one by one
+    lms::Time configureStart = lms::Time::now();
+    CameraParameters parameters = readParameters(ctx);
+    std::string snapshot = snapshotFile(ctx);
+    bool warm = !snapshot.empty() && std::ifstream(snapshot.c_str()).good()
+        && ctx.camera->loadParameterSnapshot(snapshot, parameters);
+    bool configured = warm || ctx.camera->applyParameters(parameters);
+    float configureTime = lms::Time::since(configureStart).toFloat<std::milli>();
     
     // Initialize buffers and stuff
-    camera->init();
+    lms::Time initStart = lms::Time::now();
+    bool initialized = ctx.camera->init();
+    float initTime = lms::Time::since(initStart).toFloat<std::milli>();
+    if( !initialized )
+    {
+        logger.error("init") << "Cam " << ctx.name << " could not be initialized";
+        return false;
+    }
     
     // Get data channels with actual size and format
-    imagePtr = writeChannel<lms::imaging::Image>("CAMERA_IMAGE");
-    imagePtr->resize(camera->getWidth(), camera->getHeight(), lms::imaging::Format::GREY);
+    ctx.imagePtr = writeChannel<lms::imaging::Image>( channelName(ctx, "CAMERA_IMAGE") );
+    ctx.framePtr = writeChannel<Frame>( channelName(ctx, "CAMERA_FRAME") );
+    ctx.hasChannels = true;
+
+    // Downscaled copies on CAMERA_IMAGE_2X, CAMERA_IMAGE_4X, ...
+    size_t levels = param<size_t>(ctx, "pyramid_levels", 0);
+    if( levels > 0 && PixelFormat::MONO8 != ctx.camera->getOutputFormat() )
+    {
+        logger.warn("pyramid_levels") << "Pyramids are only built for grey images";
+        levels = 0;
+    }
+    ctx.camera->setPyramid( levels, param<std::string>(ctx, "pyramid_filter", "box") == "gaussian" ? PyramidFilter::GAUSSIAN : PyramidFilter::BOX );
+    for( size_t level = 1; level <= levels; ++level )
+    {
+        ctx.levelPtrs.push_back( writeChannel<lms::imaging::Image>( channelName(ctx, "CAMERA_IMAGE_" + std::to_string(1 << level) + "X") ) );
+    }
+    configureOutputTransform(ctx);
+    resizeChannels(ctx);
+    ctx.frameInfoPtr = writeChannel<FrameInfo>( channelName(ctx, "CAMERA_FRAME_INFO") );
+
+    ctx.zeroCopy = param<bool>(ctx, "zero_copy", false);
+    ctx.wideOutput = param<bool>(ctx, "output_16bit", false);
+    if( ctx.wideOutput && significantBits(format) <= 8 )
+    {
+        logger.warn("output_16bit") << "Pixel format " << formatName << " has no more than 8 bits, ignoring output_16bit";
+        ctx.wideOutput = false;
+    }
+    ctx.camera->setMinFreeBuffers( param<size_t>(ctx, "zero_copy_min_free", 1) );
+
+    ctx.batchSize = 1;
+    if( DeliveryMode::FIFO == delivery )
+    {
+        ctx.batchSize = std::max<size_t>(1, param<size_t>(ctx, "fifo_batch", 1));
+    }
+    if( ctx.batchSize > 1 )
+    {
+        ctx.frameBatchPtr = writeChannel< std::vector<Frame> >( channelName(ctx, "CAMERA_FRAME_BATCH") );
+        ctx.frameInfoBatchPtr = writeChannel< std::vector<FrameInfo> >( channelName(ctx, "CAMERA_FRAME_INFO_BATCH") );
+    }
+    configureExposureControl(ctx);
+
+    ctx.imageStatistics = param<bool>(ctx, "image_statistics", false);
+    ctx.camera->setImageStatistics( ctx.imageStatistics,
+        uint8_t( std::min(255, std::max(0, param<int>(ctx, "image_statistics_saturation", 250))) ),
+        param<size_t>(ctx, "image_statistics_histogram_step", 8) );
+    if( ctx.imageStatistics )
+    {
+        ctx.imageStatisticsPtr = writeChannel<ImageStatistics>( channelName(ctx, "CAMERA_IMAGE_STATISTICS") );
+    }
+
+    ctx.captureStatusPtr = writeChannel<CaptureStatistics>( channelName(ctx, "CAMERA_CAPTURE_STATUS") );
+    ctx.latencyPtr = writeChannel<LatencyStatistics>( channelName(ctx, "CAMERA_LATENCY") );
+    ctx.latencyInterval = param<float>(ctx, "latency_interval", 1000);
+    ctx.latencyLogInterval = param<float>(ctx, "latency_log_interval", 60000);
+    ctx.lastLatencyPublish = lms::Time::now();
+    ctx.lastLatencyLog = lms::Time::now();
+    ctx.camera->setCaptureMonitor(
+        param<float>(ctx, "capture_status_interval", 1000),
+        param<size_t>(ctx, "max_buffers", 0)
+    );
     
+    if( !startRecorder(ctx) )
+    {
+        return false;
+    }
+
     // Start capturing
-    camera->start();
+    lms::Time captureStart = lms::Time::now();
+    bool started = ctx.camera->start();
+    float startTime = lms::Time::since(captureStart).toFloat<std::milli>();
+    if( !started )
+    {
+        logger.error("start") << "Cam " << ctx.name << " could not start capturing";
+        return false;
+    }
+
+    logger.info("startup") << "Camera " << ctx.name << ": open " << openTime << " ms, configure "
+        << configureTime << " ms (" << ( warm ? "warm" : "cold" ) << "), init " << initTime
+        << " ms, start " << startTime << " ms";
+
+    if( !snapshot.empty() && !warm && configured )
+    {
+        if( ctx.camera->saveParameterSnapshot(snapshot) )
+        {
+            logger.info("startup") << "Saved parameter snapshot " << snapshot;
+        }
+    }
     
-    logger.info()   << "Starting uEye Camera: "
-                    << camera->getWidth() << "x" << camera->getHeight()
+    logger.info()   << "Starting uEye Camera " << ctx.name << ": "
+                    << ctx.camera->getWidth() << "x" << ctx.camera->getHeight()
                     << std::setprecision(5)
-                    << " @ " << fps << " fps"
-                    << " (exposure: " << exposure << " ms)";
+                    << " @ " << ctx.camera->getFrameRate() << " fps"
+                    << " (max: " << ctx.camera->getMaxFrameRate() << " fps, exposure: " << ctx.camera->getExposure() << " ms)";
     
     return true;
 }
 
+CameraParameters UeyeImporter::readParameters(const CameraContext& ctx) {
+    CameraParameters parameters;
+    parameters.pixelClock       = param<int>(ctx, "pixelclock");
+    parameters.frameRate        = param<double>(ctx, "framerate");
+    parameters.exposure         = param<double>(ctx, "exposure");
+    parameters.hardwareGamma    = param<bool>(ctx, "hardware_gamma");
+    parameters.gamma            = param<double>(ctx, "gamma");
+    parameters.gainBoost        = param<bool>(ctx, "gain_boost");
+    parameters.gainAuto         = param<bool>(ctx, "gain_auto");
+    parameters.gain             = param<int>(ctx, "gain", 0);
+    parameters.blacklevelAuto   = param<bool>(ctx, "blacklevel_auto");
+    parameters.blacklevelOffset = param<int>(ctx, "blacklevel_offset");
+    parameters.edgeEnhancement  = param<int>(ctx, "edge_enhancement");
+    // global_shutter is not applied
+
+    // Under software auto exposure the controller owns exposure and gain,
+    // applying the configured ones would undo its work
+    if( NULL != ctx.exposureControl && NULL != ctx.camera && ctx.camera->isInitialized() )
+    {
+        parameters.exposure = ctx.camera->getExposure();
+        if( ctx.camera->getGain() >= 0 )
+        {
+            parameters.gainAuto = false;
+            parameters.gain = ctx.camera->getGain();
+        }
+    }
+
+    // HDR knee points
+    auto kneepointsX = paramArray<double>(ctx, "hdr_kneepoints_x");
+    auto kneepointsY = paramArray<double>(ctx, "hdr_kneepoints_y");
+
+    if( kneepointsX.size() != kneepointsY.size() )
+    {
+        logger.warn("hdr_kneepoints")
+            << "Number of X and Y values for HDR kneepoints differ!"
+            << "( x: " << kneepointsX.size() << ", y:" << kneepointsY.size() << " )";
+    }
+
+    auto xIt = kneepointsX.begin();
+    auto yIt = kneepointsY.begin();
+
+    while( xIt != kneepointsX.end() && yIt != kneepointsY.end() )
+    {
+        parameters.hdrKneepoints.push_back( std::make_pair( *xIt++, *yIt++ ) );
+    }
+
+    return parameters;
+}
+
+bool UeyeImporter::openCamera(CameraContext& ctx) {
+    const float timeout = config().get<int>("initTimeout", 0);
+    const uint32_t deviceId = param<uint32_t>(ctx, "device_id", 0);
+    const std::string serial = param<std::string>(ctx, "serial", "");
+
+    lms::Time start = lms::Time::now();
+    float delay = 10;
+    for( size_t attempt = 1; ; ++attempt )
+    {
+        if( ctx.camera->open(deviceId, serial) )
+        {
+            if( attempt > 1 )
+            {
+                logger.info("open") << "Cam " << ctx.name << " opened after " << attempt << " attempts";
+            }
+            return true;
+        }
+
+        float remaining = timeout - lms::Time::since(start).toFloat<std::milli>();
+        if( remaining <= 0 )
+        {
+            return false;
+        }
+        std::this_thread::sleep_for( std::chrono::duration<float, std::milli>( std::min(delay, remaining) ) );
+        delay = std::min(delay * 2, 500.0f);
+    }
+}
+
+bool UeyeImporter::startRecorder(CameraContext& ctx) {
+    if( !param<bool>(ctx, "record", false) )
+    {
+        return true;
+    }
+
+    // <record_path>[_<camera>]_<date>-<time>
+    char date[32];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y%m%d-%H%M%S", localtime(&now));
+    std::string prefix = param<std::string>(ctx, "record_path", "/tmp/ueye")
+        + ( ctx.name.empty() ? "" : "_" + ctx.name ) + "_" + date;
+
+    ctx.recorder = new FrameRecorder(logger);
+    if( param<bool>(ctx, "record_compression", false) )
+    {
+        ctx.recorder->setCompression( std::max<size_t>(1, param<size_t>(ctx, "record_compression_threads", 2)) );
+    }
+    if( !ctx.recorder->open( prefix, param<size_t>(ctx, "record_segment_size", 1024) << 20, param<size_t>(ctx, "record_queue", 16) ) )
+    {
+        delete ctx.recorder;
+        ctx.recorder = NULL;
+        return false;
+    }
+
+    ctx.recorderStatusPtr = writeChannel<RecorderStatistics>( channelName(ctx, "CAMERA_RECORDER_STATUS") );
+    ctx.camera->setRecorder(ctx.recorder);
+    logger.info("record") << "Recording cam " << ctx.name << " to " << prefix;
+    return true;
+}
+
+std::string UeyeImporter::snapshotFile(const CameraContext& ctx) {
+    std::string prefix = param<std::string>(ctx, "parameter_snapshot", "");
+    if( prefix.empty() )
+    {
+        return "";
+    }
+
+    static const char* keys[] = {
+        "backend", "device_id", "serial", "pixel_format",
+        "binning_x", "binning_y", "subsampling_x", "subsampling_y",
+        "width", "height", "offset_x", "offset_y",
+        "pixelclock", "framerate", "exposure", "hardware_gamma", "gamma",
+        "gain_boost", "gain_auto", "gain", "blacklevel_auto", "blacklevel_offset",
+        "edge_enhancement", "hdr_kneepoints_x", "hdr_kneepoints_y"
+    };
+
+    // FNV-1a over "key=value" lines
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash]( const std::string& text ) {
+        for( unsigned char c : text )
+        {
+            hash = ( hash ^ c ) * 1099511628211ull;
+        }
+    };
+    add(ctx.name + "\n");
+    for( const char* key : keys )
+    {
+        add(std::string(key) + "=" + param<std::string>(ctx, key, "") + "\n");
+    }
+
+    std::ostringstream file;
+    file << prefix << ( ctx.name.empty() ? "" : ctx.name + "_" ) << std::hex << std::setw(16) << std::setfill('0') << hash << ".ini";
+    return file.str();
+}
+
+bool UeyeImporter::parsePixelFormat(const std::string& name, PixelFormat& format) {
+    static const std::pair<const char*, PixelFormat> formats[] = {
+        { "mono8",          PixelFormat::MONO8 },
+        { "mono10",         PixelFormat::MONO10 },
+        { "mono12",         PixelFormat::MONO12 },
+        { "mono16",         PixelFormat::MONO16 },
+        { "mono10_packed",  PixelFormat::MONO10_PACKED },
+        { "mono12_packed",  PixelFormat::MONO12_PACKED },
+        { "bayer8",         PixelFormat::BAYER8 }
+    };
+
+    for( const auto& entry : formats )
+    {
+        if( name == entry.first )
+        {
+            format = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool UeyeImporter::parseColorOutput(const std::string& name, PixelFormat& format) {
+    static const std::pair<const char*, PixelFormat> outputs[] = {
+        { "rgb",    PixelFormat::RGB8 },
+        { "bgra",   PixelFormat::BGRA8 },
+        { "yuyv",   PixelFormat::YUYV },
+        { "raw",    PixelFormat::BAYER8 }
+    };
+
+    for( const auto& entry : outputs )
+    {
+        if( name == entry.first )
+        {
+            format = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool UeyeImporter::parseBayerPattern(const std::string& name, BayerPattern& pattern) {
+    static const std::pair<const char*, BayerPattern> patterns[] = {
+        { "rggb",   BayerPattern::RGGB },
+        { "grbg",   BayerPattern::GRBG },
+        { "gbrg",   BayerPattern::GBRG },
+        { "bggr",   BayerPattern::BGGR }
+    };
+
+    for( const auto& entry : patterns )
+    {
+        if( name == entry.first )
+        {
+            pattern = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool UeyeImporter::parseOrientation(const std::string& name, Orientation& orientation) {
+    static const std::pair<const char*, Orientation> orientations[] = {
+        { "none",       Orientation::NORMAL },
+        { "horizontal", Orientation::FLIP_HORIZONTAL },
+        { "vertical",   Orientation::FLIP_VERTICAL },
+        { "rotate180",  Orientation::ROTATE_180 }
+    };
+
+    for( const auto& entry : orientations )
+    {
+        if( name == entry.first )
+        {
+            orientation = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool UeyeImporter::parseTriggerMode(const std::string& name, TriggerMode& mode) {
+    static const std::pair<const char*, TriggerMode> modes[] = {
+        { "off",        TriggerMode::OFF },
+        { "software",   TriggerMode::SOFTWARE },
+        { "rising",     TriggerMode::RISING_EDGE },
+        { "falling",    TriggerMode::FALLING_EDGE }
+    };
+
+    for( const auto& entry : modes )
+    {
+        if( name == entry.first )
+        {
+            mode = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool UeyeImporter::parseDeliveryMode(const std::string& name, DeliveryMode& mode) {
+    static const std::pair<const char*, DeliveryMode> modes[] = {
+        { "latest",     DeliveryMode::LATEST },
+        { "fifo",       DeliveryMode::FIFO }
+    };
+
+    for( const auto& entry : modes )
+    {
+        if( name == entry.first )
+        {
+            mode = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+lms::imaging::Format UeyeImporter::imageFormat(PixelFormat format) {
+    switch( format )
+    {
+    case PixelFormat::RGB8:
+        return lms::imaging::Format::RGB;
+    case PixelFormat::BGRA8:
+        return lms::imaging::Format::BGRA;
+    case PixelFormat::YUYV:
+        return lms::imaging::Format::YUYV;
+    default:
+        // mono and raw Bayer frames
+        return lms::imaging::Format::GREY;
+    }
+}
+
+std::string UeyeImporter::channelName(const CameraContext& ctx, const std::string& base) {
+    if( ctx.name.empty() )
+    {
+        return base;
+    }
+
+    std::string suffix = ctx.name;
+    for( auto& c : suffix )
+    {
+        c = std::toupper(c);
+    }
+    return base + "_" + suffix;
+}
+
+CameraBackend* UeyeImporter::createBackend(CameraContext& ctx) {
+    std::string type = param<std::string>(ctx, "backend", "ueye");
+
+    if( type == "ueye" )
+    {
+#ifndef UEYE_IMPORTER_NO_UEYE
+        return new UeyeBackend();
+#else
+        logger.error("backend") << "Built without uEye support";
+        return NULL;
+#endif
+    }
+    if( type == "simulated" )
+    {
+        return new SimulatedBackend(
+            param<size_t>(ctx, "simulated_sensor_width", 1280),
+            param<size_t>(ctx, "simulated_sensor_height", 1024)
+        );
+    }
+
+    if( type == "replay" )
+    {
+        static const std::pair<std::string, ReplayPacing> pacings[] = {
+            { "realtime",   ReplayPacing::REALTIME },
+            { "fixed",      ReplayPacing::FIXED_RATE },
+            { "max",        ReplayPacing::MAX_SPEED },
+        };
+
+        std::string pacingName = param<std::string>(ctx, "replay_pacing", "realtime");
+        for( const auto& pacing : pacings )
+        {
+            if( pacing.first == pacingName )
+            {
+                ctx.replay = new ReplayBackend(
+                    param<std::string>(ctx, "replay_path"),
+                    pacing.second,
+                    param<double>(ctx, "replay_speed", 1.0),
+                    param<bool>(ctx, "replay_loop", false),
+                    param<size_t>(ctx, "replay_threads", 1)
+                );
+                return ctx.replay;
+            }
+        }
+        logger.error("replay_pacing") << "Unknown replay pacing: " << pacingName;
+        return NULL;
+    }
+
+    logger.error("backend") << "Unknown camera backend: " << type;
+    return NULL;
+}
+
 bool UeyeImporter::deinitialize() {
     logger.info("deinit") << "Deinit: UeyeImporter";
 
-    camera->stop();
-    camera->deinit();
-    camera->close();
-    delete camera;
+    for( auto ctx : cameras )
+    {
+        deinitCamera(*ctx);
+        delete ctx;
+    }
+    cameras.clear();
 
     return true;
 }
 
-bool UeyeImporter::cycle () {
-    if(!camera->isInitialized()){
-        return false;
+void UeyeImporter::deinitCamera(CameraContext& ctx) {
+    if( NULL == ctx.camera )
+    {
+        return;
     }
-    
-    // Wait for new frame event...
-    if(!camera->waitForFrame(config().get<float>("timeOut",20))){
-        messaging()->send("CAM_FAILED","Stop it honey <3");
-        logger.error("cycle.waitForFrame")<<"Cam failed, code: "<<camera->getErrorCode()<<" Error: " <<camera->getError();
-        return false;
+
+    // Hand lent buffers back before the buffers are freed, the channels
+    // don't exist yet if the camera failed to open
+    if( ctx.hasChannels )
+    {
+        *ctx.framePtr = Frame();
+        if( ctx.batchSize > 1 )
+        {
+            ctx.frameBatchPtr->clear();
+            ctx.frameInfoBatchPtr->clear();
+        }
     }
-    
-    if(!camera->captureImage( *imagePtr )){
-        logger.error("cycle.captureImage")<<"Cam failed, code: "<<camera->getErrorCode()<<" Error: " <<camera->getError();
-        return false;
+
+    ctx.camera->stop();
+    if( NULL != ctx.recorder )
+    {
+        // writes the queued frames and releases their buffers
+        ctx.camera->setRecorder(NULL);
+        ctx.recorder->close();
+
+        RecorderStatistics stats = ctx.recorder->getStatistics();
+        double framePeriod = 1000.0 / ctx.camera->getFrameRate();
+        if( stats.meanEncodeTime > framePeriod )
+        {
+            logger.warn("record") << "Compression of cam " << ctx.name << " takes " << stats.meanEncodeTime
+                << " ms per frame at " << framePeriod << " ms frame period, use more record_compression_threads";
+        }
+        delete ctx.recorder;
+        ctx.recorder = NULL;
     }
-    
-    return true;
+    ctx.camera->deinit();
+    ctx.camera->close();
+    delete ctx.camera;
+    ctx.camera = NULL;
+    ctx.replay = NULL;
+
+    delete ctx.exposureControl;
+    ctx.exposureControl = NULL;
 }
 
-void UeyeImporter::configsChanged(){
-    logger.info() << "ConfigsChanged: UeyeImporter";
+void UeyeImporter::resizeChannels(CameraContext& ctx) {
+    ctx.imagePtr->resize(ctx.camera->getOutputWidth(), ctx.camera->getOutputHeight(), imageFormat(ctx.camera->getOutputFormat()));
 
-    // Stop capturing before changing settings
-    //camera->stop();
+    for( size_t level = 1; level <= ctx.levelPtrs.size(); ++level )
+    {
+        size_t levelWidth, levelHeight;
+        ctx.camera->getPyramidSize(level, levelWidth, levelHeight);
+        ctx.levelPtrs[level - 1]->resize(levelWidth, levelHeight, lms::imaging::Format::GREY);
+    }
+}
 
-    // Print camera information
-    //camera->info();
+void UeyeImporter::configureOutputTransform(CameraContext& ctx) {
+    Orientation orientation = Orientation::NORMAL;
+    std::string flip = param<std::string>(ctx, "output_flip", "none");
+    if( !parseOrientation(flip, orientation) )
+    {
+        logger.warn("output_flip") << "Unknown flip " << flip << ", not flipping";
+    }
 
-    // Set config
-    //camera->setNumBuffers( config().get<size_t>("num_buffers") );
-    /*
-    camera->setAOI(
-        config().get<size_t>("width"),
-        config().get<size_t>("height"),
-        config().get<size_t>("offset_x"),
-        config().get<size_t>("offset_y")
-    );
-    */
-    camera->setPixelClock( config().get<int>("pixelclock") );
-    auto fps = camera->setFrameRate( config().get<double>("framerate") );
-    auto exposure = camera->setExposure( config().get<double>("exposure") );
-    camera->setHardwareGamma( config().get<bool>("hardware_gamma") );
-    camera->setGamma( config().get<double>("gamma") );
-    camera->setGainBoost( config().get<bool>("gain_boost") );
+    // explicit table entries take precedence over the curve
+    std::vector<uint8_t> lut;
+    std::vector<int> entries = paramArray<int>(ctx, "output_lut");
+    if( !entries.empty() )
+    {
+        for( int entry : entries )
+        {
+            lut.push_back( uint8_t( std::min(255, std::max(0, entry)) ) );
+        }
+    }
+    else
+    {
+        lut = OutputTransform::makeLut( param<double>(ctx, "output_gamma", 1.0),
+                                        param<double>(ctx, "output_contrast", 1.0),
+                                        param<double>(ctx, "output_brightness", 0.0) );
+    }
+
+    ctx.camera->setOutputTransform( orientation,
+        param<size_t>(ctx, "output_crop_x", 0), param<size_t>(ctx, "output_crop_y", 0),
+        param<size_t>(ctx, "output_crop_width", 0), param<size_t>(ctx, "output_crop_height", 0), lut );
+}
 
-    if( config().get<bool>("gain_auto") )
+void UeyeImporter::reconfigureCamera(CameraContext& ctx) {
+    if( !ctx.camera->isInitialized() || NULL != ctx.replay )
     {
-        camera->setAutoGain();
-    } else {
-        camera->setGain( config().get<int>("gain") );
+        return;
     }
 
-    // camera->setGlobalShutter( config().get<bool>("global_shutter") );
-    camera->setBlacklevel(
-        config().get<bool>("blacklevel_auto"),
-        config().get<int>("blacklevel_offset")
-    );
+    size_t width = param<size_t>(ctx, "width");
+    size_t height = param<size_t>(ctx, "height");
+    size_t offsetX = param<size_t>(ctx, "offset_x");
+    size_t offsetY = param<size_t>(ctx, "offset_y");
+
+    // Keep buffers added by buffer growth unless num_buffers was changed
+    size_t configuredBuffers = param<size_t>(ctx, "num_buffers");
+    size_t buffers = configuredBuffers != ctx.numBuffers ? configuredBuffers : ctx.camera->getNumBuffers();
+
+    // Hand lent buffers back so the old buffers can be freed right away
+    *ctx.framePtr = Frame();
+    if( ctx.batchSize > 1 )
+    {
+        ctx.frameBatchPtr->clear();
+        ctx.frameInfoBatchPtr->clear();
+    }
 
-    camera->setEdgeEnhancement( config().get<int>("edge_enhancement") );
+    if( !ctx.camera->reconfigure(width, height, offsetX, offsetY, buffers) )
+    {
+        logger.warn("configsChanged") << "Cam " << ctx.name << " keeps AOI "
+            << ctx.camera->getWidth() << "x" << ctx.camera->getHeight();
+        return;
+    }
+    ctx.numBuffers = configuredBuffers;
+    resizeChannels(ctx);
+}
+
+bool UeyeImporter::cycle () {
+    const float timeOut = config().get<float>("timeOut",20);
+    lms::Time start = lms::Time::now();
+    bool success = true;
+
+    // Software triggered cameras start their exposures together, before any
+    // of them is waited on
+    for( CameraContext* ctx : cameras )
+    {
+        if( ctx->camera->isInitialized() && TriggerMode::SOFTWARE == ctx->camera->getTriggerMode() )
+        {
+            ctx->camera->trigger();
+        }
+    }
 
-    // HDR mode
+    // The acquisition threads of all cameras run concurrently, so waiting
+    // on them one after the other costs at most timeOut in total
+    std::vector<bool> ready(cameras.size(), false);
+    bool allReady = true;
+    for( size_t i = 0; i < cameras.size(); ++i )
     {
-        auto kneepointsX = config().getArray<double>("hdr_kneepoints_x");
-        auto kneepointsY = config().getArray<double>("hdr_kneepoints_y");
+        CameraContext& ctx = *cameras[i];
+        if(!ctx.camera->isInitialized()){
+            success = false;
+            allReady = false;
+            continue;
+        }
 
-        if( kneepointsX.size() != kneepointsY.size() )
+        // Apply buffer growth requested by the capture status monitor
+        if( ctx.camera->isBufferGrowthPending() )
+        {
+            ctx.camera->growBuffers();
+        }
+        *ctx.captureStatusPtr = ctx.camera->getCaptureStatistics();
+        if( NULL != ctx.recorder )
         {
-            logger.warn("hdr_kneepoints")
-                << "Number of X and Y values for HDR kneepoints differ!"
-                << "( x: " << kneepointsX.size() << ", y:" << kneepointsY.size() << " )";
+            *ctx.recorderStatusPtr = ctx.recorder->getStatistics();
         }
+        publishLatency(ctx);
 
-        std::vector< std::pair<double, double> > kneepoints;
+        // Without sync only the first camera paces the cycle
+        bool wait = ( syncCameras || i == 0 );
+        float remaining = wait ? std::max(0.0f, timeOut - lms::Time::since(start).toFloat<std::milli>()) : 0.0f;
 
-        auto xIt = kneepointsX.begin();
-        auto yIt = kneepointsY.begin();
+        // Wait for new frame event...
+        ready[i] = ctx.camera->waitForFrame(remaining);
+        allReady = allReady && ready[i];
+        if( !ready[i] && wait ){
+            messaging()->send("CAM_FAILED","Stop it honey <3");
+            logger.error("cycle.waitForFrame")<<"Cam " << ctx.name << " failed, code: "<<ctx.camera->getErrorCode()<<" Error: " <<ctx.camera->getError();
+            success = false;
+        }
+    }
 
-        while( xIt != kneepointsX.end() && yIt != kneepointsY.end() )
+    // A synchronized set is published completely or not at all, the frames
+    // of the cameras that were ready are taken in the next cycle
+    if( syncCameras && !allReady )
+    {
+        return false;
+    }
+
+    for( size_t i = 0; i < cameras.size(); ++i )
+    {
+        if( !ready[i] )
+        {
+            continue;
+        }
+        CameraContext& ctx = *cameras[i];
+        if( ctx.batchSize > 1 )
         {
-            kneepoints.push_back( std::make_pair( *xIt++, *yIt++ ) );
+            ctx.frameBatchPtr->clear();
+            ctx.frameInfoBatchPtr->clear();
         }
 
-        if( kneepoints.size() > 0 )
+        // FIFO delivery takes up to batchSize of the queued frames
+        size_t frames = 0;
+        do
         {
-            // Set Kneepoints...
-            camera->setHDRKneepoints( kneepoints );
+            if( !captureCamera(ctx) )
+            {
+                success = false;
+                break;
+            }
+            controlExposure(ctx);
+            if( ctx.batchSize > 1 )
+            {
+                appendToBatch(ctx);
+            }
+        }
+        while( ++frames < ctx.batchSize && ctx.camera->getQueuedFrames() > 0 );
+    }
+
+    return success;
+}
+
+bool UeyeImporter::captureCamera(CameraContext& ctx) {
+    UeyeCamera* camera = ctx.camera;
 
-            // ... and enable HDR
-            camera->setHDR( true );
+    ctx.levelImages.clear();
+    for( auto& level : ctx.levelPtrs )
+    {
+        ctx.levelImages.push_back( &*level );
+    }
+
+    if( ctx.zeroCopy )
+    {
+        // CAMERA_IMAGE is not updated, consumers read CAMERA_FRAME
+        if(!camera->captureFrame( *ctx.framePtr )){
+            logger.error("cycle.captureFrame")<<"Cam failed, code: "<<camera->getErrorCode()<<" Error: " <<camera->getError();
+            return false;
         }
-        else
+        if( !ctx.levelImages.empty() )
         {
-            // Disable HDR
-            camera->setHDR( false );
+            camera->buildPyramid( *ctx.framePtr, ctx.levelImages );
         }
+        publishFrameInfo(ctx);
+        return true;
+    }
+    
+    // CAMERA_FRAME gets the unpacked 16 bit frame from the same pass
+    Frame* wide = ctx.wideOutput ? &*ctx.framePtr : NULL;
+    if(!camera->captureImage( *ctx.imagePtr, wide, ctx.levelImages.empty() ? NULL : &ctx.levelImages )){
+        logger.error("cycle.captureImage")<<"Cam failed, code: "<<camera->getErrorCode()<<" Error: " <<camera->getError();
+        return false;
     }
 
-    // Initialize buffers and stuff
-    //camera->init();
+    if( ctx.wideOutput )
+    {
+        publishFrameInfo(ctx);
+        return true;
+    }
 
-    // Get data channels with actual size and format
-    //imagePtr = datamanager()->writeChannel<lms::imaging::Image>(this, "CAMERA_IMAGE");
-    //imagePtr->resize(camera->getWidth(), camera->getHeight(), lms::imaging::Format::GREY);writeChannel
+    // Point CAMERA_FRAME at the copied image
+    Frame& frame = *ctx.framePtr;
+    frame.data      = ctx.imagePtr->data();
+    frame.width     = ctx.imagePtr->width();
+    frame.height    = ctx.imagePtr->height();
+    frame.format    = camera->getOutputFormat();
+    frame.stride    = rowBytes(frame.format, frame.width);
+    frame.zeroCopy  = false;
+    frame.lease.reset();
 
-    // Start capturing
-    //camera->start();
+    publishFrameInfo(ctx);
+    
+    return true;
+}
 
-    logger.info()   << "Starting uEye Camera: "
-                    << camera->getWidth() << "x" << camera->getHeight()
-                    << std::setprecision(5)
-                    << " @ " << fps << " fps"
-                    << " (exposure: " << exposure << " ms)";
+void UeyeImporter::appendToBatch(CameraContext& ctx) {
+    Frame frame = *ctx.framePtr;
+    if( !frame.lease )
+    {
+        // CAMERA_IMAGE is overwritten by the next frame of the batch
+        auto copy = std::make_shared< std::vector<uint8_t> >( frame.data, frame.data + frame.stride * frame.height );
+        frame.data  = copy->data();
+        frame.lease = copy;
+    }
+    ctx.frameBatchPtr->push_back(frame);
+    ctx.frameInfoBatchPtr->push_back(*ctx.frameInfoPtr);
+}
+
+void UeyeImporter::publishFrameInfo(CameraContext& ctx) {
+    FrameInfo& info = *ctx.frameInfoPtr;
+    info = ctx.camera->getFrameInfo();
+    info.publishTimestamp = lms::Time::now().micros();
+    info.age = info.publishTimestamp - info.eventTimestamp;
+
+    if( ctx.imageStatistics )
+    {
+        *ctx.imageStatisticsPtr = ctx.camera->getImageStatistics();
+    }
+
+    // the exposure ended about one transfer time before the frame event,
+    // for software triggered frames exactly one exposure after the trigger
+    int64_t exposureEnd = info.eventTimestamp - info.transferTime;
+    if( info.triggerTimestamp > 0 )
+    {
+        exposureEnd = info.triggerTimestamp + int64_t( info.exposure * 1000 );
+        ctx.camera->recordLatency( LatencyStatistics::TRIGGER, uint64_t( std::max<int64_t>(0, info.publishTimestamp - info.triggerTimestamp) ) * 1000 );
+    }
+    ctx.camera->recordLatency( LatencyStatistics::PUBLISH, uint64_t( std::max<int64_t>(0, info.publishTimestamp - exposureEnd) ) * 1000 );
 
+    if( !ctx.firstFrame )
+    {
+        ctx.firstFrame = true;
+        logger.info("startup") << "Cam " << ctx.name << " first frame after "
+            << lms::Time::since(ctx.startTime).toFloat<std::milli>() << " ms";
+    }
+
+    if( info.dropped > 0 )
+    {
+        logger.debug("frameInfo") << "Cam " << ctx.name << " dropped " << info.dropped << " frames before frame " << info.frameNumber;
+    }
+}
+
+void UeyeImporter::publishLatency(CameraContext& ctx) {
+    if( ctx.latencyInterval > 0 && lms::Time::since(ctx.lastLatencyPublish).toFloat<std::milli>() >= ctx.latencyInterval )
+    {
+        *ctx.latencyPtr = ctx.camera->getLatencyStatistics();
+        ctx.lastLatencyPublish = lms::Time::now();
+    }
+
+    if( ctx.latencyLogInterval > 0 && lms::Time::since(ctx.lastLatencyLog).toFloat<std::milli>() >= ctx.latencyLogInterval )
+    {
+        logger.info("latency") << "Cam " << ctx.name << ":";
+        ctx.camera->logLatency();
+        ctx.lastLatencyLog = lms::Time::now();
+    }
+}
+
+void UeyeImporter::configureExposureControl(CameraContext& ctx) {
+    // triggered frames are exposed with the settings at the trigger
+    size_t delay = ( TriggerMode::OFF == ctx.camera->getTriggerMode() ) ? 2 : 1;
+    ctx.camera->setSettingsDelay( param<size_t>(ctx, "exposure_delay", delay) );
+
+    if( !param<bool>(ctx, "auto_exposure", false) )
+    {
+        delete ctx.exposureControl;
+        ctx.exposureControl = NULL;
+        return;
+    }
+    if( NULL != ctx.replay )
+    {
+        logger.warn("auto_exposure") << "Recordings cannot be exposed differently, ignoring auto_exposure";
+        return;
+    }
+
+    // the controller looks at the frame published on CAMERA_FRAME
+    PixelFormat analyzed = ctx.zeroCopy ? ctx.camera->getPixelFormat() : ctx.camera->getOutputFormat();
+    if( !ctx.wideOutput && !ExposureController::supports(analyzed) )
+    {
+        logger.warn("auto_exposure") << "Frames published by cam " << ctx.name << " cannot be analyzed, ignoring auto_exposure";
+        return;
+    }
+
+    ExposureControlParameters parameters;
+    parameters.target           = param<double>(ctx, "auto_exposure_target", 110.0);
+    parameters.deadband         = param<double>(ctx, "auto_exposure_deadband", 0.05);
+    parameters.responsiveness   = param<double>(ctx, "auto_exposure_responsiveness", 0.7);
+    parameters.maxStep          = param<double>(ctx, "auto_exposure_max_step", 0.5);
+    parameters.saturation       = param<double>(ctx, "auto_exposure_saturation", 0.02);
+    parameters.minExposure      = param<double>(ctx, "auto_exposure_min", 0.05);
+    parameters.maxExposure      = param<double>(ctx, "auto_exposure_max", 1000.0);
+    parameters.maxGain          = param<int>(ctx, "auto_gain_max", 100);
+    parameters.maxGainFactor    = param<double>(ctx, "auto_gain_factor", 4.0);
+    parameters.interval         = param<size_t>(ctx, "auto_exposure_interval", 2);
+    parameters.stepX            = param<size_t>(ctx, "auto_exposure_sampling", 4);
+    parameters.stepY            = parameters.stepX;
+
+    if( NULL == ctx.exposureControl )
+    {
+        ctx.exposureControl = new ExposureController();
+        ctx.exposurePtr = writeChannel<ExposureStatistics>( channelName(ctx, "CAMERA_EXPOSURE") );
+    }
+    ctx.exposureControl->setParameters(parameters);
+}
+
+void UeyeImporter::controlExposure(CameraContext& ctx) {
+    if( NULL == ctx.exposureControl )
+    {
+        return;
+    }
+
+    UeyeCamera* camera = ctx.camera;
+    const double frameRate = camera->getFrameRate();
+    const double maxExposure = frameRate > 0.0 ? 1000.0 / frameRate : ctx.exposureControl->getParameters().maxExposure;
+
+    ExposureController& control = *ctx.exposureControl;
+    if( control.update(*ctx.framePtr, *ctx.frameInfoPtr, camera->getExposure(), camera->getGain(), maxExposure) )
+    {
+        camera->applyExposure( control.getExposure(), control.getGain() );
+        logger.debug("auto_exposure") << "Cam " << ctx.name << " mean " << control.getStatistics().mean
+            << " at frame " << ctx.frameInfoPtr->frameNumber << ", exposure " << camera->getExposure()
+            << " ms, gain " << camera->getGain();
+    }
+    *ctx.exposurePtr = control.getStatistics();
+}
+
+void UeyeImporter::configsChanged(){
+    logger.info() << "ConfigsChanged: UeyeImporter";
+
+    for( auto ctxPtr : cameras )
+    {
+        CameraContext& ctx = *ctxPtr;
+
+        // AOI and buffers are switched with a short capture blackout
+        reconfigureCamera(ctx);
+        configureOutputTransform(ctx);
+        resizeChannels(ctx);
+
+        // before the parameters, which follow the controller if there is one
+        configureExposureControl(ctx);
+        ctx.camera->applyParameters( readParameters(ctx) );
+        ctx.camera->setToneMapping( param<double>(ctx, "tone_mapping_gamma", 1.0) );
+
+        logger.info()   << "Starting uEye Camera " << ctx.name << ": "
+                        << ctx.camera->getWidth() << "x" << ctx.camera->getHeight()
+                        << std::setprecision(5)
+                        << " @ " << ctx.camera->getFrameRate() << " fps"
+                        << " (max: " << ctx.camera->getMaxFrameRate() << " fps, exposure: " << ctx.camera->getExposure() << " ms)";
+    }
 }
 
 }